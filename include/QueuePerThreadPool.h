@@ -67,10 +67,68 @@ OF SUCH DAMAGE.
 
 #include <pthread.h>
 
+#include "SinglyLinkedList.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* The order in which queued work is processed
+ *
+ * QPTPOOL_BFS:    work is pushed round robin onto the back of the
+ *                 queues, and each thread takes its entire queue at
+ *                 once (roughly breadth first)
+ * QPTPOOL_DFS:    work is pushed onto the front of the enqueuing
+ *                 thread's own queue, and each thread takes one item
+ *                 at a time from the front of its queue (depth first);
+ *                 threads without work steal the back (oldest) half
+ *                 of another thread's queue
+ * QPTPOOL_HYBRID: breadth first until hybrid_cap items are in flight,
+ *                 and depth first after that
+ */
+enum QPTPoolPolicy {
+    QPTPOOL_BFS,
+    QPTPOOL_DFS,
+    QPTPOOL_HYBRID,
+};
+
+/* Priority levels of queued work
+ *
+ * Each thread takes work from its highest priority queue that has
+ * work, unless a lower priority queue that has work has been passed
+ * over starvation_limit times in a row, in which case that queue is
+ * served next so that it always makes progress. Breadth first threads
+ * also check for higher priority work between the items of the batch
+ * they took.
+ */
+enum QPTPoolPriority {
+    QPTPOOL_PRIORITY_HIGH,
+    QPTPOOL_PRIORITY_NORMAL,
+    QPTPOOL_PRIORITY_LOW,
+    QPTPOOL_PRIORITIES,         /* number of priority levels */
+};
+
+/* User defined function that each thread runs once when it starts, before processing any work
+ *
+ * @param ctx      the pool context the function is running in
+ * @param id       the id of this thread
+ * @param args     the args passed to QPTPool_start
+ */
+struct QPTPool;
+typedef void (*QPTPoolThreadInit_t)(struct QPTPool * ctx, const size_t id, void * args);
+
+/* User defined function that is run for each thread when the pool is cancelled
+ *
+ * This runs in the thread that called QPTPool_cancel, possibly while
+ * thread id is processing work, so it should only do thread safe
+ * things such as interrupting the work.
+ *
+ * @param ctx      the pool context that was cancelled
+ * @param id       the id of the thread whose work should be stopped
+ * @param args     the args passed to QPTPool_start
+ */
+typedef void (*QPTPoolCancel_t)(struct QPTPool * ctx, const size_t id, void * args);
+
 /* The Queue Per Thread Pool context */
 struct QPTPoolData;
 struct QPTPool {
@@ -80,6 +138,24 @@ struct QPTPool {
     pthread_mutex_t mutex;
     int running;
     size_t incomplete;
+
+    enum QPTPoolPolicy policy;
+    size_t hybrid_cap;
+    pthread_cond_t cv;          /* DFS and hybrid threads wait here for work to steal */
+    size_t queued;              /* items in queues that have not been taken */
+    size_t peak;                /* largest value of incomplete */
+
+    void * args;                /* args passed to QPTPool_start */
+    size_t queue_limit;         /* 0 for unlimited */
+    size_t inlined;             /* number of items processed inline because of queue_limit */
+
+    QPTPoolThreadInit_t thread_init;
+    size_t nodes;               /* number of NUMA nodes the threads are pinned to, 0 if not pinned */
+
+    int cancelled;              /* set by QPTPool_cancel */
+    QPTPoolCancel_t cancel;
+
+    size_t starvation_limit;    /* times a priority level can be passed over in a row, 0 for no limit */
 };
 
 /* User defined function to pass into QPTPool_start
@@ -97,6 +173,41 @@ typedef int (*QPTPoolFunc_t)(struct QPTPool * ctx, const size_t id, void * data,
 /* initialize a QPTPool context without starting the threads */
 struct QPTPool * QPTPool_init(const size_t threads);
 
+/* select the order of processing; call before QPTPool_start */
+int QPTPool_set_policy(struct QPTPool * ctx, const enum QPTPoolPolicy policy, const size_t hybrid_cap);
+
+/*
+ * limit the number of incomplete items; once the limit is reached,
+ * work enqueued by the pool's own threads is processed immediately
+ * by the enqueuing thread instead of being queued (work enqueued by
+ * other threads is always queued); call before QPTPool_start
+ */
+int QPTPool_set_queue_limit(struct QPTPool * ctx, const size_t limit);
+
+/*
+ * pin the threads to the CPUs of the NUMA nodes, in contiguous blocks
+ * of threads per node, and have threads without work steal from
+ * threads on the same node first; memory that each thread allocates
+ * and first touches (its queue items in depth first pools, and
+ * anything allocated by the thread init function) is then local to
+ * its node; call before QPTPool_start
+ * returns the number of nodes, or 0 if no NUMA information was found
+ */
+size_t QPTPool_set_numa(struct QPTPool * ctx);
+
+/* run a function in each thread when it starts; call before QPTPool_start */
+int QPTPool_set_thread_init(struct QPTPool * ctx, QPTPoolThreadInit_t func);
+
+/*
+ * serve a lower priority level once it has been passed over this many
+ * times in a row (default 16); 0 always serves the highest priority
+ * level that has work; call before QPTPool_start
+ */
+int QPTPool_set_starvation_limit(struct QPTPool * ctx, const size_t limit);
+
+/* run a function for each thread when the pool is cancelled; call before QPTPool_start */
+int QPTPool_set_cancel(struct QPTPool * ctx, QPTPoolCancel_t func);
+
 /* start the threads */
 size_t QPTPool_start(struct QPTPool * ctx, void * args);
 
@@ -104,6 +215,52 @@ size_t QPTPool_start(struct QPTPool * ctx, void * args);
 /* id will push to the thread's next scheduled queue, rather than directly onto queue[id]*/
 void QPTPool_enqueue(struct QPTPool * ctx, const size_t id, QPTPoolFunc_t func, void * new_work);
 
+/* QPTPool_enqueue at a priority level other than QPTPOOL_PRIORITY_NORMAL */
+void QPTPool_enqueue_priority(struct QPTPool * ctx, const size_t id, const enum QPTPoolPriority priority,
+                              QPTPoolFunc_t func, void * new_work);
+
+/*
+ * stop processing work; may be called from any thread, and more than
+ * once. Items that have not been started are passed to free(3)
+ * instead of being processed, work enqueued afterwards is freed
+ * instead of being queued, and the function set with
+ * QPTPool_set_cancel is run once for each thread so that the items
+ * being processed can be interrupted. The threads still have to be
+ * joined with QPTPool_wait.
+ */
+void QPTPool_cancel(struct QPTPool * ctx);
+
+/* whether or not QPTPool_cancel has been called */
+int QPTPool_cancelled(struct QPTPool * ctx);
+
+/*
+ * Work that is collected and then enqueued all at once
+ *
+ * QPTPool_enqueue takes locks, updates the shared counters, and wakes
+ * up threads for every item. A batch does each of these once (once per
+ * thread that receives part of the batch in breadth first pools).
+ */
+struct QPTPoolBatch {
+    struct sll items;
+};
+
+/* suggested number of items to collect before enqueuing a batch, so that the threads do not wait too long for work */
+#define QPTPOOL_BATCH_SIZE 1024
+
+void QPTPool_batch_init(struct QPTPoolBatch * batch);
+
+/* add an item to the batch; returns the number of items in the batch */
+size_t QPTPool_batch_add(struct QPTPoolBatch * batch, QPTPoolFunc_t func, void * new_work);
+
+/*
+ * enqueue every item in the batch at QPTPOOL_PRIORITY_NORMAL and empty
+ * the batch; breadth first pools spread the batch across all threads,
+ * starting with the thread's next scheduled queue, and depth first
+ * pools push the whole batch onto the front of queue[id]
+ * returns the number of items that were in the batch
+ */
+size_t QPTPool_enqueue_batch(struct QPTPool * ctx, const size_t id, struct QPTPoolBatch * batch);
+
 /* wait for all work to be processed and join threads*/
 void QPTPool_wait(struct QPTPool * ctx);
 
@@ -121,6 +278,18 @@ size_t QPTPool_threads_started(struct QPTPool * ctx);
 /* get the number of started threads that completed successfully */
 size_t QPTPool_threads_completed(struct QPTPool * ctx);
 
+/* get the largest number of items that were enqueued but not yet processed at the same time */
+size_t QPTPool_peak_incomplete(struct QPTPool * ctx);
+
+/* get the number of items that were processed inline because the queue limit was reached */
+size_t QPTPool_inlined(struct QPTPool * ctx);
+
+/* get the number of items that were freed without being processed because the pool was cancelled */
+size_t QPTPool_dropped(struct QPTPool * ctx);
+
+/* get the number of bytes the QPTPool allocates for each enqueued item, not including the item itself */
+size_t QPTPool_item_size(void);
+
 #ifdef __cplusplus
 }
 #endif
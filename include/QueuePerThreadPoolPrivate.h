@@ -66,18 +66,24 @@ OF SUCH DAMAGE.
 #define QUEUE_PER_THREAD_POOL_PRIVATE_H
 
 #include <pthread.h>
+#include <sched.h>
 
+#include "QueuePerThreadPool.h"
 #include "SinglyLinkedList.h"
 
 /* The context for a single thread in QPTPool */
 struct QPTPoolData {
-    struct sll queue;
+    struct sll queues[QPTPOOL_PRIORITIES];  /* one queue per priority level */
+    size_t skipped[QPTPOOL_PRIORITIES];     /* times each level was passed over in a row */
     pthread_mutex_t mutex;
     pthread_cond_t cv;
     size_t next_queue;
     pthread_t thread;
     size_t threads_started;
     size_t threads_successful;
+    size_t dropped;             /* items freed without being processed after QPTPool_cancel */
+    int node;                   /* NUMA node the thread is pinned to, or -1 */
+    cpu_set_t cpus;             /* CPUs of the node */
 };
 
 #endif
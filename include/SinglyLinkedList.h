@@ -67,6 +67,10 @@ OF SUCH DAMAGE.
 
 #include <stddef.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 struct node {
     void * data;
     struct node * next;
@@ -81,8 +85,13 @@ struct sll {
 
 struct sll * sll_init(struct sll * sll);
 struct sll * sll_push(struct sll * sll, void * data);
+struct sll * sll_push_front(struct sll * sll, void * data);
+void * sll_pop(struct sll * sll);
+struct sll * sll_split(struct sll * sll, struct sll * back);
 struct sll * sll_move(struct sll * dst, struct sll * src);
 struct sll * sll_move_append(struct sll * dst, struct sll * src);
+struct sll * sll_move_prepend(struct sll * dst, struct sll * src);
+struct sll * sll_move_first(struct sll * dst, struct sll * src, const size_t count);
 size_t sll_get_size(struct sll * sll);
 
 /* functions for looping over a sll */
@@ -98,4 +107,8 @@ void * sll_node_data(struct node * node);
 
 void sll_destroy(struct sll * sll, void (*destroy)(void *));
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
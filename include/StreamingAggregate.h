@@ -0,0 +1,141 @@
+/*
+This file is part of GUFI, which is part of MarFS, which is released
+under the BSD license.
+
+
+Copyright (c) 2017, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2017, Los Alamos National Security, LLC All rights reserved.
+Copyright 2017. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+
+
+
+#ifndef STREAMING_AGGREGATE_H
+#define STREAMING_AGGREGATE_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  Running aggregates of rows, grouped by their key columns.
+
+  The aggregate is described by a comma separated list
+  with one operation per column of the incoming rows:
+
+      key   - the column is part of the group key
+      count - number of non-NULL values
+      sum   - sum of the values
+      min   - smallest value
+      max   - largest value
+
+  e.g. "key,count,sum" groups rows of (uid, 1, size)
+  by uid and keeps the number of rows and total size.
+
+  Values are treated as numbers. Memory usage is
+  proportional to the number of groups, not rows.
+
+  A single StreamingAggregate should only be used by
+  one thread at a time.
+*/
+
+enum StreamingAggregateOp {
+    SA_KEY,
+    SA_COUNT,
+    SA_SUM,
+    SA_MIN,
+    SA_MAX,
+};
+
+struct StreamingAggregateGroup;
+
+struct StreamingAggregate {
+    enum StreamingAggregateOp * ops;
+    size_t columns;
+
+    struct StreamingAggregateGroup ** buckets;
+    size_t bucket_count;
+    size_t groups;
+};
+
+/* returns 0 on success, non-zero if the spec could not be parsed */
+int StreamingAggregate_init(struct StreamingAggregate * sa, const char * spec);
+
+/* add a row (the same arguments as a sqlite3_exec callback); returns 0 on success */
+int StreamingAggregate_add(struct StreamingAggregate * sa, const int count, char ** data);
+
+/* move all groups in src into dst; src is left empty; returns 0 on success */
+int StreamingAggregate_merge(struct StreamingAggregate * dst, struct StreamingAggregate * src);
+
+/*
+  call callback once per group, in key order, with the same
+  arguments as a sqlite3_exec callback; NULL values are passed
+  as empty strings
+  returns the number of groups that were passed to callback
+*/
+size_t StreamingAggregate_output(struct StreamingAggregate * sa,
+                                 int (*callback)(void *, int, char **, char **),
+                                 void * args);
+
+void StreamingAggregate_destroy(struct StreamingAggregate * sa);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
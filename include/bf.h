@@ -77,6 +77,7 @@ OF SUCH DAMAGE.
 #define MAXSTRIDE 1000000000   // maximum records per stripe
 #define DBNAME "db.db"
 #define DBNAME_LEN (sizeof(DBNAME) - 1)
+#define SUM_HIST_BUCKETS 64    // log-scale size and age histogram buckets in struct sum
 
 struct globalpathstate {
   char gpath[MAXPATH];
@@ -86,15 +87,40 @@ struct globalpathstate {
 
 extern struct globalpathstate gps[MAXPTHREAD];
 
+/*
+ * the mins, maxes, and totals are each kept contiguous so that they can
+ * be folded as arrays of lanes (see sumit and tsumit); the mins and maxes
+ * are in the same order, with size and blocks (files only) last
+ */
 struct sum {
-  long long int totfiles;
-  long long int totlinks;
   long long int minuid;
-  long long int maxuid;
   long long int mingid;
-  long long int maxgid;
+  long long int minctime;
+  long long int minmtime;
+  long long int minatime;
+  long long int mincrtime;
+  long long int minossint1;
+  long long int minossint2;
+  long long int minossint3;
+  long long int minossint4;
   long long int minsize;
+  long long int minblocks;
+
+  long long int maxuid;
+  long long int maxgid;
+  long long int maxctime;
+  long long int maxmtime;
+  long long int maxatime;
+  long long int maxcrtime;
+  long long int maxossint1;
+  long long int maxossint2;
+  long long int maxossint3;
+  long long int maxossint4;
   long long int maxsize;
+  long long int maxblocks;
+
+  long long int totfiles;
+  long long int totlinks;
   long long int totltk;
   long long int totmtk;
   long long int totltm;
@@ -102,34 +128,27 @@ struct sum {
   long long int totmtg;
   long long int totmtt;
   long long int totsize;
-  long long int minctime;
-  long long int maxctime;
-  long long int minmtime;
-  long long int maxmtime;
-  long long int minatime;
-  long long int maxatime;
-  long long int minblocks;
-  long long int maxblocks;
   long long int totxattr;
+  long long int totossint1;
+  long long int totossint2;
+  long long int totossint3;
+  long long int totossint4;
+
   long long int setit;
   long long int totsubdirs;
   long long int maxsubdirfiles;
   long long int maxsubdirlinks;
   long long int maxsubdirsize;
-  long long int mincrtime;
-  long long int maxcrtime;
-  long long int minossint1;
-  long long int maxossint1;
-  long long int totossint1;
-  long long int minossint2;
-  long long int maxossint2;
-  long long int totossint2;
-  long long int minossint3;
-  long long int maxossint3;
-  long long int totossint3;
-  long long int minossint4;
-  long long int maxossint4;
-  long long int totossint4;
+
+  /*
+   * log-scale histograms of the files' sizes and ages (time since mtime),
+   * counted in files and in bytes (see hist_bucket); these 4 arrays are
+   * also contiguous so that tsumit can add them as lanes
+   */
+  long long int sizehistfiles[SUM_HIST_BUCKETS];
+  long long int sizehistbytes[SUM_HIST_BUCKETS];
+  long long int agehistfiles[SUM_HIST_BUCKETS];
+  long long int agehistbytes[SUM_HIST_BUCKETS];
 };
 
 typedef enum ShowResults {
@@ -193,6 +212,29 @@ struct input {
    int keep_matime;
    size_t output_buffer_size;
    OpenMode open_mode;
+   int read_subdirs;              // get subdirectories from the subdirs table instead of readdir
+   size_t mmap_size;              // memory map read-only databases and let SQLite read up to this many bytes from the map
+   size_t prefetch;               // number of subdirectory databases per directory to prefetch when they are enqueued
+   char stream[MAXSQL];           // per-column streaming aggregate operations (see StreamingAggregate.h)
+   size_t stream_len;
+   size_t topk;                   // only keep the rows with the k largest values in the first column
+   char topk_bound[MAXSQL];       // summary column that bounds the first column of each directory's rows
+   char prune[MAXSQL];            // ranges that matching entries fall within (see RangePrune.h)
+   size_t prune_len;
+   size_t hist_shift;             // log2 of the ratio between the bounds of consecutive histogram buckets
+   long long int hist_now;        // time that the histogram ages are measured from
+   char result_cache[MAXPATH];    // file to cache the rows printed for each directory in (see ResultCache.h)
+   char rollups[MAXPATH];         // file of rollups for bfti to compute into every directory
+   int traversal;                 // order that the QPTPool processes directories in (enum QPTPoolPolicy)
+   size_t traversal_cap;          // directories in flight before a hybrid traversal switches to depth first
+   int queue_stats;               // print the peak number of queued directories
+   size_t max_queued;             // directories in flight before new ones are processed inline (0 for no limit)
+   int numa;                      // pin threads to NUMA nodes and allocate their output buffers on their nodes
+   size_t split_entries;          // query entries tables with more rowids than this in ranges of this many rowids (0 to not split)
+   size_t shard_entries;          // put at most this many entries into each database of a directory (0 for one database)
+   int subdirs;                   // walk the new index and fill in the subdirs table of each directory
+   size_t max_results;            // stop once this many rows have been printed (0 for no limit)
+   size_t timeout;                // stop querying after this many seconds (0 for no limit)
 
    /* used by gufi_query (cumulative times) and gufi_stat (regular output) */
    int terse;
@@ -289,6 +331,8 @@ struct work {
    char          osstext2[MAXXATTR];
    char          pinodec[128];
    int           suspect;  // added for bfwreaddirplus2db for suspect
+   void*         index;    // added for gufi_query: packed index containing this directory (NULL if not packed)
+   long long int tocid;    // added for gufi_query: table of contents id of this directory in a packed index
 };
 
 extern char xattrdelim[];
@@ -81,8 +81,20 @@ extern char *rsqli;
 extern char *esql;
 extern char *esqli;
 
+extern char *sdsql;
+extern char *sdsqli;
+
+extern char *shsql;
+extern char *shsqli;
+
 extern char *ssql;
 extern char *tsql;
+extern char *tosql;
+
+extern char *tocsql;
+extern char *tocsqli;
+extern char *tocidxsql;
+extern char *packssql;
 
 extern char *vesql;
 
@@ -100,9 +112,22 @@ sqlite3 * attachdb(const char *name, sqlite3 *db, const char *dbn, const OpenMod
 
 sqlite3 * detachdb(const char *name, sqlite3 *db, const char *dbn);
 
+/*
+ * shadow the entries table of schema, and the views that read it, with
+ * temporary views of the rows with rowids in [lo, hi)
+ * returns the number of views created, which are listed in names
+ */
+size_t restrict_entries(sqlite3 *db, const char *schema,
+                        const sqlite3_int64 lo, const sqlite3_int64 hi,
+                        char names[][MAXSQL], const size_t max_names);
+
+/* drop the views created by restrict_entries */
+void unrestrict_entries(sqlite3 *db, char names[][MAXSQL], const size_t count);
+
 int create_table_wrapper(const char *name, sqlite3 * db, const char * sql_name, const char * sql, int (*callback)(void*,int,char**,char**), void * args);
 
 sqlite3 * opendb(const char * name, const OpenMode mode, const int setpragmas, const int load_extensions,
+                 const size_t mmap_size,
                  int (*modifydb)(const char * name, sqlite3 * db, void * args), void * modifydb_args
                  #ifdef DEBUG
                  , struct timespec * sqlite3_open_start
@@ -121,17 +146,29 @@ int rawquerydb(const char *name, int isdir, sqlite3 *db, char *sqlstmt,
 
 int querytsdb(const char *name, struct sum *sumin, sqlite3 *db, int *recs,int ts);
 
+/*
+ * add the summaryhist (ts == 0) or treesummaryhist (ts == 1) histograms to sumin
+ * bits is the -C value of the buckets that are added; if it is 0, it is set from the first row
+ * returns -1 if there is no such table and 1 if some rows were skipped because they were built with different bits
+ */
+int queryhistdb(const char *name, struct sum *sumin, sqlite3 *db, int ts, size_t *bits);
+
 int startdb(sqlite3 *db);
 
 int stopdb(sqlite3 *db);
 
 int closedb(sqlite3 *db);
 
+int prefetchdb(const char *name);
+
 int insertdbfin(sqlite3_stmt *res);
 
 sqlite3_stmt * insertdbprep(sqlite3 *db);
 sqlite3_stmt * insertdbprepr(sqlite3 *db);
 
+sqlite3_stmt * insertsubdirprep(sqlite3 *db);
+int insertsubdirgo(const char *name, const size_t len, sqlite3 *db, sqlite3_stmt *res);
+
 int insertdbgo(struct work *pwork, sqlite3 *db, sqlite3_stmt *res);
 int insertdbgor(struct work *pwork, sqlite3 *db, sqlite3_stmt *res);
 
@@ -139,6 +176,9 @@ int insertsumdb(sqlite3 *sdb, struct work *pwork,struct sum *su);
 
 int inserttreesumdb(const char *name, sqlite3 *sdb, struct sum *su,int rectype,int uid,int gid);
 
+/* insert the nonempty histogram buckets of su, which were built with -C bits, into the summaryhist (ts == 0) or treesummaryhist (ts == 1) table */
+int inserthistdb(sqlite3 *sdb, struct sum *su, int ts, const size_t bits);
+
 int addqueryfuncs(sqlite3 *db, size_t id, size_t lvl, char * starting_dir);
 
 size_t print_results(sqlite3_stmt *res, FILE *out, const int printpath, const int printheader, const int printrows, const char *delim);
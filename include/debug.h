@@ -103,4 +103,7 @@ long double sec(uint64_t nsec);
 
 int print_timer(struct OutputBuffers * obufs, const size_t id, char * str, const size_t size, const char * name, struct start_end * se);
 
+/* same as print_timer, but for a single value instead of a pair of timestamps */
+int print_counter(struct OutputBuffers * obufs, const size_t id, char * str, const size_t size, const char * name, const uint64_t value);
+
 #endif
@@ -67,7 +67,8 @@ OF SUCH DAMAGE.
 
 #include <sys/types.h>
 
-off_t create_template(int * fd);
+/* subdirs: whether or not the databases get a subdirs table */
+off_t create_template(int * fd, const int subdirs);
 int copy_template(const int src_fd, const char * dst, off_t size, uid_t uid, gid_t gid);
 
 #endif
@@ -121,6 +121,24 @@ int sumit (struct sum *summary,struct work *pwork);
 
 int tsumit (struct sum *sumin,struct sum *smout);
 
+// same as tsumit, but without the global lock, for callers that already
+// have exclusive access to smout
+int tsumit_unlocked (struct sum *sumin,struct sum *smout);
+
+// add the summary of some of a directory's entries to the summary of
+// the rest of them (not a subdirectory, like tsumit); start sumin with
+// zeroit and then set setit so that its first entry only counts once
+int summerge (struct sum *sumin,struct sum *smout);
+
+// log-scale histogram bucket of a size or age: bucket 0 holds values
+// below 1 and bucket b holds [2^((b-1)*in.hist_shift), 2^(b*in.hist_shift))
+size_t hist_bucket(const long long int value);
+
+// inclusive lower and exclusive upper bounds of a histogram bucket
+// of an index built with -C bits (not necessarily in.hist_shift)
+long long int hist_bucket_low(const size_t bucket, const size_t bits);
+long long int hist_bucket_high(const size_t bucket, const size_t bits);
+
 // given a possibly-multi-level path of directories (final component is
 // also a dir), create the parent dirs all the way down.
 //
@@ -0,0 +1,135 @@
+/*
+This file is part of GUFI, which is part of MarFS, which is released
+under the BSD license.
+
+
+Copyright (c) 2017, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2017, Los Alamos National Security, LLC All rights reserved.
+Copyright 2017. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+
+
+#ifndef GUFI_VFS_H
+#define GUFI_VFS_H
+
+#include <stddef.h>
+
+#include <sqlite3.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Read-only VFS that serves a database image that is already in
+ * memory (e.g. a database embedded in a mmap-ed pack file). The
+ * image is passed to SQLite with the ptr and sz URI parameters.
+ */
+#define GUFI_MEM_VFS "gufi-mem"
+
+/*
+ * Read-only VFS for databases on the filesystem. The entire file is
+ * read with pread (or mmap-ed if it is larger than
+ * GUFI_RO_VFS_READ_MAX) when it is opened and the file descriptor
+ * is closed immediately. Locking, journal, and WAL checks are
+ * skipped since nothing should be modifying the database.
+ */
+#define GUFI_RO_VFS "gufi-ro"
+#define GUFI_RO_VFS_READ_MAX (4 * 1024 * 1024)
+
+/*
+ * gufi-ro, but the file is always mmap-ed. Combined with
+ * PRAGMA mmap_size, SQLite reads pages directly out of the
+ * mapping instead of copying them into its page cache.
+ */
+#define GUFI_RO_MMAP_VFS "gufi-ro-mmap"
+
+/* I/O done by a gufi-ro database file */
+struct gufi_vfs_stats {
+    size_t bytes;
+    size_t syscalls;
+};
+
+/* sqlite3_file_control opcode used to get struct gufi_vfs_stats */
+#define GUFI_VFS_FCNTL_STATS 0x47554649
+
+/* sqlite3_file_control opcode used to madvise(MADV_WILLNEED) mapped databases */
+#define GUFI_VFS_FCNTL_WILLNEED 0x4755464a
+
+/* register the GUFI VFSs with SQLite - safe to call more than once */
+int gufi_vfs_init();
+
+/* write a URI that opens the sz bytes at ptr as a read-only database */
+int gufi_mem_vfs_uri(char * uri, const size_t size, const char * name,
+                     const void * ptr, const sqlite3_int64 sz);
+
+/*
+ * get the I/O done by a database opened with the gufi-ro VFS
+ * stats is zeroed and SQLITE_NOTFOUND is returned for other VFSs
+ */
+int gufi_vfs_stats(sqlite3 * db, const char * schema, struct gufi_vfs_stats * stats);
+
+/*
+ * hint that the pages of a mapped database (gufi-ro-mmap, large
+ * gufi-ro files, and gufi-mem images) will be read soon
+ */
+int gufi_vfs_willneed(sqlite3 * db, const char * schema);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
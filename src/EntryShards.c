@@ -0,0 +1,190 @@
+/*
+This file is part of GUFI, which is part of MarFS, which is released
+under the BSD license.
+
+
+Copyright (c) 2017, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2017, Los Alamos National Security, LLC All rights reserved.
+Copyright 2017. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "EntryShards.h"
+#include "dbutils.h"
+#include "template_db.h"
+#include "utils.h"
+
+struct EntryShards * EntryShards_init(const char * path, struct work * dir) {
+    struct EntryShards * shards = malloc(sizeof(struct EntryShards));
+    if (!shards) {
+        return NULL;
+    }
+
+    pthread_mutex_init(&shards->mutex, NULL);
+    shards->refs = 1;
+    shards->count = 0;
+    SNPRINTF(shards->path, MAXPATH, "%s", path);
+    memcpy(&shards->dir, dir, sizeof(struct work));
+    zeroit(&shards->summary);
+
+    return shards;
+}
+
+size_t EntryShards_add(struct EntryShards * shards) {
+    pthread_mutex_lock(&shards->mutex);
+    shards->refs++;
+    const size_t shard = ++shards->count;
+    pthread_mutex_unlock(&shards->mutex);
+    return shard;
+}
+
+sqlite3 * EntryShards_open(struct EntryShards * shards, const size_t shard,
+                           const int templatefd, const off_t templatesize) {
+    char dbname[MAXPATH];
+    SNPRINTF(dbname, MAXPATH, "%s/" DBNAME ".%zu", shards->path, shard);
+
+    if (copy_template(templatefd, dbname, templatesize,
+                      shards->dir.statuso.st_uid, shards->dir.statuso.st_gid)) {
+        return NULL;
+    }
+
+    return opendb(dbname, RDWR, 1, 0, 0,
+                  NULL, NULL
+                  #ifdef DEBUG
+                  , NULL, NULL
+                  , NULL, NULL
+                  , NULL, NULL
+                  , NULL, NULL
+                  #endif
+                  );
+}
+
+void EntryShards_zeroit(struct sum * summary) {
+    zeroit(summary);
+    summary->setit = 1;
+}
+
+/* write the summary and the names of the other databases into DBNAME */
+static int EntryShards_write(struct EntryShards * shards) {
+    char dbname[MAXPATH];
+    SNPRINTF(dbname, MAXPATH, "%s/" DBNAME, shards->path);
+
+    sqlite3 * db = opendb(dbname, RDWR, 1, 0, 0,
+                          NULL, NULL
+                          #ifdef DEBUG
+                          , NULL, NULL
+                          , NULL, NULL
+                          , NULL, NULL
+                          , NULL, NULL
+                          #endif
+                          );
+    if (!db) {
+        return 1;
+    }
+
+    int rc = 0;
+    sqlite3_stmt * res = NULL;
+    if (sqlite3_prepare_v2(db, shsqli, -1, &res, NULL) != SQLITE_OK) {
+        fprintf(stderr, "SQL error on preparing shards insert: %s: %s\n", dbname, sqlite3_errmsg(db));
+        rc = 1;
+    }
+    else {
+        startdb(db);
+        for(size_t i = 1; i <= shards->count; i++) {
+            char name[MAXPATH];
+            const int len = SNPRINTF(name, MAXPATH, DBNAME ".%zu", i);
+            sqlite3_bind_text(res, 1, name, len, SQLITE_STATIC);
+            if (sqlite3_step(res) != SQLITE_DONE) {
+                fprintf(stderr, "SQL error on inserting shard %s: %s: %s\n", name, dbname, sqlite3_errmsg(db));
+                rc = 1;
+            }
+            sqlite3_reset(res);
+        }
+        stopdb(db);
+        sqlite3_finalize(res);
+    }
+
+    insertsumdb(db, &shards->dir, &shards->summary);
+    closedb(db);
+
+    return rc;
+}
+
+int EntryShards_done(struct EntryShards * shards, struct sum * summary) {
+    pthread_mutex_lock(&shards->mutex);
+    summerge(summary, &shards->summary);
+    const size_t refs = --shards->refs;
+    pthread_mutex_unlock(&shards->mutex);
+
+    if (refs) {
+        return 0;
+    }
+
+    EntryShards_write(shards);
+    return 1;
+}
+
+void EntryShards_destroy(struct EntryShards * shards) {
+    if (shards) {
+        pthread_mutex_destroy(&shards->mutex);
+        free(shards);
+    }
+}
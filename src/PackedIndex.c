@@ -0,0 +1,305 @@
+/*
+This file is part of GUFI, which is part of MarFS, which is released
+under the BSD license.
+
+
+Copyright (c) 2017, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2017, Los Alamos National Security, LLC All rights reserved.
+Copyright 2017. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+
+
+#include <fcntl.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "PackedIndex.h"
+#include "dbutils.h"
+#include "utils.h"
+#include "vfs.h"
+
+static const char LOOKUP_SQL[]   = "SELECT pack, offset, length FROM toc WHERE id = ?;";
+static const char CHILDREN_SQL[] = "SELECT id, name FROM toc WHERE parent = ?;";
+
+static int map_packs(struct PackedIndex * pi, const char * toc_name, sqlite3 * toc) {
+    /* pack names are relative to the table of contents */
+    char toc_copy[MAXPATH];
+    SNPRINTF(toc_copy, MAXPATH, "%s", toc_name);
+    const char * toc_dir = dirname(toc_copy);
+
+    sqlite3_stmt * res = NULL;
+    if (sqlite3_prepare_v2(toc, "SELECT id, name FROM packs ORDER BY id ASC;", -1, &res, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Could not read pack names from %s: %s\n", toc_name, sqlite3_errmsg(toc));
+        sqlite3_finalize(res);
+        return 1;
+    }
+
+    int rc = 0;
+    while (!rc && (sqlite3_step(res) == SQLITE_ROW)) {
+        const sqlite3_int64 pack = sqlite3_column_int64(res, 0);
+        const char * name = (const char *) sqlite3_column_text(res, 1);
+
+        /* pack ids are array indicies */
+        if ((pack < 0) || ((size_t) pack != pi->pack_count)) {
+            fprintf(stderr, "Bad pack id %lld in %s\n", (long long) pack, toc_name);
+            rc = 1;
+            break;
+        }
+
+        struct Pack * packs = realloc(pi->packs, (pi->pack_count + 1) * sizeof(struct Pack));
+        if (!packs) {
+            rc = 1;
+            break;
+        }
+        pi->packs = packs;
+
+        struct Pack * p = &pi->packs[pi->pack_count];
+        p->data = NULL;
+        p->size = 0;
+
+        char path[MAXPATH];
+        SNPRINTF(path, MAXPATH, "%s/%s", toc_dir, name);
+
+        const int fd = open(path, O_RDONLY);
+        struct stat st;
+        if ((fd < 0) || (fstat(fd, &st) != 0)) {
+            fprintf(stderr, "Could not open pack %s\n", path);
+            if (fd > -1) {
+                close(fd);
+            }
+            rc = 1;
+            break;
+        }
+
+        if (st.st_size) {
+            p->data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (p->data == MAP_FAILED) {
+                fprintf(stderr, "Could not mmap pack %s\n", path);
+                p->data = NULL;
+                rc = 1;
+            }
+            else {
+                p->size = st.st_size;
+            }
+        }
+
+        close(fd);
+        pi->pack_count++;
+    }
+
+    sqlite3_finalize(res);
+    return rc;
+}
+
+struct PackedIndex * PackedIndex_open(const char * toc_name, const size_t threads) {
+    struct PackedIndex * pi = calloc(1, sizeof(struct PackedIndex));
+    if (!pi) {
+        return NULL;
+    }
+
+    pi->threads  = threads;
+    pi->toc      = calloc(threads, sizeof(sqlite3 *));
+    pi->lookup   = calloc(threads, sizeof(sqlite3_stmt *));
+    pi->children = calloc(threads, sizeof(sqlite3_stmt *));
+    if (!pi->toc || !pi->lookup || !pi->children) {
+        PackedIndex_close(pi);
+        return NULL;
+    }
+
+    for(size_t i = 0; i < threads; i++) {
+        if (!(pi->toc[i] = opendb(toc_name, RDONLY, 0, 0, 0,
+                                  NULL, NULL
+                                  #ifdef DEBUG
+                                  , NULL, NULL
+                                  , NULL, NULL
+                                  , NULL, NULL
+                                  , NULL, NULL
+                                  #endif
+                                  ))) {
+            fprintf(stderr, "Could not open table of contents %s\n", toc_name);
+            PackedIndex_close(pi);
+            return NULL;
+        }
+
+        if ((sqlite3_prepare_v2(pi->toc[i], LOOKUP_SQL,   -1, &pi->lookup[i],   NULL) != SQLITE_OK) ||
+            (sqlite3_prepare_v2(pi->toc[i], CHILDREN_SQL, -1, &pi->children[i], NULL) != SQLITE_OK)) {
+            fprintf(stderr, "%s is not a table of contents: %s\n", toc_name, sqlite3_errmsg(pi->toc[i]));
+            PackedIndex_close(pi);
+            return NULL;
+        }
+    }
+
+    if (map_packs(pi, toc_name, pi->toc[0]) != 0) {
+        PackedIndex_close(pi);
+        return NULL;
+    }
+
+    /* the top level directory has no parent */
+    sqlite3_stmt * res = pi->children[0];
+    sqlite3_bind_int64(res, 1, 0);
+    if (sqlite3_step(res) == SQLITE_ROW) {
+        pi->root = sqlite3_column_int64(res, 0);
+    }
+    sqlite3_reset(res);
+
+    if (!pi->root) {
+        fprintf(stderr, "Could not find the top level directory in %s\n", toc_name);
+        PackedIndex_close(pi);
+        return NULL;
+    }
+
+    return pi;
+}
+
+int PackedIndex_dbname(struct PackedIndex * pi, const size_t id, const long long tocid, char * dbname, const size_t size) {
+    sqlite3_stmt * res = pi->lookup[id];
+    sqlite3_bind_int64(res, 1, tocid);
+
+    int rc = 1;
+    if (sqlite3_step(res) == SQLITE_ROW) {
+        const sqlite3_int64 pack   = sqlite3_column_int64(res, 0);
+        const sqlite3_int64 offset = sqlite3_column_int64(res, 1);
+        const sqlite3_int64 length = sqlite3_column_int64(res, 2);
+
+        if (length &&
+            (pack >= 0) && ((size_t) pack < pi->pack_count) &&
+            (offset >= 0) && ((size_t) (offset + length) <= pi->packs[pack].size)) {
+            char label[64];
+            SNPRINTF(label, sizeof(label), "packed-%lld", tocid);
+            rc = gufi_mem_vfs_uri(dbname, size, label, (char *) pi->packs[pack].data + offset, length);
+        }
+    }
+
+    sqlite3_reset(res);
+    return rc;
+}
+
+size_t PackedIndex_descend(struct PackedIndex * pi, const size_t id,
+                           struct QPTPool * ctx, struct work * passmywork,
+                           QPTPoolFunc_t func, const size_t max_level) {
+    const size_t next_level = passmywork->level + 1;
+    if (next_level > max_level) {
+        return 0;
+    }
+
+    sqlite3_stmt * res = pi->children[id];
+    sqlite3_bind_int64(res, 1, passmywork->tocid);
+
+    /*
+     * the children are only enqueued after the statement is reset
+     * because a pool with a queue limit can run them inline, and they
+     * use the same statement to find their own children
+     */
+    struct QPTPoolBatch batch;
+    QPTPool_batch_init(&batch);
+
+    size_t pushed = 0;
+    const size_t name_len = strlen(passmywork->name);
+    while (sqlite3_step(res) == SQLITE_ROW) {
+        const char * name = (const char *) sqlite3_column_text(res, 1);
+        const size_t len = sqlite3_column_bytes(res, 1);
+
+        struct work * clone = (struct work *) malloc(sizeof(struct work));
+        SNFORMAT_S(clone->name, MAXPATH, 3, passmywork->name, name_len, "/", (size_t) 1, name, len);
+        clone->level = next_level;
+        clone->root = passmywork->root;
+        clone->index = passmywork->index;
+        clone->tocid = sqlite3_column_int64(res, 0);
+
+        QPTPool_batch_add(&batch, func, clone);
+        pushed++;
+    }
+
+    sqlite3_reset(res);
+
+    QPTPool_enqueue_batch(ctx, id, &batch);
+    return pushed;
+}
+
+void PackedIndex_close(struct PackedIndex * pi) {
+    if (!pi) {
+        return;
+    }
+
+    for(size_t i = 0; i < pi->pack_count; i++) {
+        if (pi->packs[i].data) {
+            munmap(pi->packs[i].data, pi->packs[i].size);
+        }
+    }
+    free(pi->packs);
+
+    for(size_t i = 0; i < pi->threads; i++) {
+        if (pi->lookup) {
+            sqlite3_finalize(pi->lookup[i]);
+        }
+        if (pi->children) {
+            sqlite3_finalize(pi->children[i]);
+        }
+        if (pi->toc && pi->toc[i]) {
+            closedb(pi->toc[i]);
+        }
+    }
+    free(pi->children);
+    free(pi->lookup);
+    free(pi->toc);
+
+    free(pi);
+}
@@ -73,7 +73,10 @@ OF SUCH DAMAGE.
 #include <time.h>
 #endif
 
+#include <sched.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 /* struct to pass into pthread_create */
 struct worker_function_args {
@@ -94,12 +97,184 @@ struct OutputBuffers debug_output_buffers = {};
 #define QPTPool_timestamp_end(name)
 #endif
 
+/* the pool that the current thread is a worker of */
+static __thread struct QPTPool * worker_pool = NULL;
+
 /* struct that is created when something is enqueued */
 struct queue_item {
     QPTPoolFunc_t func;
     void * work;
 };
 
+/* process an item, or free it without processing it if the pool has been cancelled */
+static void process(struct QPTPool * ctx, const size_t id, struct queue_item * qi, void * args) {
+    struct QPTPoolData * tw = &ctx->data[id];
+
+    if (QPTPool_cancelled(ctx)) {
+        free(qi->work);
+        __atomic_add_fetch(&tw->dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    tw->threads_successful += !qi->func(ctx, id, qi->work, args);
+    tw->threads_started++;
+}
+
+/* the highest priority level of a thread that has work, or QPTPOOL_PRIORITIES if there is none */
+static size_t highest_level(struct QPTPoolData * tw) {
+    size_t level = 0;
+    while ((level < QPTPOOL_PRIORITIES) && !tw->queues[level].head) {
+        level++;
+    }
+    return level;
+}
+
+/*
+ * choose the level of a thread to take work from: the highest priority
+ * level with work, unless a lower priority level with work has been
+ * passed over starvation_limit times in a row
+ *
+ * call with tw->mutex locked
+ * returns QPTPOOL_PRIORITIES if the thread has no work
+ */
+static size_t choose_level(struct QPTPool * ctx, struct QPTPoolData * tw) {
+    size_t level = highest_level(tw);
+    for(size_t p = level + 1; ctx->starvation_limit && (p < QPTPOOL_PRIORITIES); p++) {
+        if (tw->queues[p].head && (tw->skipped[p] >= ctx->starvation_limit)) {
+            level = p;
+        }
+    }
+
+    for(size_t p = 0; p < QPTPOOL_PRIORITIES; p++) {
+        if (p == level) {
+            tw->skipped[p] = 0;
+        }
+        else if (tw->queues[p].head) {
+            tw->skipped[p]++;
+        }
+    }
+
+    return level;
+}
+
+/*
+ * take an item with a higher priority than the batch of work at
+ * batch_level that a breadth first thread is processing, unless the
+ * batch has been passed over starvation_limit times in a row
+ */
+static struct queue_item * take_higher(struct QPTPool * ctx, struct QPTPoolData * tw, const size_t batch_level) {
+    if (!batch_level) {
+        return NULL;
+    }
+
+    struct queue_item * qi = NULL;
+
+    pthread_mutex_lock(&tw->mutex);
+    const size_t level = highest_level(tw);
+    if ((level < batch_level) &&
+        (!ctx->starvation_limit || (tw->skipped[batch_level] < ctx->starvation_limit))) {
+        qi = sll_pop(&tw->queues[level]);
+        tw->skipped[batch_level]++;
+    }
+    else {
+        tw->skipped[batch_level] = 0;
+    }
+    pthread_mutex_unlock(&tw->mutex);
+
+    return qi;
+}
+
+/*
+ * take one item from the front of a thread's queue, or steal the back
+ * (oldest) half of another thread's queue if the thread's queue is empty
+ */
+static struct queue_item * take_one(struct QPTPool * ctx, const size_t id) {
+    struct QPTPoolData * tw = &ctx->data[id];
+
+    pthread_mutex_lock(&tw->mutex);
+    const size_t level = choose_level(ctx, tw);
+    struct queue_item * qi = (level < QPTPOOL_PRIORITIES)?sll_pop(&tw->queues[level]):NULL;
+    pthread_mutex_unlock(&tw->mutex);
+
+    /* steal from threads on the same NUMA node first */
+    for(size_t i = 1; !qi && (i < 2 * ctx->size); i++) {
+        struct QPTPoolData * victim = &ctx->data[(id + i) % ctx->size];
+        if ((victim == tw) || ((victim->node == tw->node) != (i < ctx->size))) {
+            continue;
+        }
+
+        struct sll stolen;
+        sll_init(&stolen);
+
+        /* steal the most important work */
+        pthread_mutex_lock(&victim->mutex);
+        const size_t level = highest_level(victim);
+        if (level == QPTPOOL_PRIORITIES) {
+            /* nothing to steal */
+        }
+        else if (sll_get_size(&victim->queues[level]) > 1) {
+            sll_split(&victim->queues[level], &stolen);
+        }
+        else {
+            qi = sll_pop(&victim->queues[level]);
+        }
+        pthread_mutex_unlock(&victim->mutex);
+
+        if (stolen.head) {
+            qi = sll_pop(&stolen);
+
+            pthread_mutex_lock(&tw->mutex);
+            sll_move_append(&tw->queues[level], &stolen);
+            pthread_mutex_unlock(&tw->mutex);
+        }
+    }
+
+    return qi;
+}
+
+/* depth first and hybrid pools process one item at a time */
+static void depth_first(struct QPTPool * ctx, const size_t id, void * args) {
+    while (1) {
+        pthread_mutex_lock(&ctx->mutex);
+        while (!ctx->queued && (ctx->running || ctx->incomplete)) {
+            pthread_cond_wait(&ctx->cv, &ctx->mutex);
+        }
+
+        /* not running and no more work */
+        if (!ctx->queued) {
+            pthread_mutex_unlock(&ctx->mutex);
+            break;
+        }
+
+        /*
+         * claim one of the queued items before looking for it so that
+         * threads never look for items that other threads will take
+         */
+        ctx->queued--;
+        pthread_mutex_unlock(&ctx->mutex);
+
+        /*
+         * items are only counted in queued once they are in a queue, so
+         * the claimed item can only be missed while a thief is moving
+         * it from one queue to another
+         */
+        struct queue_item * qi = NULL;
+        while (!(qi = take_one(ctx, id))) {
+            sched_yield();
+        }
+
+        process(ctx, id, qi, args);
+        free(qi);
+
+        pthread_mutex_lock(&ctx->mutex);
+        ctx->incomplete--;
+        if (!ctx->incomplete) {
+            pthread_cond_broadcast(&ctx->cv);
+        }
+        pthread_mutex_unlock(&ctx->mutex);
+    }
+}
+
 static void * worker_function(void * args) {
     #if defined(DEBUG) && defined(PER_THREAD_STATS)
     char buf[4096];
@@ -129,7 +304,21 @@ static void * worker_function(void * args) {
 
     struct QPTPoolData * tw = &wf_args->ctx->data[wf_args->id];
 
-    while (1) {
+    worker_pool = ctx;
+
+    if (ctx->nodes) {
+        pthread_setaffinity_np(pthread_self(), sizeof(tw->cpus), &tw->cpus);
+    }
+
+    if (ctx->thread_init) {
+        ctx->thread_init(ctx, wf_args->id, wf_args->args);
+    }
+
+    if (ctx->policy != QPTPOOL_BFS) {
+        depth_first(ctx, wf_args->id, wf_args->args);
+    }
+
+    while (ctx->policy == QPTPOOL_BFS) {
         QPTPool_timestamp_start(wf_sll_init);
         struct sll work; /* don't bother initializing */
         QPTPool_timestamp_end(wf_sll_init);
@@ -144,15 +333,15 @@ static void * worker_function(void * args) {
 
         /* wait for work */
         QPTPool_timestamp_start(wf_wait);
-        while ((ctx->running && (!ctx->incomplete || !tw->queue.head)) ||
-               (!ctx->running && (ctx->incomplete && !tw->queue.head))) {
+        while ((ctx->running && (!ctx->incomplete || (highest_level(tw) == QPTPOOL_PRIORITIES))) ||
+               (!ctx->running && (ctx->incomplete && (highest_level(tw) == QPTPOOL_PRIORITIES)))) {
             pthread_mutex_unlock(&ctx->mutex);
             pthread_cond_wait(&tw->cv, &tw->mutex);
             pthread_mutex_lock(&ctx->mutex);
         }
         QPTPool_timestamp_end(wf_wait);
 
-        if (!ctx->running && !ctx->incomplete && !tw->queue.head) {
+        if (!ctx->running && !ctx->incomplete && (highest_level(tw) == QPTPOOL_PRIORITIES)) {
             pthread_mutex_unlock(&ctx->mutex);
             pthread_mutex_unlock(&tw->mutex);
             break;
@@ -160,14 +349,15 @@ static void * worker_function(void * args) {
 
         pthread_mutex_unlock(&ctx->mutex);
 
-        /* moves entire queue into work and clears out queue */
+        /* moves entire queue of one priority level into work and clears out queue */
         QPTPool_timestamp_start(wf_move_queue);
-        sll_move(&work, &tw->queue);
+        const size_t level = choose_level(ctx, tw);
+        sll_move(&work, &tw->queues[level]);
         QPTPool_timestamp_end(wf_move_queue);
 
         #if defined(DEBUG) && defined (QPTPOOL_QUEUE_SIZE)
         pthread_mutex_lock(&print_mutex);
-        tw->queue.size = work.size;
+        tw->queues[level].size = work.size;
 
         struct timespec now;
         clock_gettime(CLOCK_MONOTONIC, &now);
@@ -175,11 +365,15 @@ static void * worker_function(void * args) {
 
         size_t sum = 0;
         for(size_t i = 0; i < wf_args->ctx->size; i++) {
-            fprintf(stderr, "%zu ", wf_args->ctx->data[i].queue.size);
-            sum += wf_args->ctx->data[i].queue.size;
+            size_t queued = 0;
+            for(size_t p = 0; p < QPTPOOL_PRIORITIES; p++) {
+                queued += wf_args->ctx->data[i].queues[p].size;
+            }
+            fprintf(stderr, "%zu ", queued);
+            sum += queued;
         }
         fprintf(stderr, "%zu\n", sum);
-        tw->queue.size = 0;
+        tw->queues[level].size = 0;
         pthread_mutex_unlock(&print_mutex);
         #endif
 
@@ -204,7 +398,7 @@ static void * worker_function(void * args) {
             QPTPool_timestamp_start(wf_process_work);
             struct queue_item * qi = sll_node_data(w);
 
-            tw->threads_successful += !qi->func(ctx, wf_args->id, qi->work, wf_args->args);
+            process(ctx, wf_args->id, qi, wf_args->args);
 
             QPTPool_timestamp_end(wf_process_work);
 
@@ -225,13 +419,20 @@ static void * worker_function(void * args) {
             #endif
 
             work_count++;
+
+            /* higher priority work that arrived during the batch goes before the rest of the batch */
+            struct queue_item * urgent = NULL;
+            while (w && (urgent = take_higher(ctx, tw, level))) {
+                process(ctx, wf_args->id, urgent, wf_args->args);
+                free(urgent);
+                work_count++;
+            }
         }
 
         QPTPool_timestamp_end(wf_process_queue);
 
         QPTPool_timestamp_start(wf_cleanup);
         sll_destroy(&work, free);
-        tw->threads_started += work_count;
 
         pthread_mutex_lock(&ctx->mutex);
         ctx->incomplete -= work_count;
@@ -251,10 +452,19 @@ static void * worker_function(void * args) {
         #endif
     }
 
+    /*
+     * hold each thread's mutex while waking it up so that the wakeup
+     * can't happen between its check for work and its wait
+     */
     QPTPool_timestamp_start(wf_broadcast);
     for(size_t i = 0; i < ctx->size; i++) {
+        pthread_mutex_lock(&ctx->data[i].mutex);
         pthread_cond_broadcast(&ctx->data[i].cv);
+        pthread_mutex_unlock(&ctx->data[i].mutex);
     }
+    pthread_mutex_lock(&ctx->mutex);
+    pthread_cond_broadcast(&ctx->cv);
+    pthread_mutex_unlock(&ctx->mutex);
     QPTPool_timestamp_end(wf_broadcast);
 
     #if defined(DEBUG) && defined(PER_THREAD_STATS)
@@ -295,25 +505,184 @@ struct QPTPool * QPTPool_init(const size_t threads) {
     pthread_mutex_init(&ctx->mutex, NULL);
     ctx->running = 1;
     ctx->incomplete = 0;
+    ctx->policy = QPTPOOL_BFS;
+    ctx->hybrid_cap = 0;
+    pthread_cond_init(&ctx->cv, NULL);
+    ctx->queued = 0;
+    ctx->peak = 0;
+    ctx->args = NULL;
+    ctx->queue_limit = 0;
+    ctx->inlined = 0;
+    ctx->thread_init = NULL;
+    ctx->nodes = 0;
+    ctx->cancelled = 0;
+    ctx->cancel = NULL;
+    ctx->starvation_limit = 16;
 
     for(size_t i = 0; i < threads; i++) {
-        sll_init(&ctx->data[i].queue);
+        for(size_t p = 0; p < QPTPOOL_PRIORITIES; p++) {
+            sll_init(&ctx->data[i].queues[p]);
+            ctx->data[i].skipped[p] = 0;
+        }
         pthread_mutex_init(&ctx->data[i].mutex, NULL);
         pthread_cond_init(&ctx->data[i].cv, NULL);
         ctx->data[i].next_queue = i;
         ctx->data[i].thread = 0;
         ctx->data[i].threads_started = 0;
         ctx->data[i].threads_successful = 0;
+        ctx->data[i].dropped = 0;
+        ctx->data[i].node = -1;
+        CPU_ZERO(&ctx->data[i].cpus);
     }
 
     return ctx;
 }
 
+/* parse a sysfs list such as "0-3,8,10-11" into a cpu_set_t */
+static size_t parse_list(const char * list, cpu_set_t * set) {
+    CPU_ZERO(set);
+
+    size_t count = 0;
+    const char * curr = list;
+    while (*curr) {
+        char * end = NULL;
+        const unsigned long first = strtoul(curr, &end, 10);
+        if (end == curr) {
+            break;
+        }
+
+        unsigned long last = first;
+        if (*end == '-') {
+            curr = end + 1;
+            last = strtoul(curr, &end, 10);
+            if (end == curr) {
+                break;
+            }
+        }
+
+        for(unsigned long i = first; (i <= last) && (i < CPU_SETSIZE); i++) {
+            CPU_SET(i, set);
+            count++;
+        }
+
+        curr = end + (*end == ',');
+        if ((curr == end) && *end) {
+            break;
+        }
+    }
+
+    return count;
+}
+
+static size_t read_list(const char * path, cpu_set_t * set) {
+    FILE * file = fopen(path, "r");
+    if (!file) {
+        CPU_ZERO(set);
+        return 0;
+    }
+
+    char list[4096];
+    const size_t len = fread(list, sizeof(char), sizeof(list) - 1, file);
+    fclose(file);
+
+    list[len] = '\0';
+    list[strcspn(list, "\n")] = '\0';
+
+    return parse_list(list, set);
+}
+
+size_t QPTPool_set_numa(struct QPTPool * ctx) {
+    if (!ctx) {
+        return 0;
+    }
+
+    cpu_set_t online;
+    if (!read_list("/sys/devices/system/node/online", &online)) {
+        return 0;
+    }
+
+    /* nodes with CPUs */
+    const size_t max_nodes = CPU_COUNT(&online);
+    int * nodes = malloc(max_nodes * sizeof(int));
+    cpu_set_t * cpus = malloc(max_nodes * sizeof(cpu_set_t));
+    size_t node_count = 0;
+    for(int node = 0; nodes && cpus && (node < CPU_SETSIZE) && (node_count < max_nodes); node++) {
+        if (!CPU_ISSET(node, &online)) {
+            continue;
+        }
+
+        char path[256];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        if (read_list(path, &cpus[node_count])) {
+            nodes[node_count++] = node;
+        }
+    }
+
+    for(size_t i = 0; node_count && (i < ctx->size); i++) {
+        const size_t n = (i * node_count) / ctx->size;
+        ctx->data[i].node = nodes[n];
+        ctx->data[i].cpus = cpus[n];
+    }
+
+    free(cpus);
+    free(nodes);
+
+    return ctx->nodes = node_count;
+}
+
+int QPTPool_set_thread_init(struct QPTPool * ctx, QPTPoolThreadInit_t func) {
+    if (!ctx) {
+        return 1;
+    }
+
+    ctx->thread_init = func;
+    return 0;
+}
+
+int QPTPool_set_starvation_limit(struct QPTPool * ctx, const size_t limit) {
+    if (!ctx) {
+        return 1;
+    }
+
+    ctx->starvation_limit = limit;
+    return 0;
+}
+
+int QPTPool_set_cancel(struct QPTPool * ctx, QPTPoolCancel_t func) {
+    if (!ctx) {
+        return 1;
+    }
+
+    ctx->cancel = func;
+    return 0;
+}
+
+int QPTPool_set_policy(struct QPTPool * ctx, const enum QPTPoolPolicy policy, const size_t hybrid_cap) {
+    if (!ctx) {
+        return 1;
+    }
+
+    ctx->policy = policy;
+    ctx->hybrid_cap = hybrid_cap;
+    return 0;
+}
+
+int QPTPool_set_queue_limit(struct QPTPool * ctx, const size_t limit) {
+    if (!ctx) {
+        return 1;
+    }
+
+    ctx->queue_limit = limit;
+    return 0;
+}
+
 size_t QPTPool_start(struct QPTPool * ctx, void * args) {
     if (!ctx) {
         return 0;
     }
 
+    ctx->args = args;
+
     size_t started = 0;
     for(size_t i = 0; i < ctx->size; i++) {
         struct worker_function_args * wf_args = calloc(1, sizeof(struct worker_function_args));
@@ -332,18 +701,81 @@ size_t QPTPool_start(struct QPTPool * ctx, void * args) {
 
 /* id selects the next_queue variable to use, not where the work will be placed */
 void QPTPool_enqueue(struct QPTPool * ctx, const size_t id, QPTPoolFunc_t func, void * new_work) {
+    QPTPool_enqueue_priority(ctx, id, QPTPOOL_PRIORITY_NORMAL, func, new_work);
+}
+
+void QPTPool_enqueue_priority(struct QPTPool * ctx, const size_t id, const enum QPTPoolPriority priority,
+                              QPTPoolFunc_t func, void * new_work) {
     /* skip argument checking */
     /* if (ctx) { */
+        /* nothing new is started once the pool has been cancelled */
+        if (QPTPool_cancelled(ctx)) {
+            free(new_work);
+            __atomic_add_fetch(&ctx->data[id].dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+
+        /*
+         * apply backpressure by processing the work now instead of
+         * queuing it; the recursion is at most as deep as the tree
+         */
+        if (ctx->queue_limit && (worker_pool == ctx)) {
+            pthread_mutex_lock(&ctx->mutex);
+            const int full = (ctx->incomplete >= ctx->queue_limit);
+            ctx->inlined += full;
+            pthread_mutex_unlock(&ctx->mutex);
+
+            if (full) {
+                ctx->data[id].threads_successful += !func(ctx, id, new_work, ctx->args);
+                ctx->data[id].threads_started++;
+                return;
+            }
+        }
+
         struct queue_item * qi = malloc(sizeof(struct queue_item));
         qi->func = func; /* if no function is provided, the thread will segfault when it processes this item*/
         qi->work = new_work;
 
+        if (ctx->policy != QPTPOOL_BFS) {
+            /* count the item first so that it is never completed before it is counted */
+            pthread_mutex_lock(&ctx->mutex);
+            ctx->incomplete++;
+            if (ctx->peak < ctx->incomplete) {
+                ctx->peak = ctx->incomplete;
+            }
+            const int breadth = (ctx->policy == QPTPOOL_HYBRID) && (ctx->incomplete <= ctx->hybrid_cap);
+            pthread_mutex_unlock(&ctx->mutex);
+
+            if (breadth) {
+                pthread_mutex_lock(&ctx->data[ctx->data[id].next_queue].mutex);
+                sll_push(&ctx->data[ctx->data[id].next_queue].queues[priority], qi);
+                pthread_mutex_unlock(&ctx->data[ctx->data[id].next_queue].mutex);
+
+                ctx->data[id].next_queue = (ctx->data[id].next_queue + 1) % ctx->size;
+            }
+            else {
+                pthread_mutex_lock(&ctx->data[id].mutex);
+                sll_push_front(&ctx->data[id].queues[priority], qi);
+                pthread_mutex_unlock(&ctx->data[id].mutex);
+            }
+
+            /* only items that are in a queue can be claimed */
+            pthread_mutex_lock(&ctx->mutex);
+            ctx->queued++;
+            pthread_cond_signal(&ctx->cv);
+            pthread_mutex_unlock(&ctx->mutex);
+            return;
+        }
+
         pthread_mutex_lock(&ctx->data[ctx->data[id].next_queue].mutex);
-        sll_push(&ctx->data[ctx->data[id].next_queue].queue, qi);
+        sll_push(&ctx->data[ctx->data[id].next_queue].queues[priority], qi);
         pthread_mutex_unlock(&ctx->data[ctx->data[id].next_queue].mutex);
 
         pthread_mutex_lock(&ctx->mutex);
         ctx->incomplete++;
+        if (ctx->peak < ctx->incomplete) {
+            ctx->peak = ctx->incomplete;
+        }
         pthread_mutex_unlock(&ctx->mutex);
 
         pthread_cond_broadcast(&ctx->data[ctx->data[id].next_queue].cv);
@@ -352,6 +784,117 @@ void QPTPool_enqueue(struct QPTPool * ctx, const size_t id, QPTPoolFunc_t func,
     /* } */
 }
 
+void QPTPool_batch_init(struct QPTPoolBatch * batch) {
+    /* skip argument checking */
+    sll_init(&batch->items);
+}
+
+size_t QPTPool_batch_add(struct QPTPoolBatch * batch, QPTPoolFunc_t func, void * new_work) {
+    /* skip argument checking */
+    struct queue_item * qi = malloc(sizeof(struct queue_item));
+    qi->func = func;
+    qi->work = new_work;
+    sll_push(&batch->items, qi);
+    return sll_get_size(&batch->items);
+}
+
+size_t QPTPool_enqueue_batch(struct QPTPool * ctx, const size_t id, struct QPTPoolBatch * batch) {
+    /* skip argument checking */
+    const size_t count = sll_get_size(&batch->items);
+    if (!count) {
+        return 0;
+    }
+
+    /* nothing new is started once the pool has been cancelled */
+    if (QPTPool_cancelled(ctx)) {
+        sll_loop(&batch->items, node) {
+            free(((struct queue_item *) sll_node_data(node))->work);
+        }
+        sll_destroy(&batch->items, free);
+        __atomic_add_fetch(&ctx->data[id].dropped, count, __ATOMIC_RELAXED);
+        return count;
+    }
+
+    /* backpressure decides item by item whether to queue or to process inline */
+    if (ctx->queue_limit && (worker_pool == ctx)) {
+        struct queue_item * qi = NULL;
+        while ((qi = sll_pop(&batch->items))) {
+            QPTPool_enqueue(ctx, id, qi->func, qi->work);
+            free(qi);
+        }
+        return count;
+    }
+
+    /* count the items first so that they are never completed before they are counted */
+    pthread_mutex_lock(&ctx->mutex);
+    ctx->incomplete += count;
+    if (ctx->peak < ctx->incomplete) {
+        ctx->peak = ctx->incomplete;
+    }
+    const int breadth = (ctx->policy == QPTPOOL_BFS) ||
+                        ((ctx->policy == QPTPOOL_HYBRID) && (ctx->incomplete <= ctx->hybrid_cap));
+    pthread_mutex_unlock(&ctx->mutex);
+
+    if (breadth) {
+        /* give each thread a contiguous part of the batch */
+        const size_t parts = (count < ctx->size)?count:ctx->size;
+        for(size_t i = 0; i < parts; i++) {
+            struct QPTPoolData * target = &ctx->data[ctx->data[id].next_queue];
+
+            struct sll part;
+            sll_move_first(&part, &batch->items, sll_get_size(&batch->items) / (parts - i));
+
+            pthread_mutex_lock(&target->mutex);
+            sll_move_append(&target->queues[QPTPOOL_PRIORITY_NORMAL], &part);
+            pthread_mutex_unlock(&target->mutex);
+
+            if (ctx->policy == QPTPOOL_BFS) {
+                pthread_cond_broadcast(&target->cv);
+            }
+
+            ctx->data[id].next_queue = (ctx->data[id].next_queue + 1) % ctx->size;
+        }
+    }
+    else {
+        pthread_mutex_lock(&ctx->data[id].mutex);
+        sll_move_prepend(&ctx->data[id].queues[QPTPOOL_PRIORITY_NORMAL], &batch->items);
+        pthread_mutex_unlock(&ctx->data[id].mutex);
+    }
+
+    /* only items that are in a queue can be claimed */
+    if (ctx->policy != QPTPOOL_BFS) {
+        pthread_mutex_lock(&ctx->mutex);
+        ctx->queued += count;
+        pthread_cond_broadcast(&ctx->cv);
+        pthread_mutex_unlock(&ctx->mutex);
+    }
+
+    return count;
+}
+
+void QPTPool_cancel(struct QPTPool * ctx) {
+    if (!ctx) {
+        return;
+    }
+
+    pthread_mutex_lock(&ctx->mutex);
+    const int first = !ctx->cancelled;
+    __atomic_store_n(&ctx->cancelled, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&ctx->mutex);
+
+    /* queued items are dropped by the threads; stop the ones that are running */
+    if (first && ctx->cancel) {
+        for(size_t i = 0; i < ctx->size; i++) {
+            ctx->cancel(ctx, i, ctx->args);
+        }
+    }
+}
+
+int QPTPool_cancelled(struct QPTPool * ctx) {
+    /* skip argument checking */
+    return __atomic_load_n(&ctx->cancelled, __ATOMIC_RELAXED);
+}
+
 void QPTPool_wait(struct QPTPool * ctx) {
     if (!ctx) {
         return;
@@ -359,6 +902,7 @@ void QPTPool_wait(struct QPTPool * ctx) {
 
     pthread_mutex_lock(&ctx->mutex);
     ctx->running = 0;
+    pthread_cond_broadcast(&ctx->cv);
     pthread_mutex_unlock(&ctx->mutex);
     for(size_t i = 0; i < ctx->size; i++) {
         pthread_mutex_lock(&ctx->data[i].mutex);
@@ -379,9 +923,13 @@ void QPTPool_destroy(struct QPTPool * ctx) {
             ctx->data[i].thread = 0;
             pthread_cond_destroy(&ctx->data[i].cv);
             pthread_mutex_destroy(&ctx->data[i].mutex);
-            sll_destroy(&ctx->data[i].queue, NULL);
+            for(size_t p = 0; p < QPTPOOL_PRIORITIES; p++) {
+                sll_destroy(&ctx->data[i].queues[p], NULL);
+            }
         }
 
+        pthread_cond_destroy(&ctx->cv);
+        pthread_mutex_destroy(&ctx->mutex);
         free(ctx->data);
         free(ctx);
     }
@@ -424,3 +972,26 @@ size_t QPTPool_threads_completed(struct QPTPool * ctx) {
     }
     return sum;
 }
+
+size_t QPTPool_peak_incomplete(struct QPTPool * ctx) {
+    /* skip argument checking */
+    return ctx->peak;
+}
+
+size_t QPTPool_inlined(struct QPTPool * ctx) {
+    /* skip argument checking */
+    return ctx->inlined;
+}
+
+size_t QPTPool_dropped(struct QPTPool * ctx) {
+    /* skip argument checking */
+    size_t sum = 0;
+    for(size_t i = 0; i < ctx->size; i++) {
+        sum += __atomic_load_n(&ctx->data[i].dropped, __ATOMIC_RELAXED);
+    }
+    return sum;
+}
+
+size_t QPTPool_item_size(void) {
+    return sizeof(struct queue_item) + sizeof(struct node);
+}
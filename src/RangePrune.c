@@ -0,0 +1,248 @@
+/*
+This file is part of GUFI, which is part of MarFS, which is released
+under the BSD license.
+
+
+Copyright (c) 2017, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2017, Los Alamos National Security, LLC All rights reserved.
+Copyright 2017. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+
+
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "RangePrune.h"
+
+static const char * columns[RANGE_PRUNE_COLUMNS] = {
+    "uid", "gid", "size", "blocks",
+    "atime", "mtime", "ctime", "crtime",
+    "ossint1", "ossint2", "ossint3", "ossint4",
+};
+
+static int find_column(const char * name, const size_t len) {
+    for(int i = 0; i < RANGE_PRUNE_COLUMNS; i++) {
+        if ((strlen(columns[i]) == len) && (strncmp(columns[i], name, len) == 0)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* parse one <column><op><value> and intersect it with the existing range */
+static int add_condition(struct RangePrune * rp, const char * cond, const size_t len) {
+    const size_t name_len = strspn(cond, "abcdefghijklmnopqrstuvwxyz0123456789");
+    const int col = find_column(cond, name_len);
+    if (col < 0) {
+        return 1;
+    }
+
+    const char * op = cond + name_len;
+    const size_t op_len = strspn(op, "<=>");
+
+    /* the value has to take up the rest of the condition */
+    const char * value_str = op + op_len;
+    const size_t value_len = len - name_len - op_len;
+    if (!value_len || (value_len > 20)) {
+        return 1;
+    }
+
+    char buf[21];
+    memcpy(buf, value_str, value_len);
+    buf[value_len] = '\0';
+
+    char * end = NULL;
+    errno = 0;
+    const long long value = strtoll(buf, &end, 10);
+    if (errno || (*end != '\0')) {
+        return 1;
+    }
+
+    long long min = LLONG_MIN;
+    long long max = LLONG_MAX;
+    if ((op_len == 1) && (op[0] == '<')) {
+        /* nothing is less than LLONG_MIN */
+        if (value == LLONG_MIN) {
+            min = LLONG_MAX;
+            max = LLONG_MIN;
+        }
+        else {
+            max = value - 1;
+        }
+    }
+    else if ((op_len == 2) && (strncmp(op, "<=", 2) == 0)) {
+        max = value;
+    }
+    else if (((op_len == 1) && (op[0] == '=')) ||
+             ((op_len == 2) && (strncmp(op, "==", 2) == 0))) {
+        min = value;
+        max = value;
+    }
+    else if ((op_len == 2) && (strncmp(op, ">=", 2) == 0)) {
+        min = value;
+    }
+    else if ((op_len == 1) && (op[0] == '>')) {
+        /* nothing is greater than LLONG_MAX */
+        if (value == LLONG_MAX) {
+            min = LLONG_MAX;
+            max = LLONG_MIN;
+        }
+        else {
+            min = value + 1;
+        }
+    }
+    else {
+        return 1;
+    }
+
+    if (!rp->set[col]) {
+        rp->min[col] = min;
+        rp->max[col] = max;
+        rp->set[col] = 1;
+        rp->count++;
+    }
+    else {
+        if (min > rp->min[col]) {
+            rp->min[col] = min;
+        }
+        if (max < rp->max[col]) {
+            rp->max[col] = max;
+        }
+    }
+
+    return 0;
+}
+
+int RangePrune_init(struct RangePrune * rp, const char * spec) {
+    if (!rp || !spec) {
+        return 1;
+    }
+
+    memset(rp, 0, sizeof(*rp));
+
+    const char * cond = spec;
+    while (1) {
+        const size_t len = strcspn(cond, ",");
+        if (add_condition(rp, cond, len) != 0) {
+            return 1;
+        }
+
+        if (cond[len] == '\0') {
+            break;
+        }
+
+        cond += len + 1;
+    }
+
+    return 0;
+}
+
+size_t RangePrune_sql(const struct RangePrune * rp, const char * table,
+                      char * sql, const size_t size) {
+    if (!rp || !rp->count || !table || !sql || !size) {
+        return 0;
+    }
+
+    /*
+     * a row might contain a matching entry unless one of its
+     * ranges definitely does not overlap (NULLs might overlap)
+     */
+    size_t len = snprintf(sql, size,
+                          "SELECT EXISTS (SELECT 1 FROM %s) AND NOT EXISTS (SELECT 1 FROM %s WHERE (",
+                          table, table);
+    const char * sep = "";
+    for(int i = 0; (i < RANGE_PRUNE_COLUMNS) && (len < size); i++) {
+        if (!rp->set[i]) {
+            continue;
+        }
+
+        len += snprintf(sql + len, size - len,
+                        "%s(max%s >= %lld) AND (min%s <= %lld)",
+                        sep, columns[i], rp->min[i], columns[i], rp->max[i]);
+        sep = " AND ";
+    }
+
+    if (len < size) {
+        len += snprintf(sql + len, size - len, ") IS NOT 0);");
+    }
+
+    if (len >= size) {
+        return 0;
+    }
+
+    return len;
+}
+
+int RangePrune_equals(const struct RangePrune * rp, const char * column, long long * value) {
+    if (!rp || !column) {
+        return 0;
+    }
+
+    const int col = find_column(column, strlen(column));
+    if ((col < 0) || !rp->set[col] || (rp->min[col] != rp->max[col])) {
+        return 0;
+    }
+
+    if (value) {
+        *value = rp->min[col];
+    }
+
+    return 1;
+}
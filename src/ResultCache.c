@@ -0,0 +1,255 @@
+/*
+This file is part of GUFI, which is part of MarFS, which is released
+under the BSD license.
+
+
+Copyright (c) 2017, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2017, Los Alamos National Security, LLC All rights reserved.
+Copyright 2017. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ResultCache.h"
+
+static const char RESULT_CACHE_CREATE[] =
+    "PRAGMA journal_mode=WAL;"
+    "PRAGMA synchronous=OFF;"
+    "CREATE TABLE IF NOT EXISTS results(query INT64, path TEXT, inode INT64, mtime INT64, ctime INT64, size INT64, descend INT64, rows INT64, output BLOB, PRIMARY KEY(query, path));";
+
+static const char RESULT_CACHE_GET[] =
+    "SELECT inode, mtime, ctime, size, descend, rows, output FROM results WHERE (query == ?) AND (path == ?);";
+
+static const char RESULT_CACHE_PUT[] =
+    "INSERT OR REPLACE INTO results VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?);";
+
+uint64_t ResultCache_hash(uint64_t hash, const void * data, const size_t len) {
+    const unsigned char * bytes = (const unsigned char *) data;
+    for(size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+int ResultCache_init(struct ResultCache * cache, const char * filename) {
+    if (!cache || !filename) {
+        return 1;
+    }
+
+    memset(cache, 0, sizeof(*cache));
+
+    /* the default VFS, since the file is shared between threads */
+    if (sqlite3_open_v2(filename, &cache->db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Could not open result cache %s: %s\n", filename, sqlite3_errmsg(cache->db));
+        ResultCache_destroy(cache);
+        return 1;
+    }
+
+    /* the other threads write to the same file */
+    sqlite3_busy_timeout(cache->db, 60000);
+
+    char * err = NULL;
+    if (sqlite3_exec(cache->db, RESULT_CACHE_CREATE, NULL, NULL, &err) != SQLITE_OK) {
+        fprintf(stderr, "Could not set up result cache %s: %s\n", filename, err);
+        sqlite3_free(err);
+        ResultCache_destroy(cache);
+        return 1;
+    }
+
+    if ((sqlite3_prepare_v2(cache->db, RESULT_CACHE_GET, -1, &cache->get, NULL) != SQLITE_OK) ||
+        (sqlite3_prepare_v2(cache->db, RESULT_CACHE_PUT, -1, &cache->put, NULL) != SQLITE_OK)) {
+        fprintf(stderr, "Could not prepare result cache queries: %s\n", sqlite3_errmsg(cache->db));
+        ResultCache_destroy(cache);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* make sure the buffer can hold size bytes */
+static int reserve(struct ResultCache * cache, const size_t size) {
+    if (size <= cache->capacity) {
+        return 0;
+    }
+
+    size_t capacity = cache->capacity?cache->capacity:4096;
+    while (capacity < size) {
+        capacity *= 2;
+    }
+
+    char * buf = realloc(cache->buf, capacity);
+    if (!buf) {
+        return 1;
+    }
+
+    cache->buf = buf;
+    cache->capacity = capacity;
+    return 0;
+}
+
+int ResultCache_get(struct ResultCache * cache, const uint64_t query, const char * path,
+                    const struct stat * st, int * descend) {
+    cache->len = 0;
+    cache->rows = 0;
+
+    sqlite3_bind_int64(cache->get, 1, (sqlite3_int64) query);
+    sqlite3_bind_text (cache->get, 2, path, -1, SQLITE_STATIC);
+
+    int hit = 0;
+    if ((sqlite3_step(cache->get) == SQLITE_ROW) &&
+        (sqlite3_column_int64(cache->get, 0) == (sqlite3_int64) st->st_ino) &&
+        (sqlite3_column_int64(cache->get, 1) == (sqlite3_int64) st->st_mtime) &&
+        (sqlite3_column_int64(cache->get, 2) == (sqlite3_int64) st->st_ctime) &&
+        (sqlite3_column_int64(cache->get, 3) == (sqlite3_int64) st->st_size)) {
+        const size_t len = sqlite3_column_bytes(cache->get, 6);
+        const void * output = sqlite3_column_blob(cache->get, 6);
+        if (reserve(cache, len) == 0) {
+            if (len) {
+                memcpy(cache->buf, output, len);
+            }
+            cache->len = len;
+            cache->rows = sqlite3_column_int64(cache->get, 5);
+            *descend = sqlite3_column_int(cache->get, 4);
+            hit = 1;
+        }
+    }
+
+    sqlite3_reset(cache->get);
+    sqlite3_clear_bindings(cache->get);
+
+    if (hit) {
+        cache->hits++;
+    }
+    else {
+        cache->misses++;
+    }
+
+    return hit;
+}
+
+int ResultCache_add_row(struct ResultCache * cache, const int count, char ** data, const char delim) {
+    /* one delimiter per column + newline */
+    size_t row_len = count + 1;
+    for(int i = 0; i < count; i++) {
+        row_len += data[i]?strlen(data[i]):0;
+    }
+
+    if (reserve(cache, cache->len + row_len) != 0) {
+        return 1;
+    }
+
+    char * buf = cache->buf + cache->len;
+    for(int i = 0; i < count; i++) {
+        if (data[i]) {
+            const size_t len = strlen(data[i]);
+            memcpy(buf, data[i], len);
+            buf += len;
+        }
+        *(buf++) = delim;
+    }
+    *buf = '\n';
+
+    cache->len += row_len;
+    cache->rows++;
+    return 0;
+}
+
+int ResultCache_put(struct ResultCache * cache, const uint64_t query, const char * path,
+                    const struct stat * st, const int descend) {
+    sqlite3_bind_int64(cache->put, 1, (sqlite3_int64) query);
+    sqlite3_bind_text (cache->put, 2, path, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(cache->put, 3, (sqlite3_int64) st->st_ino);
+    sqlite3_bind_int64(cache->put, 4, (sqlite3_int64) st->st_mtime);
+    sqlite3_bind_int64(cache->put, 5, (sqlite3_int64) st->st_ctime);
+    sqlite3_bind_int64(cache->put, 6, (sqlite3_int64) st->st_size);
+    sqlite3_bind_int  (cache->put, 7, descend);
+    sqlite3_bind_int64(cache->put, 8, (sqlite3_int64) cache->rows);
+    sqlite3_bind_blob (cache->put, 9, cache->buf, (int) cache->len, SQLITE_STATIC);
+
+    const int rc = (sqlite3_step(cache->put) == SQLITE_DONE)?0:1;
+    if (rc) {
+        fprintf(stderr, "Could not cache results of %s: %s\n", path, sqlite3_errmsg(cache->db));
+    }
+
+    sqlite3_reset(cache->put);
+    sqlite3_clear_bindings(cache->put);
+
+    return rc;
+}
+
+void ResultCache_destroy(struct ResultCache * cache) {
+    if (!cache) {
+        return;
+    }
+
+    sqlite3_finalize(cache->get);
+    sqlite3_finalize(cache->put);
+    sqlite3_close(cache->db);
+    free(cache->buf);
+
+    cache->db = NULL;
+    cache->get = NULL;
+    cache->put = NULL;
+    cache->buf = NULL;
+    cache->len = 0;
+    cache->capacity = 0;
+    cache->rows = 0;
+}
@@ -98,6 +98,75 @@ struct sll * sll_push(struct sll * sll, void * data) {
     return sll;
 }
 
+struct sll * sll_push_front(struct sll * sll, void * data) {
+    if (!sll) {
+        return NULL;
+    }
+
+    struct node * node = calloc(1, sizeof(struct node));
+    node->data = data;
+    node->next = sll->head;
+
+    if (!sll->tail) {
+        sll->tail = node;
+    }
+
+    sll->head = node;
+
+    sll->size++;
+
+    return sll;
+}
+
+/* remove the head node and return its data */
+void * sll_pop(struct sll * sll) {
+    if (!sll || !sll->head) {
+        return NULL;
+    }
+
+    struct node * node = sll->head;
+    void * data = node->data;
+
+    sll->head = node->next;
+    if (!sll->head) {
+        sll->tail = NULL;
+    }
+
+    sll->size--;
+
+    free(node);
+    return data;
+}
+
+/* move the back half of sll into back, which is overwritten */
+struct sll * sll_split(struct sll * sll, struct sll * back) {
+    if (!sll || !back) {
+        return NULL;
+    }
+
+    sll_clear(back);
+
+    const size_t keep = sll->size - (sll->size / 2);
+    if (!keep || (keep == sll->size)) {
+        return back;
+    }
+
+    struct node * last = sll->head;
+    for(size_t i = 1; i < keep; i++) {
+        last = last->next;
+    }
+
+    back->head = last->next;
+    back->tail = sll->tail;
+    back->size = sll->size - keep;
+
+    last->next = NULL;
+    sll->tail = last;
+    sll->size = keep;
+
+    return back;
+}
+
 struct sll * sll_move(struct sll * dst, struct sll * src) {
     if (!dst || !src) {
         return NULL;
@@ -133,6 +202,59 @@ struct sll * sll_move_append(struct sll * dst, struct sll * src) {
     return dst;
 }
 
+struct sll * sll_move_prepend(struct sll * dst, struct sll * src) {
+    if (!dst || !src) {
+        return NULL;
+    }
+
+    /* src is prepended to dst and then cleared */
+    if (src->tail) {
+        src->tail->next = dst->head;
+        dst->head = src->head;
+    }
+
+    if (!dst->tail) {
+        dst->tail = src->tail;
+    }
+
+    dst->size += src->size;
+
+    sll_clear(src);
+    return dst;
+}
+
+/* move the first count nodes of src into dst, which is overwritten */
+struct sll * sll_move_first(struct sll * dst, struct sll * src, const size_t count) {
+    if (!dst || !src) {
+        return NULL;
+    }
+
+    if (count >= src->size) {
+        return sll_move(dst, src);
+    }
+
+    sll_clear(dst);
+    if (!count) {
+        return dst;
+    }
+
+    struct node * last = src->head;
+    for(size_t i = 1; i < count; i++) {
+        last = last->next;
+    }
+
+    dst->head = src->head;
+    dst->tail = last;
+    dst->size = count;
+
+    src->head = last->next;
+    src->size -= count;
+
+    last->next = NULL;
+
+    return dst;
+}
+
 size_t sll_get_size(struct sll * sll) {
     return sll?sll->size:0;
 }
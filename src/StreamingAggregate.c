@@ -0,0 +1,511 @@
+/*
+This file is part of GUFI, which is part of MarFS, which is released
+under the BSD license.
+
+
+Copyright (c) 2017, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2017, Los Alamos National Security, LLC All rights reserved.
+Copyright 2017. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+
+
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "StreamingAggregate.h"
+
+/* running value of a single non-key column */
+struct Value {
+    int set;
+    int is_float;
+    long long i;
+    long double d;
+};
+
+struct StreamingAggregateGroup {
+    struct StreamingAggregateGroup * next;
+    uint64_t hash;
+    char * key;        /* flag byte (1 if not NULL) + string + '\0' for each key column */
+    size_t key_len;
+    struct Value values[]; /* one per column; key columns are not used */
+};
+
+static const size_t INITIAL_BUCKETS = 64;
+
+/* FNV-1a */
+static uint64_t hash_key(const char * key, const size_t len) {
+    uint64_t hash = 14695981039346656037ULL;
+    for(size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char) key[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+int StreamingAggregate_init(struct StreamingAggregate * sa, const char * spec) {
+    if (!sa || !spec) {
+        return 1;
+    }
+
+    memset(sa, 0, sizeof(*sa));
+
+    /* one op per comma */
+    size_t columns = 1;
+    for(const char * c = spec; *c; c++) {
+        columns += (*c == ',');
+    }
+
+    sa->ops = malloc(columns * sizeof(enum StreamingAggregateOp));
+    sa->buckets = calloc(INITIAL_BUCKETS, sizeof(struct StreamingAggregateGroup *));
+    if (!sa->ops || !sa->buckets) {
+        StreamingAggregate_destroy(sa);
+        return 1;
+    }
+    sa->bucket_count = INITIAL_BUCKETS;
+
+    const char * start = spec;
+    while (1) {
+        const char * end = strchr(start, ',');
+        const size_t len = end?(size_t) (end - start):strlen(start);
+
+        #define MATCH(str) ((len == sizeof(str) - 1) && !strncmp(start, str, len))
+        enum StreamingAggregateOp op;
+        if (MATCH("key")) {
+            op = SA_KEY;
+        }
+        else if (MATCH("count")) {
+            op = SA_COUNT;
+        }
+        else if (MATCH("sum")) {
+            op = SA_SUM;
+        }
+        else if (MATCH("min")) {
+            op = SA_MIN;
+        }
+        else if (MATCH("max")) {
+            op = SA_MAX;
+        }
+        else {
+            fprintf(stderr, "Unknown aggregate operation: %.*s\n", (int) len, start);
+            StreamingAggregate_destroy(sa);
+            return 1;
+        }
+        #undef MATCH
+
+        sa->ops[sa->columns++] = op;
+
+        if (!end) {
+            break;
+        }
+
+        start = end + 1;
+    }
+
+    return 0;
+}
+
+/* serialize the key columns of a row */
+static char * make_key(struct StreamingAggregate * sa, char ** data, size_t * key_len) {
+    size_t len = 0;
+    for(size_t i = 0; i < sa->columns; i++) {
+        if (sa->ops[i] == SA_KEY) {
+            len += 1 + (data[i]?strlen(data[i]) + 1:0);
+        }
+    }
+
+    char * key = malloc(len + 1);
+    if (!key) {
+        return NULL;
+    }
+
+    char * curr = key;
+    for(size_t i = 0; i < sa->columns; i++) {
+        if (sa->ops[i] == SA_KEY) {
+            if (data[i]) {
+                *(curr++) = 1;
+                const size_t data_len = strlen(data[i]) + 1;
+                memcpy(curr, data[i], data_len);
+                curr += data_len;
+            }
+            else {
+                *(curr++) = 0;
+            }
+        }
+    }
+
+    *key_len = len;
+    return key;
+}
+
+/* values are integers if possible and floating point otherwise */
+static void parse_value(const char * str, struct Value * value) {
+    char * end = NULL;
+    errno = 0;
+    const long long i = strtoll(str, &end, 10);
+    if (*str && !*end && !errno) {
+        value->is_float = 0;
+        value->i = i;
+    }
+    else {
+        value->is_float = 1;
+        value->d = strtold(str, NULL);
+    }
+    value->set = 1;
+}
+
+static long double as_float(const struct Value * value) {
+    return value->is_float?value->d:(long double) value->i;
+}
+
+static int less_than(const struct Value * lhs, const struct Value * rhs) {
+    if (!lhs->is_float && !rhs->is_float) {
+        return lhs->i < rhs->i;
+    }
+    return as_float(lhs) < as_float(rhs);
+}
+
+/* combine two running values (or a running value and a new value) */
+static void combine(const enum StreamingAggregateOp op, struct Value * dst, const struct Value * src) {
+    if (!src->set) {
+        return;
+    }
+
+    if (!dst->set) {
+        *dst = *src;
+        return;
+    }
+
+    switch (op) {
+        case SA_COUNT:
+            dst->i += src->i;
+            break;
+        case SA_SUM:
+            if (dst->is_float || src->is_float) {
+                dst->d = as_float(dst) + as_float(src);
+                dst->is_float = 1;
+            }
+            else {
+                dst->i += src->i;
+            }
+            break;
+        case SA_MIN:
+            if (less_than(src, dst)) {
+                *dst = *src;
+            }
+            break;
+        case SA_MAX:
+            if (less_than(dst, src)) {
+                *dst = *src;
+            }
+            break;
+        case SA_KEY:
+        default:
+            break;
+    }
+}
+
+static void insert_group(struct StreamingAggregate * sa, struct StreamingAggregateGroup * group) {
+    const size_t b = group->hash & (sa->bucket_count - 1);
+    group->next = sa->buckets[b];
+    sa->buckets[b] = group;
+}
+
+/* double the number of buckets when the average chain gets long */
+static void maybe_grow(struct StreamingAggregate * sa) {
+    if (sa->groups < sa->bucket_count) {
+        return;
+    }
+
+    struct StreamingAggregateGroup ** old = sa->buckets;
+    const size_t old_count = sa->bucket_count;
+
+    struct StreamingAggregateGroup ** buckets = calloc(old_count * 2, sizeof(struct StreamingAggregateGroup *));
+    if (!buckets) {
+        /* keep going with longer chains */
+        return;
+    }
+
+    sa->buckets = buckets;
+    sa->bucket_count = old_count * 2;
+
+    for(size_t i = 0; i < old_count; i++) {
+        struct StreamingAggregateGroup * group = old[i];
+        while (group) {
+            struct StreamingAggregateGroup * next = group->next;
+            insert_group(sa, group);
+            group = next;
+        }
+    }
+
+    free(old);
+}
+
+static struct StreamingAggregateGroup * find_group(struct StreamingAggregate * sa, const uint64_t hash,
+                                                   const char * key, const size_t key_len) {
+    struct StreamingAggregateGroup * group = sa->buckets[hash & (sa->bucket_count - 1)];
+    while (group) {
+        if ((group->hash == hash) && (group->key_len == key_len) &&
+            (memcmp(group->key, key, key_len) == 0)) {
+            return group;
+        }
+        group = group->next;
+    }
+    return NULL;
+}
+
+int StreamingAggregate_add(struct StreamingAggregate * sa, const int count, char ** data) {
+    if (!sa || (count < 0) || ((size_t) count != sa->columns)) {
+        return 1;
+    }
+
+    size_t key_len = 0;
+    char * key = make_key(sa, data, &key_len);
+    if (!key) {
+        return 1;
+    }
+
+    const uint64_t hash = hash_key(key, key_len);
+    struct StreamingAggregateGroup * group = find_group(sa, hash, key, key_len);
+    if (group) {
+        free(key);
+    }
+    else {
+        group = calloc(1, sizeof(struct StreamingAggregateGroup) + sa->columns * sizeof(struct Value));
+        if (!group) {
+            free(key);
+            return 1;
+        }
+
+        group->hash = hash;
+        group->key = key;
+        group->key_len = key_len;
+
+        insert_group(sa, group);
+        sa->groups++;
+        maybe_grow(sa);
+    }
+
+    for(size_t i = 0; i < sa->columns; i++) {
+        if ((sa->ops[i] == SA_KEY) || !data[i]) {
+            continue;
+        }
+
+        struct Value value;
+        if (sa->ops[i] == SA_COUNT) {
+            value.set = 1;
+            value.is_float = 0;
+            value.i = 1;
+        }
+        else {
+            parse_value(data[i], &value);
+        }
+
+        combine(sa->ops[i], &group->values[i], &value);
+    }
+
+    return 0;
+}
+
+int StreamingAggregate_merge(struct StreamingAggregate * dst, struct StreamingAggregate * src) {
+    if (!dst || !src || (dst->columns != src->columns) ||
+        memcmp(dst->ops, src->ops, dst->columns * sizeof(enum StreamingAggregateOp))) {
+        return 1;
+    }
+
+    for(size_t b = 0; b < src->bucket_count; b++) {
+        struct StreamingAggregateGroup * group = src->buckets[b];
+        while (group) {
+            struct StreamingAggregateGroup * next = group->next;
+
+            struct StreamingAggregateGroup * existing = find_group(dst, group->hash, group->key, group->key_len);
+            if (existing) {
+                for(size_t i = 0; i < dst->columns; i++) {
+                    combine(dst->ops[i], &existing->values[i], &group->values[i]);
+                }
+                free(group->key);
+                free(group);
+            }
+            else {
+                insert_group(dst, group);
+                dst->groups++;
+                maybe_grow(dst);
+            }
+
+            group = next;
+        }
+        src->buckets[b] = NULL;
+    }
+
+    src->groups = 0;
+
+    return 0;
+}
+
+static int compare_groups(const void * lhs, const void * rhs) {
+    const struct StreamingAggregateGroup * l = * (struct StreamingAggregateGroup * const *) lhs;
+    const struct StreamingAggregateGroup * r = * (struct StreamingAggregateGroup * const *) rhs;
+    const size_t len = (l->key_len < r->key_len)?l->key_len:r->key_len;
+    const int rc = memcmp(l->key, r->key, len);
+    if (rc) {
+        return rc;
+    }
+    return (l->key_len > r->key_len) - (l->key_len < r->key_len);
+}
+
+size_t StreamingAggregate_output(struct StreamingAggregate * sa,
+                                 int (*callback)(void *, int, char **, char **),
+                                 void * args) {
+    if (!sa || !callback || !sa->groups) {
+        return 0;
+    }
+
+    /* sort the groups so that output is deterministic */
+    struct StreamingAggregateGroup ** sorted = malloc(sa->groups * sizeof(struct StreamingAggregateGroup *));
+    char ** row = malloc(sa->columns * sizeof(char *));
+    char (*numbers)[64] = malloc(sa->columns * sizeof(*numbers));
+    if (!sorted || !row || !numbers) {
+        free(numbers);
+        free(row);
+        free(sorted);
+        return 0;
+    }
+
+    size_t count = 0;
+    for(size_t b = 0; b < sa->bucket_count; b++) {
+        for(struct StreamingAggregateGroup * group = sa->buckets[b]; group; group = group->next) {
+            sorted[count++] = group;
+        }
+    }
+
+    qsort(sorted, count, sizeof(struct StreamingAggregateGroup *), compare_groups);
+
+    static char empty[] = "";
+
+    size_t output = 0;
+    for(size_t g = 0; g < count; g++) {
+        struct StreamingAggregateGroup * group = sorted[g];
+
+        char * key = group->key;
+        for(size_t i = 0; i < sa->columns; i++) {
+            if (sa->ops[i] == SA_KEY) {
+                if (*(key++)) {
+                    row[i] = key;
+                    key += strlen(key) + 1;
+                }
+                else {
+                    row[i] = empty;
+                }
+                continue;
+            }
+
+            const struct Value * value = &group->values[i];
+            if (!value->set) {
+                if (sa->ops[i] == SA_COUNT) {
+                    snprintf(numbers[i], sizeof(numbers[i]), "0");
+                    row[i] = numbers[i];
+                }
+                else {
+                    row[i] = empty;
+                }
+            }
+            else if (value->is_float) {
+                snprintf(numbers[i], sizeof(numbers[i]), "%.15Lg", value->d);
+                row[i] = numbers[i];
+            }
+            else {
+                snprintf(numbers[i], sizeof(numbers[i]), "%lld", value->i);
+                row[i] = numbers[i];
+            }
+        }
+
+        if (callback(args, (int) sa->columns, row, NULL) != 0) {
+            break;
+        }
+
+        output++;
+    }
+
+    free(numbers);
+    free(row);
+    free(sorted);
+
+    return output;
+}
+
+void StreamingAggregate_destroy(struct StreamingAggregate * sa) {
+    if (!sa) {
+        return;
+    }
+
+    for(size_t b = 0; b < sa->bucket_count; b++) {
+        struct StreamingAggregateGroup * group = sa->buckets[b];
+        while (group) {
+            struct StreamingAggregateGroup * next = group->next;
+            free(group->key);
+            free(group);
+            group = next;
+        }
+    }
+
+    free(sa->buckets);
+    free(sa->ops);
+
+    memset(sa, 0, sizeof(*sa));
+}
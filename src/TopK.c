@@ -0,0 +1,278 @@
+/*
+This file is part of GUFI, which is part of MarFS, which is released
+under the BSD license.
+
+
+Copyright (c) 2017, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2017, Los Alamos National Security, LLC All rights reserved.
+Copyright 2017. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+
+
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "TopK.h"
+
+struct TopKRow {
+    long double value;
+    char * data;   /* all columns, each followed by '\0' */
+    int count;
+};
+
+int TopK_init(struct TopK * topk, const size_t k) {
+    if (!topk || !k) {
+        return 1;
+    }
+
+    if (!(topk->rows = malloc(k * sizeof(struct TopKRow)))) {
+        return 1;
+    }
+
+    topk->k = k;
+    topk->count = 0;
+
+    return 0;
+}
+
+static void swap(struct TopKRow * lhs, struct TopKRow * rhs) {
+    struct TopKRow tmp = *lhs;
+    *lhs = *rhs;
+    *rhs = tmp;
+}
+
+static void sift_up(struct TopK * topk, size_t i) {
+    while (i) {
+        const size_t parent = (i - 1) / 2;
+        if (topk->rows[parent].value <= topk->rows[i].value) {
+            break;
+        }
+        swap(&topk->rows[parent], &topk->rows[i]);
+        i = parent;
+    }
+}
+
+static void sift_down(struct TopK * topk, size_t i) {
+    while (1) {
+        const size_t left = 2 * i + 1;
+        const size_t right = left + 1;
+        size_t smallest = i;
+
+        if ((left < topk->count) && (topk->rows[left].value < topk->rows[smallest].value)) {
+            smallest = left;
+        }
+
+        if ((right < topk->count) && (topk->rows[right].value < topk->rows[smallest].value)) {
+            smallest = right;
+        }
+
+        if (smallest == i) {
+            break;
+        }
+
+        swap(&topk->rows[smallest], &topk->rows[i]);
+        i = smallest;
+    }
+}
+
+/* take ownership of a row that has already been copied */
+static void push(struct TopK * topk, struct TopKRow * row) {
+    if (topk->count < topk->k) {
+        topk->rows[topk->count] = *row;
+        sift_up(topk, topk->count++);
+        return;
+    }
+
+    /* replace the smallest row */
+    free(topk->rows[0].data);
+    topk->rows[0] = *row;
+    sift_down(topk, 0);
+}
+
+int TopK_add(struct TopK * topk, const int count, char ** data) {
+    if (!topk || (count < 1)) {
+        return 1;
+    }
+
+    /* NULLs are the smallest possible value */
+    const long double value = data[0]?strtold(data[0], NULL):-HUGE_VALL;
+
+    /* can't beat the smallest value being kept */
+    if ((topk->count == topk->k) && (value <= topk->rows[0].value)) {
+        return 0;
+    }
+
+    size_t len = 0;
+    for(int i = 0; i < count; i++) {
+        len += (data[i]?strlen(data[i]):0) + 1;
+    }
+
+    struct TopKRow row;
+    row.value = value;
+    row.count = count;
+    if (!(row.data = malloc(len))) {
+        return 1;
+    }
+
+    char * curr = row.data;
+    for(int i = 0; i < count; i++) {
+        const size_t col_len = data[i]?strlen(data[i]):0;
+        if (col_len) {
+            memcpy(curr, data[i], col_len);
+        }
+        curr[col_len] = '\0';
+        curr += col_len + 1;
+    }
+
+    push(topk, &row);
+
+    return 0;
+}
+
+int TopK_full(const struct TopK * topk) {
+    return topk && (topk->count == topk->k);
+}
+
+long double TopK_min(const struct TopK * topk) {
+    return (topk && topk->count)?topk->rows[0].value:-HUGE_VALL;
+}
+
+int TopK_merge(struct TopK * dst, struct TopK * src) {
+    if (!dst || !src) {
+        return 1;
+    }
+
+    for(size_t i = 0; i < src->count; i++) {
+        struct TopKRow * row = &src->rows[i];
+        if ((dst->count == dst->k) && (row->value <= dst->rows[0].value)) {
+            free(row->data);
+            continue;
+        }
+
+        push(dst, row);
+    }
+
+    src->count = 0;
+
+    return 0;
+}
+
+static int compare_rows(const void * lhs, const void * rhs) {
+    const struct TopKRow * l = (const struct TopKRow *) lhs;
+    const struct TopKRow * r = (const struct TopKRow *) rhs;
+
+    /* largest first, then by the row contents so output is deterministic */
+    if (l->value != r->value) {
+        return (l->value < r->value) - (l->value > r->value);
+    }
+
+    return strcmp(l->data, r->data);
+}
+
+size_t TopK_output(struct TopK * topk,
+                   int (*callback)(void *, int, char **, char **),
+                   void * args) {
+    if (!topk || !callback || !topk->count) {
+        return 0;
+    }
+
+    /* the heap is no longer needed */
+    qsort(topk->rows, topk->count, sizeof(struct TopKRow), compare_rows);
+
+    size_t output = 0;
+    for(size_t i = 0; i < topk->count; i++) {
+        struct TopKRow * row = &topk->rows[i];
+
+        char ** data = malloc(row->count * sizeof(char *));
+        if (!data) {
+            break;
+        }
+
+        char * curr = row->data;
+        for(int c = 0; c < row->count; c++) {
+            data[c] = curr;
+            curr += strlen(curr) + 1;
+        }
+
+        const int rc = callback(args, row->count, data, NULL);
+        free(data);
+
+        if (rc != 0) {
+            break;
+        }
+
+        output++;
+    }
+
+    return output;
+}
+
+void TopK_destroy(struct TopK * topk) {
+    if (!topk) {
+        return;
+    }
+
+    for(size_t i = 0; i < topk->count; i++) {
+        free(topk->rows[i].data);
+    }
+    free(topk->rows);
+
+    topk->rows = NULL;
+    topk->k = 0;
+    topk->count = 0;
+}
@@ -64,12 +64,15 @@ OF SUCH DAMAGE.
 
 #include "bf.h"
 #include "utils.h"
+#include "QueuePerThreadPool.h"
 
+#include <getopt.h>
 #include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 
@@ -84,6 +87,52 @@ struct globalpathstate gps[MAXPTHREAD] = {};
 
 struct input in = {};
 
+// Options without letters (there are none left) are long options.
+// Tools accept them by appending their names to their getopt strings,
+// each after a '|':
+//
+//    "hHn:|traversal|queue-stats"
+//
+enum {
+   OPT_TRAVERSAL = 0x100,
+   OPT_QUEUE_STATS,
+   OPT_MAX_QUEUED,
+   OPT_NUMA,
+   OPT_SPLIT_ENTRIES,
+   OPT_SHARD_ENTRIES,
+   OPT_SUBDIRS,
+   OPT_MAX_RESULTS,
+   OPT_TIMEOUT,
+};
+
+static const struct long_option {
+   struct option opt;
+   const char *help;
+} long_options[] = {
+   {{"traversal",     required_argument, NULL, OPT_TRAVERSAL},    "  --traversal <policy>   order to process directories in: bfs (default), dfs, or hybrid[:<max in flight>] (breadth first until <max in flight> directories are queued, default 65536)"},
+   {{"queue-stats",   no_argument,       NULL, OPT_QUEUE_STATS},  "  --queue-stats          print the peak number of queued directories and the memory they used to stderr"},
+   {{"max-queued",    required_argument, NULL, OPT_MAX_QUEUED},   "  --max-queued <count>   once this many directories are queued, process new subdirectories immediately instead of queuing them"},
+   {{"numa",          no_argument,       NULL, OPT_NUMA},         "  --numa                 pin the threads to NUMA nodes, allocate their output buffers on their nodes, and steal work within nodes first (queued directories only stay on their nodes with --traversal dfs or hybrid, and aggregation databases are not node-local)"},
+   {{"split-entries", required_argument, NULL, OPT_SPLIT_ENTRIES}, "  --split-entries <rows> query entries tables with more than this many rowids in ranges of this many rowids in several threads at once"},
+   {{"shard-entries", required_argument, NULL, OPT_SHARD_ENTRIES}, "  --shard-entries <count> put at most this many entries into each database of a directory, and build the databases of larger directories in several threads at once"},
+   {{"subdirs",       no_argument,       NULL, OPT_SUBDIRS},      "  --subdirs              after building the index, walk it and record the subdirectories of each directory in its subdirs table (read by gufi_query -l)"},
+   {{"max-results",   required_argument, NULL, OPT_MAX_RESULTS},  "  --max-results <rows>   stop querying once this many rows have been printed"},
+   {{"timeout",       required_argument, NULL, OPT_TIMEOUT},      "  --timeout <seconds>    stop querying after this many seconds and exit with an error"},
+};
+
+static const size_t long_option_count = sizeof(long_options) / sizeof(long_options[0]);
+
+// find the long option whose name is the first len characters of name
+static const struct long_option *find_long_option(const char *name, const size_t len) {
+   for(size_t i = 0; i < long_option_count; i++) {
+      if ((strlen(long_options[i].opt.name) == len) &&
+          (strncmp(long_options[i].opt.name, name, len) == 0)) {
+         return &long_options[i];
+      }
+   }
+   return NULL;
+}
+
 
 
 void print_help(const char* prog_name,
@@ -99,7 +148,7 @@ void print_help(const char* prog_name,
    printf("options:\n");
 
    int ch;
-   while ((ch = *opt++)) {
+   while ((ch = *opt++) && (ch != '|')) {
       switch (ch) {
       case ':': continue;
       case 'h': printf("  -h                     help\n"); break;
@@ -109,7 +158,7 @@ void print_help(const char* prog_name,
       case 'P': printf("  -P                     print directories as they are encountered\n"); break;
       case 'N': printf("  -N                     print column-names (header) for DB results\n"); break;
       case 'V': printf("  -V                     print column-values (rows) for DB results\n"); break;
-      case 's': printf("  -s                     generate tree-summary table (in top-level DB)\n"); break;
+      case 's': printf("  -s                     generate tree-summary table (in every directory's DB)\n"); break;
       case 'b': printf("  -b                     build GUFI index tree\n"); break;
       case 'a': printf("  -a                     AND/OR (SQL query combination)\n"); break;
       case 'n': printf("  -n <threads>           number of threads\n"); break;
@@ -142,12 +191,35 @@ void print_help(const char* prog_name,
       case 'm': printf("  -m                     Keep mtime and atime same on the database files\n"); break;
       case 'B': printf("  -B <buffer size>       size of each thread's output buffer in bytes\n"); break;
       case 'w': printf("  -w                     open the database files in read-write mode instead of read only mode\n"); break;
+      case 'l': printf("  -l                     get subdirectories from the subdirs table in each database instead of calling readdir\n"); break;
+      case 'M': printf("  -M <mmap size>         memory map read-only databases and read up to this many bytes of each database from the map\n"); break;
+      case 'q': printf("  -q <prefetch depth>    start reading the databases of up to this many subdirectories of each directory when they are enqueued\n"); break;
+      case 'k': printf("  -k <k>[:<column>]      only output the k rows with the largest values in their first column; skip directories whose summary <column> is smaller than the kth value\n"); break;
+      case 'X': printf("  -X <ranges>            skip directories and subtrees whose summary and treesummary ranges cannot contain matching entries (comma separated <column><op><value>)\n"); break;
+      case 'C': printf("  -C <bits>              log2 of the ratio between consecutive size and age histogram bucket bounds (default 1)\n"); break;
+      case 'L': printf("  -L <rollups file>      also roll up the queries in this file into rollup_<name> tables (one '<name> <aggregate spec> <SQL>' per line)\n"); break;
+      case 'Q': printf("  -Q <cache db>          reuse the rows cached in this file for directories whose databases have not changed, and cache the rest\n"); break;
+      case 'U': printf("  -U <aggregate spec>    aggregate rows as they are returned instead of printing them (comma separated key, count, sum, min, or max for each column)\n"); break;
       case 'f': printf("  -f <FORMAT>            use the specified FORMAT instead of the default; output a newline after each use of FORMAT\n"); break;
       case 'j': printf("  -j                     print the information in terse form\n"); break;
 
       default: printf("print_help(): unrecognized option '%c'\n", (char)ch);
       }
    }
+
+   // long options
+   while (ch == '|') {
+      const size_t len = strcspn(opt, "|");
+      const struct long_option *lo = find_long_option(opt, len);
+      if (lo) {
+         printf("%s\n", lo->help);
+      }
+      else {
+         printf("print_help(): unrecognized option '%.*s'\n", (int) len, opt);
+      }
+      opt += len;
+      ch = *opt++;
+   }
    printf("\n");
 }
 
@@ -196,6 +268,27 @@ void show_input(struct input* in, int retval) {
    printf("in.keep_matime        = %d\n",    in->keep_matime);
    printf("in.output_buffer_size = %zu\n",   in->output_buffer_size);
    printf("in.open_mode          = %d\n",    in->open_mode);
+   printf("in.read_subdirs       = %d\n",    in->read_subdirs);
+   printf("in.mmap_size          = %zu\n",   in->mmap_size);
+   printf("in.prefetch           = %zu\n",   in->prefetch);
+   printf("in.stream             = '%s'\n",  in->stream);
+   printf("in.topk               = %zu\n",   in->topk);
+   printf("in.topk_bound         = '%s'\n",  in->topk_bound);
+   printf("in.prune              = '%s'\n",  in->prune);
+   printf("in.hist_shift         = %zu\n",   in->hist_shift);
+   printf("in.hist_now           = %lld\n",  in->hist_now);
+   printf("in.result_cache       = '%s'\n",  in->result_cache);
+   printf("in.rollups            = '%s'\n",  in->rollups);
+   printf("in.traversal          = %d\n",    in->traversal);
+   printf("in.traversal_cap      = %zu\n",   in->traversal_cap);
+   printf("in.queue_stats        = %d\n",    in->queue_stats);
+   printf("in.max_queued         = %zu\n",   in->max_queued);
+   printf("in.numa               = %d\n",    in->numa);
+   printf("in.split_entries      = %zu\n",   in->split_entries);
+   printf("in.shard_entries      = %zu\n",   in->shard_entries);
+   printf("in.subdirs            = %d\n",    in->subdirs);
+   printf("in.max_results        = %zu\n",   in->max_results);
+   printf("in.timeout            = %zu\n",   in->timeout);
    printf("in.format_set         = %d\n",    in->format_set);
    printf("in.format             = '%s'\n",  in->format);
    printf("in.terse              = %d\n",    in->terse);
@@ -250,15 +343,56 @@ int parse_cmd_line(int         argc,
    in->show_results       = PRINT;     // print without aggregating by default
    in->keep_matime        = 0;         // default to not keeping mtime and atime
    in->open_mode          = RDONLY;    // default to read-only opens
+   in->read_subdirs       = 0;         // default to readdir
+   in->mmap_size          = 0;         // default to copying pages into SQLite
+   in->prefetch           = 0;         // default to not prefetching
+   memset(in->stream,       0, MAXSQL);
+   in->stream_len         = 0;
+   in->topk               = 0;         // default to outputting every row
+   memset(in->topk_bound,   0, MAXSQL);
+   memset(in->prune,        0, MAXSQL);
+   in->prune_len          = 0;         // default to not pruning with ranges
+   in->hist_shift         = 1;         // default to power of 2 histogram buckets
+   in->hist_now           = time(NULL);
+   memset(in->result_cache, 0, MAXPATH); // default to not caching results
+   memset(in->rollups,      0, MAXPATH); // default to no user defined rollups
+   in->traversal          = QPTPOOL_BFS;
+   in->traversal_cap      = 65536;
+   in->queue_stats        = 0;
+   in->max_queued         = 0;         // default to unbounded queues
+   in->numa               = 0;         // default to letting the OS place threads
+   in->split_entries      = 0;         // default to one thread per entries table
+   in->shard_entries      = 0;         // default to one database per directory
+   in->subdirs            = 0;         // default to leaving the subdirs tables empty
+   in->max_results        = 0;         // default to printing every row
+   in->timeout            = 0;         // default to running until the walk is done
    in->format_set         = 0;
    memset(in->format,       0, MAXPATH);
    in->terse              = 0;
 
+   // split the getopt string into the letters and the long options
+   char short_opts[256];
+   const size_t short_len = strcspn(getopt_str, "|");
+   SNPRINTF(short_opts, sizeof(short_opts), "%.*s", (int) short_len, getopt_str);
+
+   struct option long_opts[sizeof(long_options) / sizeof(long_options[0]) + 1];
+   size_t long_count = 0;
+   for(const char *name = getopt_str + short_len; *name == '|';) {
+      name++;
+      const size_t len = strcspn(name, "|");
+      const struct long_option *lo = find_long_option(name, len);
+      if (lo && (long_count < long_option_count)) {
+         long_opts[long_count++] = lo->opt;
+      }
+      name += len;
+   }
+   memset(&long_opts[long_count], 0, sizeof(long_opts[long_count]));
+
    int show   = 0;
    int retval = 0;
    int ch;
    optind = 1; // reset to 1, not 0 (man 3 getopt)
-   while ( (ch = getopt(argc, argv, getopt_str)) != -1) {
+   while ( (ch = getopt_long(argc, argv, short_opts, long_opts, NULL)) != -1) {
       switch (ch) {
 
       case 'h':               // help
@@ -454,6 +588,62 @@ int parse_cmd_line(int         argc,
          in->open_mode = RDWR;
          break;
 
+      case 'l':
+         in->read_subdirs = 1;
+         break;
+
+      case 'M':
+         INSTALL_UINT(in->mmap_size, optarg, (size_t) 0, (size_t) -1, "-M");
+         break;
+
+      case 'q':
+         INSTALL_UINT(in->prefetch, optarg, (size_t) 0, (size_t) -1, "-q");
+         break;
+
+      case 'k':
+         INSTALL_UINT(in->topk, optarg, (size_t) 1, (size_t) -1, "-k");
+         if (retval) {
+            break;
+         }
+
+         {
+             /* optional summary column to prune with */
+             const char * bound = strchr(optarg, ':');
+             if (bound) {
+                 bound++;
+                 const size_t bound_len = strlen(bound);
+                 if (!bound_len || (strspn(bound, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_") != bound_len)) {
+                     fprintf(stderr, "Bad summary column for -k: '%s'\n", bound);
+                     retval = -1;
+                     break;
+                 }
+                 INSTALL_STR(in->topk_bound, bound, MAXSQL, "-k");
+             }
+         }
+         break;
+
+      case 'U':
+         INSTALL_STR(in->stream, optarg, MAXSQL, "-U");
+         in->stream_len = strlen(in->stream);
+         break;
+
+      case 'X':
+         INSTALL_STR(in->prune, optarg, MAXSQL, "-X");
+         in->prune_len = strlen(in->prune);
+         break;
+
+      case 'C':
+         INSTALL_UINT(in->hist_shift, optarg, (size_t) 1, (size_t) 63, "-C");
+         break;
+
+      case 'L':
+         INSTALL_STR(in->rollups, optarg, MAXPATH, "-L");
+         break;
+
+      case 'Q':
+         INSTALL_STR(in->result_cache, optarg, MAXPATH, "-Q");
+         break;
+
       case 'f':
           INSTALL_STR(in->format, optarg, MAXPATH, "-f");
           in->format_set = 1;
@@ -463,6 +653,63 @@ int parse_cmd_line(int         argc,
           in->terse = 1;
           break;
 
+      case OPT_TRAVERSAL:
+         if (strcmp(optarg, "bfs") == 0) {
+            in->traversal = QPTPOOL_BFS;
+         }
+         else if (strcmp(optarg, "dfs") == 0) {
+            in->traversal = QPTPOOL_DFS;
+         }
+         else if (strncmp(optarg, "hybrid", 6) == 0) {
+            in->traversal = QPTPOOL_HYBRID;
+            if (optarg[6] == ':') {
+               INSTALL_UINT(in->traversal_cap, optarg + 7, (size_t) 1, (size_t) -1, "--traversal hybrid");
+            }
+            else if (optarg[6]) {
+               retval = -1;
+            }
+         }
+         else {
+            retval = -1;
+         }
+
+         if (retval) {
+            fprintf(stderr, "--traversal must be bfs, dfs, or hybrid[:<max in flight>]\n");
+         }
+         break;
+
+      case OPT_QUEUE_STATS:
+         in->queue_stats = 1;
+         break;
+
+      case OPT_MAX_QUEUED:
+         INSTALL_UINT(in->max_queued, optarg, (size_t) 1, (size_t) -1, "--max-queued");
+         break;
+
+      case OPT_NUMA:
+         in->numa = 1;
+         break;
+
+      case OPT_SPLIT_ENTRIES:
+         INSTALL_UINT(in->split_entries, optarg, (size_t) 1, (size_t) -1, "--split-entries");
+         break;
+
+      case OPT_SHARD_ENTRIES:
+         INSTALL_UINT(in->shard_entries, optarg, (size_t) 1, (size_t) -1, "--shard-entries");
+         break;
+
+      case OPT_SUBDIRS:
+         in->subdirs = 1;
+         break;
+
+      case OPT_MAX_RESULTS:
+         INSTALL_UINT(in->max_results, optarg, (size_t) 1, (size_t) -1, "--max-results");
+         break;
+
+      case OPT_TIMEOUT:
+         INSTALL_UINT(in->timeout, optarg, (size_t) 1, (size_t) -1, "--timeout");
+         break;
+
       case '?':
          // getopt returns '?' when there is a problem.  In this case it
          // also prints, e.g. "getopt_test: illegal option -- z"
@@ -496,6 +743,43 @@ int parse_cmd_line(int         argc,
        return retval = -1;
    }
 
+   // streaming aggregates replace printed rows
+   if (in->stream_len && ((in->show_results == AGGREGATE) || in->outdb)) {
+       fprintf(stderr, "Cannot use -U with aggregation or -O\n");
+       return retval = -1;
+   }
+
+   // so do the top k rows
+   if (in->topk && ((in->show_results == AGGREGATE) || in->outdb || in->stream_len)) {
+       fprintf(stderr, "Cannot use -k with aggregation, -O, or -U\n");
+       return retval = -1;
+   }
+
+   // cached rows are printed as they were
+   if (in->result_cache[0] && ((in->show_results == AGGREGATE) || in->outdb || in->stream_len || in->topk)) {
+       fprintf(stderr, "Cannot use -Q with aggregation, -O, -U, or -k\n");
+       return retval = -1;
+   }
+
+   // the rows of split directories are not returned to the thread that caches them
+   if (in->split_entries && in->result_cache[0]) {
+       fprintf(stderr, "Cannot use --split-entries with -Q\n");
+       return retval = -1;
+   }
+
+   // directories processed inline would be attached to the same output database as their parents,
+   // and their rows would be cached with their parents' rows
+   if (in->max_queued && ((in->show_results == AGGREGATE) || in->outdb || in->result_cache[0])) {
+       fprintf(stderr, "Cannot use --max-queued with aggregation, -O, or -Q\n");
+       return retval = -1;
+   }
+
+   // the rows are counted as they are printed
+   if (in->max_results && ((in->show_results == AGGREGATE) || in->outdb || in->stream_len || in->topk || in->result_cache[0])) {
+       fprintf(stderr, "Cannot use --max-results with aggregation, -O, -U, -k, or -Q\n");
+       return retval = -1;
+   }
+
    // if there were no other errors,
    // make sure min_level <= max_level
    if (retval == 0) {
@@ -159,7 +159,7 @@ int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args)
        zeroit(&summary);
        char dbname[MAXPATH];
        SNPRINTF(dbname, MAXPATH, "%s/%s", passmywork->name, DBNAME);
-       db = opendb(dbname, RDWR, 1, 1,
+       db = opendb(dbname, RDWR, 1, 1, 0,
                    create_tables, NULL
                    #ifdef DEBUG
                    , NULL
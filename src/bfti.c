@@ -66,6 +66,7 @@ OF SUCH DAMAGE.
 #include <dirent.h>
 #include <errno.h>
 #include <grp.h>
+#include <limits.h>
 #include <pthread.h>
 #include <pwd.h>
 #include <sqlite3.h>
@@ -84,48 +85,753 @@ OF SUCH DAMAGE.
 #include "bf.h"
 #include "utils.h"
 #include "dbutils.h"
+#include "OwnerFilter.h"
 #include "QueuePerThreadPool.h"
+#include "StreamingAggregate.h"
 
 extern int errno;
 
+/* uids and gids of the entries in a tree */
+struct Owners {
+    unsigned char uids[OWNER_FILTER_BYTES];
+    unsigned char gids[OWNER_FILTER_BYTES];
+    int incomplete;   /* some ids could not be read */
+};
+
+/*
+ * user defined rollups (-L), one per line of the rollups file:
+ *
+ *     <name> <aggregate spec> <SQL>
+ *
+ * the rows that the SQL returns from each directory's database are
+ * aggregated (see StreamingAggregate.h) together with the rollups of
+ * every subdirectory, and written into the directory's rollup_<name>
+ * table, so the rollup of any subtree can be read from the top of it
+ */
+struct Rollup {
+    char name[MAXSQL];
+    char spec[MAXSQL];
+    char sql[MAXSQL];
+    char create[MAXSQL];   /* (re)create the rollup_<name> table */
+    char insert[MAXSQL];   /* insert one group into the table */
+    char select[MAXSQL];   /* read the groups back out of the table */
+};
+
+static struct Rollup *rollups = NULL;
+static size_t rollup_count = 0;
+
+/* one running aggregate per rollup */
+static struct StreamingAggregate *rollups_create(void) {
+    struct StreamingAggregate *sa = calloc(rollup_count?rollup_count:1, sizeof(struct StreamingAggregate));
+    if (!sa) {
+        return NULL;
+    }
+
+    for(size_t i = 0; i < rollup_count; i++) {
+        if (StreamingAggregate_init(&sa[i], rollups[i].spec) != 0) {
+            for(size_t j = 0; j < i; j++) {
+                StreamingAggregate_destroy(&sa[j]);
+            }
+            free(sa);
+            return NULL;
+        }
+    }
+
+    return sa;
+}
+
+static void rollups_destroy(struct StreamingAggregate *sa) {
+    if (!sa) {
+        return;
+    }
+
+    for(size_t i = 0; i < rollup_count; i++) {
+        StreamingAggregate_destroy(&sa[i]);
+    }
+    free(sa);
+}
+
+static void rollups_merge(struct StreamingAggregate *dst, struct StreamingAggregate *src) {
+    for(size_t i = 0; i < rollup_count; i++) {
+        StreamingAggregate_merge(&dst[i], &src[i]);
+    }
+}
+
+static int rollup_add(void *args, int count, char **data, char **columns) {
+    (void) columns;
+    return StreamingAggregate_add((struct StreamingAggregate *) args, count, data);
+}
+
+/*
+ * aggregate the rows of each rollup's SQL run on a database or,
+ * if stored is set, the groups already in its rollup tables
+ * returns 0 on success
+ */
+static int readrollups(const char *name, sqlite3 *db, const int stored, struct StreamingAggregate *sa) {
+    for(size_t i = 0; i < rollup_count; i++) {
+        char *err = NULL;
+        if (sqlite3_exec(db, stored?rollups[i].select:rollups[i].sql, rollup_add, &sa[i], &err) != SQLITE_OK) {
+            /* a missing table only means that the subdirectory has to be rebuilt */
+            if (!stored) {
+                fprintf(stderr, "Could not roll up %s in %s: %s\n", rollups[i].name, name, err);
+            }
+            sqlite3_free(err);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int rollup_insert(void *args, int count, char **data, char **columns) {
+    (void) columns;
+
+    sqlite3_stmt *res = (sqlite3_stmt *) args;
+    for(int i = 0; i < count; i++) {
+        sqlite3_bind_text(res, i + 1, data[i], -1, SQLITE_STATIC);
+    }
+
+    const int rc = (sqlite3_step(res) == SQLITE_DONE)?0:1;
+    sqlite3_reset(res);
+    return rc;
+}
+
+/* parse the rollups file */
+static int read_rollups_file(const char *filename) {
+    FILE *file = fopen(filename, "r");
+    if (!file) {
+        fprintf(stderr, "Could not open rollups file %s: %s\n", filename, strerror(errno));
+        return 1;
+    }
+
+    int rc = 0;
+    char line[MAXSQL * 2];
+    size_t lineno = 0;
+    while (!rc && fgets(line, sizeof(line), file)) {
+        lineno++;
+
+        size_t len = strlen(line);
+        while (len && isspace((unsigned char) line[len - 1])) {
+            line[--len] = '\0';
+        }
+
+        char *curr = line;
+        while (isspace((unsigned char) *curr)) {
+            curr++;
+        }
+
+        if (!*curr || (*curr == '#')) {
+            continue;
+        }
+
+        /* <name> <aggregate spec> <SQL> */
+        const size_t name_len = strspn(curr, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_");
+        const size_t spec_len = name_len?strcspn(curr + name_len + 1, " \t"):0;
+        if (!name_len || !isspace((unsigned char) curr[name_len]) || !spec_len) {
+            fprintf(stderr, "Bad rollup on line %zu of %s: expected '<name> <aggregate spec> <SQL>'\n", lineno, filename);
+            rc = 1;
+            break;
+        }
+
+        const char *spec = curr + name_len + 1;
+        const char *sql = spec + spec_len;
+        while (isspace((unsigned char) *sql)) {
+            sql++;
+        }
+
+        struct Rollup *tmp = realloc(rollups, (rollup_count + 1) * sizeof(struct Rollup));
+        if (!tmp) {
+            rc = 1;
+            break;
+        }
+        rollups = tmp;
+
+        struct Rollup *rollup = &rollups[rollup_count++];
+        memset(rollup, 0, sizeof(*rollup));
+        SNPRINTF(rollup->name, MAXSQL, "%.*s", (int) name_len, curr);
+        SNPRINTF(rollup->spec, MAXSQL, "%.*s", (int) spec_len, spec);
+        SNPRINTF(rollup->sql,  MAXSQL, "%s", sql);
+
+        /* counts can't be added up, but sums of 1 can */
+        struct StreamingAggregate sa;
+        if (StreamingAggregate_init(&sa, rollup->spec) != 0) {
+            fprintf(stderr, "Bad aggregate spec for rollup %s: %s\n", rollup->name, rollup->spec);
+            rc = 1;
+            break;
+        }
+        for(size_t i = 0; i < sa.columns; i++) {
+            if (sa.ops[i] == SA_COUNT) {
+                fprintf(stderr, "Rollup %s cannot use count; use sum of a column of 1s instead\n", rollup->name);
+                rc = 1;
+                break;
+            }
+        }
+        StreamingAggregate_destroy(&sa);
+
+        if (!*sql) {
+            fprintf(stderr, "Rollup %s is missing its SQL\n", rollup->name);
+            rc = 1;
+        }
+    }
+
+    fclose(file);
+    return rc;
+}
+
+/* use the columns returned by each rollup's SQL on a database to create its table */
+static int describe_rollups(const char *dbname) {
+    sqlite3 *db = opendb(dbname, RDONLY, 1, 1, 0,
+                         NULL, NULL
+                         #ifdef DEBUG
+                         , NULL, NULL
+                         , NULL, NULL
+                         , NULL, NULL
+                         , NULL, NULL
+                         #endif
+                         );
+    if (!db) {
+        return 1;
+    }
+
+    int rc = 0;
+    for(size_t i = 0; (i < rollup_count) && !rc; i++) {
+        struct Rollup *rollup = &rollups[i];
+
+        sqlite3_stmt *res = NULL;
+        if (sqlite3_prepare_v2(db, rollup->sql, -1, &res, NULL) != SQLITE_OK) {
+            fprintf(stderr, "Bad SQL for rollup %s: %s\n", rollup->name, sqlite3_errmsg(db));
+            rc = 1;
+            break;
+        }
+
+        struct StreamingAggregate sa;
+        StreamingAggregate_init(&sa, rollup->spec);
+        const size_t columns = sa.columns;
+        StreamingAggregate_destroy(&sa);
+
+        if ((size_t) sqlite3_column_count(res) != columns) {
+            fprintf(stderr, "Rollup %s returns %d columns, but its aggregate spec has %zu\n",
+                    rollup->name, sqlite3_column_count(res), columns);
+            sqlite3_finalize(res);
+            rc = 1;
+            break;
+        }
+
+        /* the values are numbers, and so are most keys */
+        size_t create_len = SNPRINTF(rollup->create, MAXSQL,
+                                     "DROP TABLE IF EXISTS rollup_%s; CREATE TABLE rollup_%s(",
+                                     rollup->name, rollup->name);
+        size_t insert_len = SNPRINTF(rollup->insert, MAXSQL, "INSERT INTO rollup_%s VALUES (", rollup->name);
+        for(size_t c = 0; c < columns; c++) {
+            char *column = sqlite3_mprintf("\"%w\" NUMERIC%s", sqlite3_column_name(res, c), (c + 1 < columns)?", ":");");
+            create_len += SNPRINTF(rollup->create + create_len, MAXSQL - create_len, "%s", column);
+            insert_len += SNPRINTF(rollup->insert + insert_len, MAXSQL - insert_len, "?%s", (c + 1 < columns)?", ":");");
+            sqlite3_free(column);
+        }
+        SNPRINTF(rollup->select, MAXSQL, "SELECT * FROM rollup_%s;", rollup->name);
+
+        sqlite3_finalize(res);
+    }
+
+    closedb(db);
+    return rc;
+}
+
+/*
+ * A directory whose treesummary can't be written until all of its
+ * subdirectories have been summarized. Each node only locks itself
+ * and its parent, so there is no lock shared by the whole tree.
+ */
+struct TreeNode {
+    char *name;
+    struct TreeNode *parent;
+
+    int full;                   /* rebuild every subdirectory instead of reusing their treesummaries */
+
+    pthread_mutex_t mutex;      /* protects everything below */
+    size_t remaining;           /* this directory + subdirectories that are not done */
+    struct sum sum;             /* this directory and every completed subtree */
+    size_t hist_bits;           /* -C of the histograms in sum, or 0 if there are none yet */
+    int hist_mismatch;          /* histograms built with different -C values were found */
+    struct Owners owners;
+    struct StreamingAggregate *rollups;
+};
+
+static struct TreeNode *treenode_create(const char *name, const size_t name_len, struct TreeNode *parent, const int full) {
+    struct TreeNode *node = malloc(sizeof(struct TreeNode));
+    if (!node) {
+        return NULL;
+    }
+
+    if (!(node->name = malloc(name_len + 1))) {
+        free(node);
+        return NULL;
+    }
+    memcpy(node->name, name, name_len);
+    node->name[name_len] = '\0';
+
+    node->parent = parent;
+    node->full = full;
+    pthread_mutex_init(&node->mutex, NULL);
+    node->remaining = 1;
+    zeroit(&node->sum);
+    node->hist_bits = 0;
+    node->hist_mismatch = 0;
+    memset(&node->owners, 0, sizeof(node->owners));
+
+    if (!(node->rollups = rollups_create())) {
+        pthread_mutex_destroy(&node->mutex);
+        free(node->name);
+        free(node);
+        return NULL;
+    }
+
+    return node;
+}
+
+static void treenode_destroy(struct TreeNode *node) {
+    rollups_destroy(node->rollups);
+    pthread_mutex_destroy(&node->mutex);
+    free(node->name);
+    free(node);
+}
+
+/*
+ * directories that were reindexed, sorted, with the index path in front
+ * only these directories, their subdirectories, and their ancestors
+ * are rebuilt; everything else reuses its existing treesummary
+ */
+static char **changed = NULL;
+static size_t changed_count = 0;
+
+static int cmp_str(const void *lhs, const void *rhs) {
+    return strcmp(*(char **) lhs, *(char **) rhs);
+}
+
+/* 1 if the directory was changed, 2 if a changed directory is below it, 0 otherwise */
+static int changed_state(const char *name, const size_t name_len) {
+    /* find the first changed directory that is not less than name */
+    size_t lo = 0;
+    size_t hi = changed_count;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (strcmp(changed[mid], name) < 0) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    /* the directory and everything below it sort right after name */
+    for(; lo < changed_count; lo++) {
+        if (strncmp(changed[lo], name, name_len) != 0) {
+            break;
+        }
+
+        if (changed[lo][name_len] == '\0') {
+            return 1;
+        }
+
+        if (changed[lo][name_len] == '/') {
+            return 2;
+        }
+    }
+
+    return 0;
+}
+
+/* set if any histograms could not be added up */
+static int hist_mismatch = 0;
+
+/*
+ * check that histograms built with -C bits can be added to the
+ * histograms of a node whose mutex is held; if they can't, or if they
+ * already had a mismatch in them, they are removed from sumin and the
+ * node's treesummaryhist is not written
+ */
+static void hist_check_bits(struct TreeNode *node, const char *name, struct sum *sumin, const size_t bits, const int mismatch) {
+    if (mismatch) {
+        node->hist_mismatch = 1;
+    }
+    else if (bits && node->hist_bits && (bits != node->hist_bits)) {
+        fprintf(stderr, "Histograms in %s were built with -C %zu, but %s has -C %zu\n",
+                name, bits, node->name, node->hist_bits);
+        node->hist_mismatch = 1;
+    }
+    else {
+        if (bits) {
+            node->hist_bits = bits;
+        }
+        return;
+    }
+
+    memset(sumin->sizehistfiles, 0, sizeof(sumin->sizehistfiles));
+    memset(sumin->sizehistbytes, 0, sizeof(sumin->sizehistbytes));
+    memset(sumin->agehistfiles,  0, sizeof(sumin->agehistfiles));
+    memset(sumin->agehistbytes,  0, sizeof(sumin->agehistbytes));
+}
+
+/* add the ids returned by a query to a filter */
+static int addowners(sqlite3 *db, const char *sql, unsigned char *filter) {
+    sqlite3_stmt *res = NULL;
+    if (sqlite3_prepare_v2(db, sql, -1, &res, NULL) != SQLITE_OK) {
+        sqlite3_finalize(res);
+        return 1;
+    }
+
+    while (sqlite3_step(res) == SQLITE_ROW) {
+        OwnerFilter_add(filter, sqlite3_column_int64(res, 0));
+    }
+
+    sqlite3_finalize(res);
+    return 0;
+}
+
+/*
+ * directories indexed with --shard-entries keep the rest of their
+ * entries in the databases listed in their shards table; add the uids,
+ * gids, and rollup rows of each shard, with entries and the views that
+ * read it shadowed by the shard's entries (see restrict_entries)
+ * the owners are marked incomplete if a shard could not be read
+ */
+static void readshards(const char *name, sqlite3 *db, struct Owners *owners, struct StreamingAggregate *dirrollups) {
+    /* indexes built without shards do not have the table */
+    sqlite3_stmt *res = NULL;
+    if (sqlite3_prepare_v2(db, "SELECT name FROM shards;", -1, &res, NULL) != SQLITE_OK) {
+        sqlite3_finalize(res);
+        return;
+    }
+
+    /* a database can't be detached while a statement is reading */
+    struct sll shards;
+    sll_init(&shards);
+    while (sqlite3_step(res) == SQLITE_ROW) {
+        const char *shard = (const char *) sqlite3_column_text(res, 0);
+        if (!shard) {
+            continue;
+        }
+
+        char *shardname = malloc(MAXPATH);
+        SNPRINTF(shardname, MAXPATH, "%s/%s", name, shard);
+        sll_push(&shards, shardname);
+    }
+    sqlite3_finalize(res);
+
+    sll_loop(&shards, node) {
+        const char *shardname = (const char *) sll_node_data(node);
+        if (!attachdb(shardname, db, "shard", RDONLY)) {
+            owners->incomplete = 1;
+            continue;
+        }
+
+        char views[32][MAXSQL];
+        const size_t view_count = restrict_entries(db, "shard", 0, LLONG_MAX, views, sizeof(views) / sizeof(views[0]));
+        if (view_count) {
+            if (addowners(db, "SELECT DISTINCT uid FROM entries;", owners->uids) ||
+                addowners(db, "SELECT DISTINCT gid FROM entries;", owners->gids)) {
+                owners->incomplete = 1;
+            }
+
+            if (dirrollups) {
+                readrollups(shardname, db, 0, dirrollups);
+            }
+        }
+        else {
+            fprintf(stderr, "Could not read the entries of %s\n", shardname);
+            owners->incomplete = 1;
+        }
+
+        unrestrict_entries(db, views, view_count);
+        detachdb(shardname, db, "shard");
+    }
+    sll_destroy(&shards, free);
+}
+
+/*
+ * fold the existing treesummary and treeowners tables of an unchanged
+ * subdirectory into its parent
+ * returns 0 on success and non-zero if the subdirectory has to be rebuilt
+ */
+static int reuse_subtree(struct TreeNode *parent, const char *subdir) {
+    char dbname[MAXPATH];
+    SNPRINTF(dbname, MAXPATH, "%s/%s", subdir, DBNAME);
+
+    sqlite3 *db = opendb(dbname, RDONLY, 1, 1, 0,
+                         NULL, NULL
+                         #ifdef DEBUG
+                         , NULL, NULL
+                         , NULL, NULL
+                         , NULL, NULL
+                         , NULL, NULL
+                         #endif
+                         );
+    if (!db) {
+        return 1;
+    }
+
+    /* make sure there is a treesummary record */
+    sqlite3_stmt *res = NULL;
+    int rows = 0;
+    if ((sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM treesummary WHERE rectype=0;", -1, &res, NULL) == SQLITE_OK) &&
+        (sqlite3_step(res) == SQLITE_ROW)) {
+        rows = sqlite3_column_int(res, 0);
+    }
+    sqlite3_finalize(res);
+
+    if (rows < 1) {
+        closedb(db);
+        return 1;
+    }
+
+    struct sum sumin;
+    int recs;
+    zeroit(&sumin);
+    querytsdb(subdir,&sumin,db,&recs,1);
+
+    /* rebuild subtrees indexed before there were histograms or left without them */
+    size_t bits = 0;
+    if (queryhistdb(subdir, &sumin, db, 1, &bits) != 0) {
+        closedb(db);
+        return 1;
+    }
+
+    /* the filters are optional */
+    struct Owners owners;
+    memset(&owners, 0, sizeof(owners));
+    owners.incomplete = 1;
+    res = NULL;
+    if ((sqlite3_prepare_v2(db, "SELECT uids, gids FROM treeowners;", -1, &res, NULL) == SQLITE_OK) &&
+        (sqlite3_step(res) == SQLITE_ROW) &&
+        (sqlite3_column_bytes(res, 0) == OWNER_FILTER_BYTES) &&
+        (sqlite3_column_bytes(res, 1) == OWNER_FILTER_BYTES)) {
+        OwnerFilter_merge(owners.uids, sqlite3_column_blob(res, 0));
+        OwnerFilter_merge(owners.gids, sqlite3_column_blob(res, 1));
+        owners.incomplete = 0;
+    }
+    sqlite3_finalize(res);
+
+    /* rebuild subtrees that do not have every rollup yet */
+    struct StreamingAggregate *subrollups = rollups_create();
+    if (!subrollups || readrollups(subdir, db, 1, subrollups)) {
+        rollups_destroy(subrollups);
+        closedb(db);
+        return 1;
+    }
+
+    closedb(db);
+
+    pthread_mutex_lock(&parent->mutex);
+    hist_check_bits(parent, subdir, &sumin, bits, 0);
+    tsumit_unlocked(&sumin, &parent->sum);
+    rollups_merge(parent->rollups, subrollups);
+    OwnerFilter_merge(parent->owners.uids, owners.uids);
+    OwnerFilter_merge(parent->owners.gids, owners.gids);
+    parent->owners.incomplete |= owners.incomplete;
+    pthread_mutex_unlock(&parent->mutex);
+
+    rollups_destroy(subrollups);
+
+    return 0;
+}
+
 static int create_tables(const char *name, sqlite3 *db, void * args) {
-     printf("writetsum %d\n", in.writetsum);
     if ((create_table_wrapper(name, db, "tsql",        tsql,        NULL, NULL) != SQLITE_OK) ||
+        (create_table_wrapper(name, db, "tosql",       tosql,       NULL, NULL) != SQLITE_OK) ||
         (create_table_wrapper(name, db, "vtssqldir",   vtssqldir,   NULL, NULL) != SQLITE_OK) ||
         (create_table_wrapper(name, db, "vtssqluser",  vtssqluser,  NULL, NULL) != SQLITE_OK) ||
         (create_table_wrapper(name, db, "vtssqlgroup", vtssqlgroup, NULL, NULL) != SQLITE_OK)) {
         return -1;
     }
 
+    for(size_t i = 0; i < rollup_count; i++) {
+        if (create_table_wrapper(name, db, rollups[i].name, rollups[i].create, NULL, NULL) != SQLITE_OK) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* write the treesummary and treeowners tables of a directory whose tree is done */
+static int writetsum(struct TreeNode *node) {
+    char dbname[MAXPATH];
+    SNPRINTF(dbname, MAXPATH, "%s/%s", node->name, DBNAME);
+
+    struct stat smt;
+    const int rc = lstat(dbname, &smt);
+
+    sqlite3 *db = opendb(dbname, RDWR, 1, 1, 0,
+                         create_tables, NULL
+                         #ifdef DEBUG
+                         , NULL, NULL
+                         , NULL, NULL
+                         , NULL, NULL
+                         , NULL, NULL
+                         #endif
+                         );
+    if (!db) {
+        return -1;
+    }
+
+    inserttreesumdb(node->name, db, &node->sum, 0, 0, 0);
+
+    /* a missing treesummaryhist makes the next incremental run check this tree again */
+    if (!node->hist_mismatch) {
+        inserthistdb(db, &node->sum, 1, node->hist_bits);
+    }
+    else {
+        sqlite3_exec(db, "DROP TABLE IF EXISTS treesummaryhist;", NULL, NULL, NULL);
+    }
+
+    /* only write the filters if every id was read */
+    if (!node->owners.incomplete) {
+        sqlite3_stmt *res = NULL;
+        if (sqlite3_prepare_v2(db, "INSERT INTO treeowners VALUES (?, ?);", -1, &res, NULL) == SQLITE_OK) {
+            sqlite3_bind_blob(res, 1, node->owners.uids, OWNER_FILTER_BYTES, SQLITE_STATIC);
+            sqlite3_bind_blob(res, 2, node->owners.gids, OWNER_FILTER_BYTES, SQLITE_STATIC);
+            if (sqlite3_step(res) != SQLITE_DONE) {
+                fprintf(stderr, "Could not insert uid and gid filters into %s: %s\n", dbname, sqlite3_errmsg(db));
+            }
+        }
+        sqlite3_finalize(res);
+    }
+
+    if (rollup_count) {
+        startdb(db);
+        for(size_t i = 0; i < rollup_count; i++) {
+            sqlite3_stmt *res = NULL;
+            if (sqlite3_prepare_v2(db, rollups[i].insert, -1, &res, NULL) == SQLITE_OK) {
+                StreamingAggregate_output(&node->rollups[i], rollup_insert, res);
+            }
+            else {
+                fprintf(stderr, "Could not insert rollup %s into %s: %s\n", rollups[i].name, dbname, sqlite3_errmsg(db));
+            }
+            sqlite3_finalize(res);
+        }
+        stopdb(db);
+    }
+
+    closedb(db);
+
+    /* restore mtime and atime */
+    if (rc == 0) {
+        struct utimbuf utimeStruct;
+        utimeStruct.actime  = smt.st_atime;
+        utimeStruct.modtime = smt.st_mtime;
+        if (utime(dbname, &utimeStruct) != 0) {
+            fprintf(stderr, "ERROR: utime failed with error number: %d on %s\n", errno, dbname);
+        }
+    }
+
     return 0;
 }
 
+/*
+ * mark a directory or one of its subtrees as done
+ *
+ * whichever thread finishes the last piece of a directory writes its
+ * treesummary and folds it into the parent, which may finish the
+ * parent as well, and so on up the tree
+ */
+static void complete(struct TreeNode *node) {
+    while (node) {
+        pthread_mutex_lock(&node->mutex);
+        const size_t remaining = --node->remaining;
+        pthread_mutex_unlock(&node->mutex);
+
+        if (remaining) {
+            break;
+        }
+
+        /* nothing else can touch this node now */
+        if (in.writetsum) {
+            writetsum(node);
+        }
+
+        struct TreeNode *parent = node->parent;
+        if (parent) {
+            pthread_mutex_lock(&parent->mutex);
+            hist_check_bits(parent, node->name, &node->sum, node->hist_bits, node->hist_mismatch);
+            tsumit_unlocked(&node->sum, &parent->sum);
+            OwnerFilter_merge(parent->owners.uids, node->owners.uids);
+            OwnerFilter_merge(parent->owners.gids, node->owners.gids);
+            parent->owners.incomplete |= node->owners.incomplete;
+            rollups_merge(parent->rollups, node->rollups);
+            pthread_mutex_unlock(&parent->mutex);
+        }
+        else {
+            /* the top of the tree is printed in processfin */
+            sumout = node->sum;
+            hist_mismatch = node->hist_mismatch;
+        }
+
+        treenode_destroy(node);
+        node = parent;
+    }
+}
+
 static int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args)
 {
-    struct work *passmywork = data;
+    struct TreeNode *node = data;
+    const size_t name_len = strlen(node->name);
     char dbname[MAXPATH];
     DIR *dir;
     sqlite3 *db;
-    struct sum sumin;
-    int recs;
-    int trecs;
 
     (void) args;
 
-    if (!(dir = opendir(passmywork->name)))
-       goto out_free;
+    if (!(dir = opendir(node->name)))
+       goto out_complete;
 
-    SNPRINTF(passmywork->type,2,"%s","d");
     if (in.printing || in.printdir) {
-      passmywork->xattrs_len = 0;
-      printits(passmywork,id);
+      struct work work;
+      SNPRINTF(work.name, MAXPATH, "%s", node->name);
+      SNPRINTF(work.type, 2, "%s", "d");
+      work.xattrs_len = 0;
+      printits(&work, id);
     }
 
     // push subdirectories into the queue
-    //descend(passmywork, dir, in.max_level);
+    // the count is raised before each push so that the subdirectory can't finish this directory early
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+       const size_t len = strlen(entry->d_name);
+       if ((entry->d_type != DT_DIR) ||
+           ((len == 1) && (strncmp(entry->d_name, ".",  1) == 0)) ||
+           ((len == 2) && (strncmp(entry->d_name, "..", 2) == 0))) {
+          continue;
+       }
+
+       char subdir[MAXPATH];
+       const size_t subdir_len = SNFORMAT_S(subdir, MAXPATH, 3, node->name, name_len, "/", (size_t) 1, entry->d_name, len);
+
+       /* subdirectories that did not change and have no changes below them keep their treesummary */
+       int full = node->full;
+       if (!full) {
+          const int state = changed_state(subdir, subdir_len);
+          if (!state && !reuse_subtree(node, subdir)) {
+             continue;
+          }
+          full = (state != 2);
+       }
+
+       struct TreeNode *child = treenode_create(subdir, subdir_len, node, full);
+       if (!child) {
+          continue;
+       }
+
+       pthread_mutex_lock(&node->mutex);
+       node->remaining++;
+       pthread_mutex_unlock(&node->mutex);
+
+       QPTPool_enqueue(ctx, id, processdir, child);
+    }
 
-    SNPRINTF(dbname, MAXPATH, "%s/%s", passmywork->name, DBNAME);
-    if ((db=opendb(dbname, RDONLY, 1, 1,
+    closedir(dir);
+
+    SNPRINTF(dbname, MAXPATH, "%s/%s", node->name, DBNAME);
+    if ((db=opendb(dbname, RDONLY, 1, 1, 0,
                    NULL, NULL
                    #ifdef DEBUG
                    , NULL, NULL
@@ -134,86 +840,87 @@ static int processdir(struct QPTPool * ctx, const size_t id, void * data, void *
                    , NULL, NULL
                    #endif
                    ))) {
+       struct sum sumin;
+       struct Owners owners;
+       struct StreamingAggregate *dirrollups = rollups_create();
+       size_t bits = 0;
+       int recs;
+
        zeroit(&sumin);
+       memset(&owners, 0, sizeof(owners));
 
-       trecs=rawquerydb(passmywork->name, 0, db, "select name from sqlite_master where type=\'table\' and name=\'treesummary\';", 0, 0, 0, id);
-       if (trecs<1) {
-         // push subdirectories into the queue
-         descend(ctx, id, passmywork, dir, processdir, in.max_level);
-         querytsdb(passmywork->name,&sumin,db,&recs,0);
-       } else {
-         querytsdb(passmywork->name,&sumin,db,&recs,1);
+       querytsdb(node->name,&sumin,db,&recs,0);
+       const int hist_rc = queryhistdb(node->name,&sumin,db,0,&bits);
+       if (hist_rc > 0) {
+         fprintf(stderr, "Histograms in %s were built with different -C values\n", node->name);
        }
+       if (in.writetsum) {
+         if (addowners(db, "SELECT DISTINCT uid FROM entries;", owners.uids) ||
+             addowners(db, "SELECT DISTINCT gid FROM entries;", owners.gids)) {
+           owners.incomplete = 1;
+         }
 
-       tsumit(&sumin,&sumout);
-    }
+         if (dirrollups) {
+           readrollups(node->name, db, 0, dirrollups);
+         }
 
-    closedb(db);
-    closedir(dir);
+         readshards(node->name, db, &owners, dirrollups);
+       }
+
+       closedb(db);
+
+       pthread_mutex_lock(&node->mutex);
+       hist_check_bits(node, node->name, &sumin, bits, hist_rc > 0);
+       tsumit_unlocked(&sumin, &node->sum);
+       OwnerFilter_merge(node->owners.uids, owners.uids);
+       OwnerFilter_merge(node->owners.gids, owners.gids);
+       node->owners.incomplete |= owners.incomplete;
+       if (dirrollups) {
+         rollups_merge(node->rollups, dirrollups);
+       }
+       pthread_mutex_unlock(&node->mutex);
+
+       rollups_destroy(dirrollups);
+    }
 
- out_free:
-    free(passmywork);
+ out_complete:
+    complete(node);
 
     return 0;
 }
 
 int processinit(struct QPTPool * ctx) {
 
-     struct work * mywork = malloc(sizeof(struct work));
+     struct stat st;
 
      // process input directory and put it on the queue
-     SNPRINTF(mywork->name,MAXPATH,"%s",in.name);
-     lstat(in.name,&mywork->statuso);
+     lstat(in.name,&st);
      if (access(in.name, R_OK | X_OK)) {
         fprintf(stderr, "couldn't access input dir '%s': %s\n",
                 in.name, strerror(errno));
         return 1;
      }
-     if (!S_ISDIR(mywork->statuso.st_mode) ) {
+     if (!S_ISDIR(st.st_mode) ) {
         fprintf(stderr,"input-dir '%s' is not a directory\n", in.name);
         return 1;
      }
 
+     const size_t name_len = strlen(in.name);
+     struct TreeNode *root = treenode_create(in.name, name_len, NULL,
+                                             !changed_count || (changed_state(in.name, name_len) == 1));
+     if (!root) {
+        fprintf(stderr, "Could not allocate space for '%s'\n", in.name);
+        return 1;
+     }
+
      /* push the path onto the queue */
-     QPTPool_enqueue(ctx, 0, processdir, mywork);
+     QPTPool_enqueue(ctx, 0, processdir, root);
 
      return 0;
 }
 
 int processfin() {
 
-     sqlite3 *tdb;
-     struct stat smt;
-     int rc;
-     char dbpath[MAXPATH];
-     struct utimbuf utimeStruct;
-
-     SNPRINTF(dbpath,MAXPATH,"%s/%s",in.name,DBNAME);
-     rc=1;
-     rc=lstat(dbpath,&smt);
-     if (in.writetsum) {
-        if (! (tdb = opendb(dbpath, RDWR, 1, 1,
-                            create_tables, NULL
-                            #ifdef DEBUG
-                            , NULL, NULL
-                            , NULL, NULL
-                            , NULL, NULL
-                            , NULL, NULL
-                            #endif
-                            )))
-           return -1;
-        inserttreesumdb(in.name,tdb,&sumout,0,0,0);
-        closedb(tdb);
-     }
-     if (rc==0) {
-        utimeStruct.actime  = smt.st_atime;
-        utimeStruct.modtime = smt.st_mtime;
-        if(utime(dbpath, &utimeStruct) != 0) {
-           fprintf(stderr,"ERROR: utime failed with error number: %d on %s\n", errno,dbpath);
-           exit(1);
-        }
-     }
-
      printf("totals: \n");
      printf("totfiles %lld totlinks %lld\n",sumout.totfiles,sumout.totlinks);
      printf("totsize %lld\n",sumout.totsize);
@@ -240,6 +947,7 @@ int processfin() {
 
 void sub_help() {
    printf("GUFI_index        path to GUFI index\n");
+   printf("changed_dir       directory that was reindexed, relative to GUFI_index; if any are given, only they, the directories below them, and their ancestors are summarized\n");
    printf("\n");
 }
 
@@ -248,6 +956,12 @@ int validate_inputs() {
    if (! in.writetsum)
       fprintf(stderr, "WARNING: Not [re]generating tree-summary table without '-s'\n");
 
+   // rollups are written next to the treesummary
+   if (in.rollups[0] && ! in.writetsum) {
+      fprintf(stderr, "-L requires -s\n");
+      return -1;
+   }
+
    return 0;
 }
 
@@ -258,7 +972,7 @@ int main(int argc, char *argv[])
      // but allow different fields to be filled at the command-line.
      // Callers provide the options-string for get_opt(), which will
      // control which options are parsed for each program.
-     int idx = parse_cmd_line(argc, argv, "hHPn:s", 1, "GUFI_index", &in);
+     int idx = parse_cmd_line(argc, argv, "hHPn:sL:", 1, "GUFI_index [changed_dir ...]", &in);
      if (in.helped)
         sub_help();
      if (idx < 0)
@@ -270,6 +984,40 @@ int main(int argc, char *argv[])
 
         if (retval)
            return retval;
+
+        // the rest are the changed directories
+        changed_count = argc - idx;
+        if (changed_count) {
+           changed = malloc(changed_count * sizeof(char *));
+           for(size_t i = 0; i < changed_count; i++) {
+              // leading "./" and trailing "/" are dropped
+              const char *arg = argv[idx + i];
+              while (strncmp(arg, "./", 2) == 0) {
+                 arg += 2;
+                 while (*arg == '/') {
+                    arg++;
+                 }
+              }
+
+              char rel[MAXPATH];
+              size_t rel_len = SNPRINTF(rel, MAXPATH, "%s", arg);
+              while (rel_len && (rel[rel_len - 1] == '/')) {
+                 rel[--rel_len] = '\0';
+              }
+
+              // "." and "" are the top of the index
+
+              changed[i] = malloc(MAXPATH);
+              if ((rel_len == 0) || ((rel_len == 1) && (rel[0] == '.'))) {
+                 SNPRINTF(changed[i], MAXPATH, "%s", in.name);
+              }
+              else {
+                 SNPRINTF(changed[i], MAXPATH, "%s/%s", in.name, rel);
+              }
+           }
+
+           qsort(changed, changed_count, sizeof(char *), cmp_str);
+        }
      }
 
      // option-parsing can't tell that some options are required,
@@ -277,6 +1025,14 @@ int main(int argc, char *argv[])
      if (validate_inputs())
         return -1;
 
+     if (in.rollups[0]) {
+        char dbname[MAXPATH];
+        SNPRINTF(dbname, MAXPATH, "%s/%s", in.name, DBNAME);
+        if (read_rollups_file(in.rollups) || describe_rollups(dbname)) {
+           return -1;
+        }
+     }
+
      struct QPTPool * pool = QPTPool_init(in.maxthreads);
      if (!pool) {
          fprintf(stderr, "Failed to initialize thread pool\n");
@@ -296,5 +1052,11 @@ int main(int argc, char *argv[])
 
      processfin();
 
-     return 0;
+     for(size_t i = 0; i < changed_count; i++) {
+        free(changed[i]);
+     }
+     free(changed);
+     free(rollups);
+
+     return hist_mismatch?-1:0;
 }
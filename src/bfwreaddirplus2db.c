@@ -196,7 +196,7 @@ int reprocessdir(void * passv, DIR *dir)
           truncate(dbpath,0);
         }
     }
-    if (!(db = opendb(dbpath, RDWR, 1, 1,
+    if (!(db = opendb(dbpath, RDWR, 1, 1, 0,
                       create_tables, NULL
                       #ifdef DEBUG
                       , NULL, NULL
@@ -611,7 +611,7 @@ int processinit(struct QPTPool * ctx) {
        i=0;
        while (i < in.maxthreads) {
            SNPRINTF(outdbn,MAXPATH,"%s.%d",in.outdbn,i);
-           gts.outdbd[i]=opendb(outdbn, RDWR, 1, 1,
+           gts.outdbd[i]=opendb(outdbn, RDWR, 1, 1, 0,
                                 create_readdirplus_tables, NULL
                                 #ifdef DEBUG
                                 , NULL, NULL
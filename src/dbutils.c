@@ -62,15 +62,18 @@ OF SUCH DAMAGE.
 
 
 #include <errno.h>
+#include <fcntl.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <pwd.h>
 #include <grp.h>
 #include "pcre.h"
 
 #include "dbutils.h"
+#include "vfs.h"
 
 extern int errno;
 
@@ -86,11 +89,40 @@ char *esql = // "DROP TABLE IF EXISTS entries;"
 
 char *esqli = "INSERT INTO entries VALUES (NULL,@name,@type,@inode,@mode,@nlink,@uid,@gid,@size,@blksize,@blocks,@atime,@mtime, @ctime,@linkname,@xattrs,@crtime,@ossint1,@ossint2,@ossint3,@ossint4,@osstext1,@osstext2);";
 
+char *sdsql = // "DROP TABLE IF EXISTS subdirs;"
+             "CREATE TABLE subdirs(name TEXT);";
+
+char *sdsqli = "INSERT INTO subdirs VALUES (@name);";
+
+char *shsql = // "DROP TABLE IF EXISTS shards;"
+              "CREATE TABLE shards(name TEXT);";
+
+char *shsqli = "INSERT INTO shards VALUES (@name);";
+
 char *ssql = "DROP TABLE IF EXISTS summary;"
-             "CREATE TABLE summary(id INTEGER PRIMARY KEY, name TEXT, type TEXT, inode INT64, mode INT64, nlink INT64, uid INT64, gid INT64, size INT64, blksize INT64, blocks INT64, atime INT64, mtime INT64, ctime INT64, linkname TEXT, xattrs BLOB, totfiles INT64, totlinks INT64, minuid INT64, maxuid INT64, mingid INT64, maxgid INT64, minsize INT64, maxsize INT64, totltk INT64, totmtk INT64, totltm INT64, totmtm INT64, totmtg INT64, totmtt INT64, totsize INT64, minctime INT64, maxctime INT64, minmtime INT64, maxmtime INT64, minatime INT64, maxatime INT64, minblocks INT64, maxblocks INT64, totxattr INT64,depth INT64, mincrtime INT64, maxcrtime INT64, minossint1 INT64, maxossint1 INT64, totossint1 INT64, minossint2 INT64, maxossint2 INT64, totossint2 INT64, minossint3 INT64, maxossint3 INT64, totossint3 INT64,minossint4 INT64, maxossint4 INT64, totossint4 INT64, rectype INT64, pinode INT64);";
+             "CREATE TABLE summary(id INTEGER PRIMARY KEY, name TEXT, type TEXT, inode INT64, mode INT64, nlink INT64, uid INT64, gid INT64, size INT64, blksize INT64, blocks INT64, atime INT64, mtime INT64, ctime INT64, linkname TEXT, xattrs BLOB, totfiles INT64, totlinks INT64, minuid INT64, maxuid INT64, mingid INT64, maxgid INT64, minsize INT64, maxsize INT64, totltk INT64, totmtk INT64, totltm INT64, totmtm INT64, totmtg INT64, totmtt INT64, totsize INT64, minctime INT64, maxctime INT64, minmtime INT64, maxmtime INT64, minatime INT64, maxatime INT64, minblocks INT64, maxblocks INT64, totxattr INT64,depth INT64, mincrtime INT64, maxcrtime INT64, minossint1 INT64, maxossint1 INT64, totossint1 INT64, minossint2 INT64, maxossint2 INT64, totossint2 INT64, minossint3 INT64, maxossint3 INT64, totossint3 INT64,minossint4 INT64, maxossint4 INT64, totossint4 INT64, rectype INT64, pinode INT64);"
+             "DROP TABLE IF EXISTS summaryhist;"
+             "CREATE TABLE summaryhist(kind TEXT, bucket INT64, low INT64, high INT64, files INT64, bytes INT64, bits INT64);";
 
 char *tsql = "DROP TABLE IF EXISTS treesummary;"
-             "CREATE TABLE treesummary(totsubdirs INT64, maxsubdirfiles INT64, maxsubdirlinks INT64, maxsubdirsize INT64, totfiles INT64, totlinks INT64, minuid INT64, maxuid INT64, mingid INT64, maxgid INT64, minsize INT64, maxsize INT64, totltk INT64, totmtk INT64, totltm INT64, totmtm INT64, totmtg INT64, totmtt INT64, totsize INT64, minctime INT64, maxctime INT64, minmtime INT64, maxmtime INT64, minatime INT64, maxatime INT64, minblocks INT64, maxblocks INT64, totxattr INT64,depth INT64, mincrtime INT64, maxcrtime INT64, minossint1 INT64, maxossint1 INT64, totossint1 INT64, minossint2 INT64, maxossint2 INT64, totossint2 INT64, minossint3 INT64, maxossint3 INT64, totossint3 INT64, minossint4 INT64, maxossint4 INT64, totossint4 INT64,rectype INT64, uid INT64, gid INT64);";
+             "CREATE TABLE treesummary(totsubdirs INT64, maxsubdirfiles INT64, maxsubdirlinks INT64, maxsubdirsize INT64, totfiles INT64, totlinks INT64, minuid INT64, maxuid INT64, mingid INT64, maxgid INT64, minsize INT64, maxsize INT64, totltk INT64, totmtk INT64, totltm INT64, totmtm INT64, totmtg INT64, totmtt INT64, totsize INT64, minctime INT64, maxctime INT64, minmtime INT64, maxmtime INT64, minatime INT64, maxatime INT64, minblocks INT64, maxblocks INT64, totxattr INT64,depth INT64, mincrtime INT64, maxcrtime INT64, minossint1 INT64, maxossint1 INT64, totossint1 INT64, minossint2 INT64, maxossint2 INT64, totossint2 INT64, minossint3 INT64, maxossint3 INT64, totossint3 INT64, minossint4 INT64, maxossint4 INT64, totossint4 INT64,rectype INT64, uid INT64, gid INT64);"
+             "DROP TABLE IF EXISTS treesummaryhist;"
+             "CREATE TABLE treesummaryhist(kind TEXT, bucket INT64, low INT64, high INT64, files INT64, bytes INT64, bits INT64);";
+
+/* Bloom filters of the uids and gids in the tree (see OwnerFilter.h) */
+char *tosql = "DROP TABLE IF EXISTS treeowners;"
+              "CREATE TABLE treeowners(uids BLOB, gids BLOB);";
+
+/* table of contents of a packed index */
+char *tocsql = "DROP TABLE IF EXISTS toc;"
+               "CREATE TABLE toc(id INTEGER PRIMARY KEY, parent INT64, name TEXT, pack INT64, offset INT64, length INT64);";
+
+char *tocsqli = "INSERT INTO toc VALUES (@id,@parent,@name,@pack,@offset,@length);";
+
+char *tocidxsql = "CREATE INDEX toc_parent ON toc(parent);";
+
+char *packssql = "DROP TABLE IF EXISTS packs;"
+                 "CREATE TABLE packs(id INTEGER PRIMARY KEY, name TEXT);";
 
 char *vesql = "DROP VIEW IF EXISTS pentries;"
               "create view pentries as select entries.*, summary.inode as pinode from entries, summary where rectype=0;";
@@ -116,8 +148,15 @@ char *vtssqlgroup = "DROP VIEW IF EXISTS vtsummarygroup;"
 sqlite3 * attachdb(const char *name, sqlite3 *db, const char *dbn, const OpenMode mode)
 {
   char attach[MAXSQL];
-  if (mode == RDONLY) {
-      if (!sqlite3_snprintf(MAXSQL, attach, "ATTACH 'file:%q?mode=ro' AS %Q", name, dbn)) {
+  if (!strncmp(name, "file:", 5)) {
+      /* URIs already carry their own parameters */
+      if (!sqlite3_snprintf(MAXSQL, attach, "ATTACH %Q AS %Q", name, dbn)) {
+          fprintf(stderr, "Cannot create ATTACH command\n");
+          return NULL;
+      }
+  }
+  else if (mode == RDONLY) {
+      if (!sqlite3_snprintf(MAXSQL, attach, "ATTACH 'file:%q?vfs=" GUFI_RO_VFS "&mode=ro' AS %Q", name, dbn)) {
           fprintf(stderr, "Cannot create ATTACH command\n");
           return NULL;
       }
@@ -153,6 +192,63 @@ sqlite3 * detachdb(const char *name, sqlite3 *db, const char *dbn)
   return db;
 }
 
+/*
+ * Make the unqualified name "entries" refer to only the rows in
+ * [lo, hi) by creating a temporary view with that name, which SQLite
+ * finds before the table. The views in the index that read from
+ * entries are copied into the temp schema as well so that they read
+ * from the restricted view instead of the whole table.
+ *
+ * Returns the number of views created, which are listed in names.
+ */
+size_t restrict_entries(sqlite3 *db, const char *schema,
+                        const sqlite3_int64 lo, const sqlite3_int64 hi,
+                        char names[][MAXSQL], const size_t max_names) {
+    char sql[MAXSQL];
+    sqlite3_snprintf(MAXSQL, sql,
+                     "CREATE TEMP VIEW entries AS SELECT * FROM \"%w\".entries WHERE (rowid >= %lld) AND (rowid < %lld);",
+                     schema, (long long) lo, (long long) hi);
+    if (sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK) {
+        return 0;
+    }
+
+    size_t count = 0;
+    SNPRINTF(names[count++], MAXSQL, "entries");
+
+    sqlite3_snprintf(MAXSQL, sql, "SELECT name, sql FROM \"%w\".sqlite_master WHERE (type == 'view') AND (sql LIKE '%%entries%%');", schema);
+
+    sqlite3_stmt *res = NULL;
+    if (sqlite3_prepare_v2(db, sql, -1, &res, NULL) == SQLITE_OK) {
+        /* sqlite_master normalizes the start of the statement to "CREATE VIEW " */
+        static const char create_view[] = "CREATE VIEW ";
+        while ((count < max_names) && (sqlite3_step(res) == SQLITE_ROW)) {
+            const char *name = (const char *) sqlite3_column_text(res, 0);
+            const char *view = (const char *) sqlite3_column_text(res, 1);
+            if (!name || !view || strncmp(view, create_view, sizeof(create_view) - 1)) {
+                continue;
+            }
+
+            char *temp = sqlite3_mprintf("CREATE TEMP VIEW %s", view + sizeof(create_view) - 1);
+            if (sqlite3_exec(db, temp, NULL, NULL, NULL) == SQLITE_OK) {
+                SNPRINTF(names[count++], MAXSQL, "%s", name);
+            }
+            sqlite3_free(temp);
+        }
+    }
+    sqlite3_finalize(res);
+
+    return count;
+}
+
+/* drop the views created by restrict_entries, in reverse order */
+void unrestrict_entries(sqlite3 *db, char names[][MAXSQL], const size_t count) {
+    for(size_t i = count; i > 0; i--) {
+        char *drop = sqlite3_mprintf("DROP VIEW temp.\"%w\";", names[i - 1]);
+        sqlite3_exec(db, drop, NULL, NULL, NULL);
+        sqlite3_free(drop);
+    }
+}
+
 int create_table_wrapper(const char *name, sqlite3 * db, const char * sql_name, const char * sql, int (*callback)(void*,int,char**,char**), void * args) {
     char *err_msg = NULL;
     const int rc = sqlite3_exec(db, sql, callback, args, &err_msg);
@@ -207,6 +303,7 @@ static int set_pragmas(sqlite3 * db) {
 }
 
 sqlite3 * opendb(const char * name, const OpenMode mode, const int setpragmas, const int load_extensions,
+                 const size_t mmap_size,
                  int (*modifydb)(const char * name, sqlite3 * db, void * args), void * modifydb_args
                  #ifdef DEBUG
                  , struct timespec * sqlite3_open_start
@@ -227,15 +324,24 @@ sqlite3 * opendb(const char * name, const OpenMode mode, const int setpragmas, c
     }
     #endif
 
+    /* make the GUFI VFSs available to URIs */
+    const int have_gufi_vfs = (gufi_vfs_init() == SQLITE_OK);
+
     int flags = SQLITE_OPEN_URI;
+    const char * vfs = GUFI_SQLITE_VFS;
     if (mode == RDONLY) {
         flags |= SQLITE_OPEN_READONLY;
+
+        /* read-only databases are pulled into memory when they are opened */
+        if (have_gufi_vfs) {
+            vfs = mmap_size?GUFI_RO_MMAP_VFS:GUFI_RO_VFS;
+        }
     }
     else {
         flags |= SQLITE_OPEN_CREATE | SQLITE_OPEN_READWRITE;
     }
 
-    if (sqlite3_open_v2(name, &db, flags, GUFI_SQLITE_VFS) != SQLITE_OK) {
+    if (sqlite3_open_v2(name, &db, flags, vfs) != SQLITE_OK) {
         #ifdef DEBUG
         if (sqlite3_open_end) {
             clock_gettime(CLOCK_MONOTONIC, sqlite3_open_end);
@@ -269,6 +375,15 @@ sqlite3 * opendb(const char * name, const OpenMode mode, const int setpragmas, c
     }
     #endif
 
+    /* let SQLite read pages directly out of the mapped file instead of copying them */
+    if ((mode == RDONLY) && mmap_size) {
+        char pragma[MAXSQL];
+        sqlite3_snprintf(sizeof(pragma), pragma, "PRAGMA mmap_size = %llu", (unsigned long long) mmap_size);
+        if (sqlite3_exec(db, pragma, NULL, NULL, NULL) != SQLITE_OK) {
+            fprintf(stderr, "Could not set mmap size\n");
+        }
+    }
+
     #ifdef DEBUG
     if (load_extension_start) {
         clock_gettime(CLOCK_MONOTONIC, load_extension_start);
@@ -519,6 +634,19 @@ int closedb(sqlite3 *db)
     return 0;
 }
 
+/* ask the kernel to start reading a database into the page cache without waiting for it */
+int prefetchdb(const char *name)
+{
+    const int fd = open(name, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    const int rc = posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+    return rc;
+}
+
 int insertdbfin(sqlite3_stmt *res)
 {
     sqlite3_finalize(res);
@@ -557,6 +685,38 @@ sqlite3_stmt * insertdbprepr(sqlite3 *db)
     return reso;
 }
 
+sqlite3_stmt * insertsubdirprep(sqlite3 *db)
+{
+    const char *tail;
+    int error = SQLITE_OK;
+    sqlite3_stmt *reso;
+
+    // WARNING: passing length-arg that is longer than SQL text
+    error= sqlite3_prepare_v2(db, sdsqli, MAXSQL, &reso, &tail);
+    if (error != SQLITE_OK) {
+          fprintf(stderr, "SQL error on insertsubdirprep: error %d %s err %s\n",
+                  error,sdsqli,sqlite3_errmsg(db));
+          return NULL;
+    }
+    return reso;
+}
+
+// record the basename of a subdirectory so that readers can find
+// the children of this directory without calling readdir
+int insertsubdirgo(const char *name, const size_t len, sqlite3 *db, sqlite3_stmt *res)
+{
+    int error = sqlite3_bind_text(res, 1, name, len, SQLITE_STATIC);
+    if (error != SQLITE_OK) {
+        fprintf(stderr, "SQL insertsubdirgo bind name: %s error %d err %s\n", name, error, sqlite3_errmsg(db));
+    }
+    else if ((error = sqlite3_step(res)) != SQLITE_DONE) {
+        fprintf(stderr, "SQL insertsubdirgo step: %s error %d err %s\n", name, error, sqlite3_errmsg(db));
+    }
+    sqlite3_reset(res);
+
+    return (error != SQLITE_DONE);
+}
+
 int insertdbgo(struct work *pwork, sqlite3 *db, sqlite3_stmt *res)
 {
     int error;
@@ -661,6 +821,99 @@ int insertdbgor(struct work *pwork, sqlite3 *db, sqlite3_stmt *res)
     return 0;
 }
 
+static const char *hist_tables[] = {
+    "summaryhist",
+    "treesummaryhist",
+};
+
+int queryhistdb(const char *name, struct sum *sumin, sqlite3 *db, int ts, size_t *bits)
+{
+     char sqlstmt[MAXSQL];
+     SNPRINTF(sqlstmt, MAXSQL, "SELECT kind, bucket, files, bytes, bits FROM %s;", hist_tables[ts]);
+
+     /* indexes built before the histograms were added do not have the table */
+     sqlite3_stmt *res = NULL;
+     if (sqlite3_prepare_v2(db, sqlstmt, MAXSQL, &res, NULL) != SQLITE_OK) {
+          return -1;
+     }
+
+     int rc = 0;
+     while (sqlite3_step(res) == SQLITE_ROW) {
+          const char *kind = (const char *) sqlite3_column_text(res, 0);
+          const sqlite3_int64 bucket = sqlite3_column_int64(res, 1);
+          if (!kind || (bucket < 0) || (bucket >= SUM_HIST_BUCKETS)) {
+               continue;
+          }
+
+          /* buckets with different bounds can't be added together */
+          const sqlite3_int64 row_bits = sqlite3_column_int64(res, 4);
+          if (!*bits && (row_bits > 0)) {
+               *bits = row_bits;
+          }
+          if ((row_bits <= 0) || ((size_t) row_bits != *bits)) {
+               rc = 1;
+               continue;
+          }
+
+          if (!strcmp(kind, "size")) {
+               sumin->sizehistfiles[bucket] += sqlite3_column_int64(res, 2);
+               sumin->sizehistbytes[bucket] += sqlite3_column_int64(res, 3);
+          }
+          else if (!strcmp(kind, "age")) {
+               sumin->agehistfiles[bucket]  += sqlite3_column_int64(res, 2);
+               sumin->agehistbytes[bucket]  += sqlite3_column_int64(res, 3);
+          }
+     }
+
+     sqlite3_finalize(res);
+     return rc;
+}
+
+int inserthistdb(sqlite3 *sdb, struct sum *su, int ts, const size_t bits)
+{
+    char sqlstmt[MAXSQL];
+    SNPRINTF(sqlstmt, MAXSQL, "INSERT INTO %s VALUES (@kind, @bucket, @low, @high, @files, @bytes, @bits);", hist_tables[ts]);
+
+    sqlite3_stmt *res = NULL;
+    if (sqlite3_prepare_v2(sdb, sqlstmt, MAXSQL, &res, NULL) != SQLITE_OK) {
+        fprintf(stderr, "SQL error on insert (%s): %s\n", hist_tables[ts], sqlite3_errmsg(sdb));
+        return -1;
+    }
+
+    static const char *kinds[] = {"size", "age"};
+    const long long int *files[] = {su->sizehistfiles, su->agehistfiles};
+    const long long int *bytes[] = {su->sizehistbytes, su->agehistbytes};
+
+    int rc = 0;
+    for(size_t k = 0; (k < 2) && !rc; k++) {
+        for(size_t b = 0; b < SUM_HIST_BUCKETS; b++) {
+            /* only keep the buckets that have files */
+            if (!files[k][b]) {
+                continue;
+            }
+
+            sqlite3_bind_text (res, 1, kinds[k], -1, SQLITE_STATIC);
+            sqlite3_bind_int64(res, 2, b);
+            sqlite3_bind_int64(res, 3, hist_bucket_low(b, bits));
+            sqlite3_bind_int64(res, 4, hist_bucket_high(b, bits));
+            sqlite3_bind_int64(res, 5, files[k][b]);
+            sqlite3_bind_int64(res, 6, bytes[k][b]);
+            sqlite3_bind_int64(res, 7, bits?bits:1);
+
+            if (sqlite3_step(res) != SQLITE_DONE) {
+                fprintf(stderr, "SQL error on insert (%s): %s\n", hist_tables[ts], sqlite3_errmsg(sdb));
+                rc = -1;
+                break;
+            }
+
+            sqlite3_reset(res);
+        }
+    }
+
+    sqlite3_finalize(res);
+    return rc;
+}
+
 int insertsumdb(sqlite3 *sdb, struct work *pwork,struct sum *su)
 {
     char *err_msg = 0;
@@ -759,7 +1012,7 @@ CREATE TABLE summary(name TEXT PRIMARY KEY, type TEXT, inode INT, mode INT, nlin
         return -1;
     }
 
-    return 0;
+    return inserthistdb(sdb, su, 0, in.hist_shift);
 }
 
 int inserttreesumdb(const char *name, sqlite3 *sdb, struct sum *su,int rectype,int uid,int gid)
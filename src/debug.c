@@ -85,8 +85,7 @@ long double sec(uint64_t nsec) {
     return ((long double) nsec) / 1e9L;
 }
 
-int print_timer(struct OutputBuffers * obufs, const size_t id, char * str, const size_t size, const char * name, struct start_end * se) {
-    const size_t len = snprintf(str, size, "%zu %s %" PRIu64 " %" PRIu64 "\n", id, name, since_epoch(&se->start) - epoch, since_epoch(&se->end) - epoch);
+static int print_line(struct OutputBuffers * obufs, const size_t id, const char * str, const size_t len) {
     const size_t capacity = obufs->buffers[id].capacity;
 
     /* if the row can fit within an empty buffer, try to add the new row to the buffer */
@@ -115,3 +114,13 @@ int print_timer(struct OutputBuffers * obufs, const size_t id, char * str, const
 
     return 0;
 }
+
+int print_timer(struct OutputBuffers * obufs, const size_t id, char * str, const size_t size, const char * name, struct start_end * se) {
+    const size_t len = snprintf(str, size, "%zu %s %" PRIu64 " %" PRIu64 "\n", id, name, since_epoch(&se->start) - epoch, since_epoch(&se->end) - epoch);
+    return print_line(obufs, id, str, len);
+}
+
+int print_counter(struct OutputBuffers * obufs, const size_t id, char * str, const size_t size, const char * name, const uint64_t value) {
+    const size_t len = snprintf(str, size, "%zu %s %" PRIu64 "\n", id, name, value);
+    return print_line(obufs, id, str, len);
+}
@@ -71,6 +71,7 @@ OF SUCH DAMAGE.
 #include <sys/xattr.h>
 #include <unistd.h>
 
+#include "EntryShards.h"
 #include "QueuePerThreadPool.h"
 #include "bf.h"
 #include "debug.h"
@@ -92,6 +93,138 @@ size_t total_dirs = 0;
 size_t total_files = 0;
 #endif
 
+/* get the metadata of an entry of a directory */
+static int get_entry(const char * dir, const char * name, const size_t len, struct work * e) {
+    memset(e, 0, sizeof(struct work));
+    SNFORMAT_S(e->name, MAXPATH, 3, dir, strlen(dir), "/", (size_t) 1, name, len);
+
+    if (lstat(e->name, &e->statuso) < 0) {
+        return 1;
+    }
+
+    /* e->xattrs_len = 0; */
+    if (in.doxattrs > 0) {
+        e->xattrs_len = pullxattrs(e->name, e->xattrs, sizeof(e->xattrs));
+    }
+
+    return 0;
+}
+
+/* insert a non-directory into a database; returns 1 if it was inserted */
+static int insert_entry(struct work * e, struct sum * summary, sqlite3 * db, sqlite3_stmt * res) {
+    if (S_ISLNK(e->statuso.st_mode)) {
+        e->type[0] = 'l';
+        readlink(e->name, e->linkname, MAXPATH);
+    }
+    else if (S_ISREG(e->statuso.st_mode)) {
+        e->type[0] = 'f';
+    }
+    else {
+        /* other types are not stored */
+        return 0;
+    }
+
+    #if BENCHMARK
+    pthread_mutex_lock(&global_mutex);
+    total_files++;
+    pthread_mutex_unlock(&global_mutex);
+    #endif
+
+    // get entry relative path
+    char e_name[MAXPATH];
+    SNPRINTF(e_name, MAXPATH, "%s", e->name + in.name_len);
+
+    // overwrite full path with relative path
+    SNFORMAT_S(e->name, MAXPATH, 1, e_name, strlen(e->name) - in.name_len);
+
+    // update summary table
+    sumit(summary, e);
+
+    // add entry into bulk insert
+    insertdbgo(e, db, res);
+
+    return 1;
+}
+
+/* give the index directory the source directory's permissions and owners */
+static void restore_dir(const char * topath, struct work * work) {
+    // ignore errors
+    chmod(topath, work->statuso.st_mode);
+    chown(topath, work->statuso.st_uid, work->statuso.st_gid);
+}
+
+/* names of entries of a large directory to insert into another database */
+struct ShardEntries {
+    struct EntryShards * shards;
+    size_t shard;
+    size_t count;
+    char * names;                       /* count NUL terminated names */
+    size_t len;
+    size_t capacity;
+};
+
+static struct ShardEntries * ShardEntries_init(struct EntryShards * shards) {
+    struct ShardEntries * batch = calloc(1, sizeof(struct ShardEntries));
+    batch->shards = shards;
+    batch->shard = EntryShards_add(shards);
+    return batch;
+}
+
+static void ShardEntries_add(struct ShardEntries * batch, const char * name, const size_t len) {
+    if ((batch->len + len + 1) > batch->capacity) {
+        batch->capacity = (batch->capacity + len + 1) * 2;
+        batch->names = realloc(batch->names, batch->capacity);
+    }
+
+    memcpy(batch->names + batch->len, name, len + 1);
+    batch->len += len + 1;
+    batch->count++;
+}
+
+/* insert a batch of entries of a large directory into their own database */
+static int processshard(struct QPTPool * ctx, const size_t id, void * data, void * args) {
+    (void) ctx; (void) id; (void) args;
+
+    struct ShardEntries * batch = (struct ShardEntries *) data;
+    struct EntryShards * shards = batch->shards;
+
+    struct sum summary;
+    EntryShards_zeroit(&summary);
+
+    sqlite3 * db = EntryShards_open(shards, batch->shard, templatefd, templatesize);
+    if (db) {
+        sqlite3_stmt * res = insertdbprep(db);
+
+        startdb(db);
+
+        const char * name = batch->names;
+        for(size_t i = 0; i < batch->count; i++) {
+            const size_t len = strlen(name);
+
+            struct work e;
+            if (get_entry(shards->dir.name, name, len, &e) == 0) {
+                insert_entry(&e, &summary, db, res);
+            }
+
+            name += len + 1;
+        }
+
+        stopdb(db);
+        insertdbfin(res);
+        closedb(db);
+    }
+
+    if (EntryShards_done(shards, &summary)) {
+        restore_dir(shards->path, &shards->dir);
+        EntryShards_destroy(shards);
+    }
+
+    free(batch->names);
+    free(batch);
+
+    return !db;
+}
+
 int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args) {
     #if BENCHMARK
     pthread_mutex_lock(&global_mutex);
@@ -148,7 +281,7 @@ int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args)
         return 1;
     }
 
-    sqlite3 * db = opendb(dbname, RDWR, 1, 0,
+    sqlite3 * db = opendb(dbname, RDWR, 1, 0, 0,
                           NULL, NULL
                           #ifdef DEBUG
                           , NULL, NULL
@@ -167,9 +300,18 @@ int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args)
     zeroit(&summary);
 
     sqlite3_stmt * res = insertdbprep(db);
+    sqlite3_stmt * subdirs_res = insertsubdirprep(db);
 
     startdb(db);
 
+    // the other databases of a directory with more than in.shard_entries entries
+    struct EntryShards * shards = NULL;
+    struct ShardEntries * batch = NULL;
+
+    // subdirectories are enqueued a batch at a time
+    struct QPTPoolBatch subdirs;
+    QPTPool_batch_init(&subdirs);
+
     struct dirent * entry = NULL;
     size_t rows = 0;
     while ((entry = readdir(dir))) {
@@ -183,20 +325,32 @@ int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args)
             }
         }
 
+        // once this database is full, send the entries that are
+        // known to not be directories to other threads to insert
+        if (in.shard_entries && (rows >= in.shard_entries) &&
+            (entry->d_type != DT_DIR) && (entry->d_type != DT_UNKNOWN)) {
+            if (!shards) {
+                shards = EntryShards_init(topath, work);
+            }
 
-        // get entry path
-        struct work e;
-        memset(&e, 0, sizeof(struct work));
-        SNFORMAT_S(e.name, MAXPATH, 3, work->name, strlen(work->name), "/", 1, entry->d_name, len);
+            if (!batch) {
+                batch = ShardEntries_init(shards);
+            }
+
+            ShardEntries_add(batch, entry->d_name, len);
+
+            if (batch->count == in.shard_entries) {
+                QPTPool_enqueue(ctx, id, processshard, batch);
+                batch = NULL;
+            }
 
-        // get the entry's metadata
-        if (lstat(e.name, &e.statuso) < 0) {
             continue;
         }
 
-        /* e.xattrs_len = 0; */
-        if (in.doxattrs > 0) {
-            e.xattrs_len = pullxattrs(e.name, e.xattrs, sizeof(e.xattrs));
+        // get the entry's metadata
+        struct work e;
+        if (get_entry(work->name, entry->d_name, len, &e) != 0) {
+            continue;
         }
 
         // push subdirectories onto the queue
@@ -211,55 +365,40 @@ int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args)
                 struct work * copy = (struct work *) calloc(1, sizeof(struct work));
                 memcpy(copy, &e, sizeof(struct work));
 
-                QPTPool_enqueue(ctx, id, processdir, copy);
+                if (QPTPool_batch_add(&subdirs, processdir, copy) == QPTPOOL_BATCH_SIZE) {
+                    QPTPool_enqueue_batch(ctx, id, &subdirs);
+                }
+
+                // remember the subdirectory so queries do not need to readdir
+                insertsubdirgo(entry->d_name, len, db, subdirs_res);
                 continue;
             }
         }
 
-        rows++;
-
         // non directories
-        if (S_ISLNK(e.statuso.st_mode)) {
-            e.type[0] = 'l';
-            readlink(e.name, e.linkname, MAXPATH);
-        }
-        else if (S_ISREG(e.statuso.st_mode)) {
-            e.type[0] = 'f';
-        }
-        else {
-            /* other types are not stored */
-            continue;
-        }
-
-        #if BENCHMARK
-        pthread_mutex_lock(&global_mutex);
-        total_files++;
-        pthread_mutex_unlock(&global_mutex);
-        #endif
-
-        // get entry relative path
-        char e_name[MAXPATH];
-        SNPRINTF(e_name, MAXPATH, "%s", e.name + in.name_len);
-
-        // overwrite full path with relative path
-        SNFORMAT_S(e.name, MAXPATH, 1, e_name, strlen(e.name) - in.name_len);
+        rows += insert_entry(&e, &summary, db, res);
+    }
 
-        // update summary table
-        sumit(&summary, &e);
+    QPTPool_enqueue_batch(ctx, id, &subdirs);
 
-        // add entry into bulk insert
-        insertdbgo(&e, db, res);
+    if (batch) {
+        QPTPool_enqueue(ctx, id, processshard, batch);
     }
 
     stopdb(db);
+    insertdbfin(subdirs_res);
     insertdbfin(res);
-    insertsumdb(db, work, &summary);
+    if (!shards) {
+        insertsumdb(db, work, &summary);
+    }
     closedb(db);
     db = NULL;
 
-    // ignore errors
-    chmod(topath, work->statuso.st_mode);
-    chown(topath, work->statuso.st_uid, work->statuso.st_gid);
+    // the last database of a sharded directory writes the summary
+    if (!shards || EntryShards_done(shards, &summary)) {
+        restore_dir(topath, work);
+        EntryShards_destroy(shards);
+    }
 
     closedir(dir);
 
@@ -415,7 +554,7 @@ void sub_help() {
 }
 
 int main(int argc, char * argv[]) {
-    int idx = parse_cmd_line(argc, argv, "hHn:xz:", 2, "input_dir output_dir", &in);
+    int idx = parse_cmd_line(argc, argv, "hHn:xz:C:|max-queued|shard-entries", 2, "input_dir output_dir", &in);
     if (in.helped)
         sub_help();
     if (idx < 0)
@@ -443,7 +582,7 @@ int main(int argc, char * argv[]) {
     fprintf(stderr, "Creating GUFI Index %s in %s with %d threads\n", in.name, in.nameto, in.maxthreads);
     #endif
 
-    if ((templatesize = create_template(&templatefd)) == (off_t) -1) {
+    if ((templatesize = create_template(&templatefd, 1)) == (off_t) -1) {
         fprintf(stderr, "Could not create template file\n");
         return -1;
     }
@@ -459,6 +598,8 @@ int main(int argc, char * argv[]) {
         return -1;
     }
 
+    QPTPool_set_queue_limit(pool, in.max_queued);
+
     if (QPTPool_start(pool, NULL) != (size_t) in.maxthreads) {
         fprintf(stderr, "Failed to start threads\n");
         return -1;
@@ -466,6 +607,11 @@ int main(int argc, char * argv[]) {
 
     QPTPool_enqueue(pool, 0, processdir, root);
     QPTPool_wait(pool);
+
+    if (in.max_queued) {
+        fprintf(stderr, "Queue limit reached: %zu directories processed inline\n", QPTPool_inlined(pool));
+    }
+
     QPTPool_destroy(pool);
 
     #if BENCHMARK
@@ -0,0 +1,365 @@
+/*
+This file is part of GUFI, which is part of MarFS, which is released
+under the BSD license.
+
+
+Copyright (c) 2017, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2017, Los Alamos National Security, LLC All rights reserved.
+Copyright 2017. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+
+
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "QueuePerThreadPool.h"
+#include "bf.h"
+#include "dbutils.h"
+#include "utils.h"
+
+extern int errno;
+
+/* an index directory waiting to be packed */
+struct pack_work {
+    char name[MAXPATH];
+    long long id;
+    long long parent;
+};
+
+struct PackArgs {
+    /* one pack file per thread, so appending does not need a lock */
+    int * packs;
+    off_t * pack_sizes;
+
+    /* the table of contents is shared */
+    pthread_mutex_t toc_mutex;
+    sqlite3 * toc;
+    sqlite3_stmt * res;
+
+    pthread_mutex_t id_mutex;
+    long long next_id;
+};
+
+/* append the database file at src_name to the end of the pack */
+static ssize_t append_db(const char * src_name, const int dst, const off_t offset) {
+    const int src = open(src_name, O_RDONLY);
+    if (src < 0) {
+        return -1;
+    }
+
+    char buf[65536];
+    ssize_t total = 0;
+    ssize_t got = 0;
+    while ((got = read(src, buf, sizeof(buf))) > 0) {
+        ssize_t written = 0;
+        while (written < got) {
+            const ssize_t w = pwrite(dst, buf + written, got - written, offset + total + written);
+            if (w < 1) {
+                close(src);
+                return -1;
+            }
+            written += w;
+        }
+        total += got;
+    }
+
+    close(src);
+    return (got < 0)?-1:total;
+}
+
+int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args) {
+    struct pack_work * work = (struct pack_work *) data;
+    struct PackArgs * pa = (struct PackArgs *) args;
+
+    DIR * dir = opendir(work->name);
+    if (!dir) {
+        fprintf(stderr, "Could not open directory \"%s\"\n", work->name);
+        free(work);
+        return 1;
+    }
+
+    const size_t name_len = strlen(work->name);
+
+    /* copy the database into this thread's pack */
+    char dbname[MAXPATH];
+    SNFORMAT_S(dbname, MAXPATH, 2, work->name, name_len, "/" DBNAME, (size_t) (DBNAME_LEN + 1));
+
+    const off_t offset = pa->pack_sizes[id];
+    ssize_t length = append_db(dbname, pa->packs[id], offset);
+    if (length < 0) {
+        /* directories without databases are still recorded */
+        length = 0;
+    }
+    pa->pack_sizes[id] += length;
+
+    /* get the basename */
+    char parent[MAXPATH];
+    char name[MAXPATH];
+    shortpath(work->name, parent, name);
+
+    pthread_mutex_lock(&pa->toc_mutex);
+    sqlite3_bind_int64(pa->res, 1, work->id);
+    sqlite3_bind_int64(pa->res, 2, work->parent);
+    sqlite3_bind_text (pa->res, 3, name, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(pa->res, 4, id);
+    sqlite3_bind_int64(pa->res, 5, offset);
+    sqlite3_bind_int64(pa->res, 6, length);
+    if (sqlite3_step(pa->res) != SQLITE_DONE) {
+        fprintf(stderr, "Could not add \"%s\" to the table of contents: %s\n", work->name, sqlite3_errmsg(pa->toc));
+    }
+    sqlite3_reset(pa->res);
+    pthread_mutex_unlock(&pa->toc_mutex);
+
+    struct dirent * entry = NULL;
+    while ((entry = readdir(dir))) {
+        if (entry->d_type != DT_DIR) {
+            continue;
+        }
+
+        const size_t len = strlen(entry->d_name);
+
+        /* skip . and .. */
+        if (entry->d_name[0] == '.') {
+            if ((len == 1) ||
+                ((len == 2) && (entry->d_name[1] == '.'))) {
+                continue;
+            }
+        }
+
+        struct pack_work * child = (struct pack_work *) malloc(sizeof(struct pack_work));
+        SNFORMAT_S(child->name, MAXPATH, 3, work->name, name_len, "/", (size_t) 1, entry->d_name, len);
+        child->parent = work->id;
+
+        pthread_mutex_lock(&pa->id_mutex);
+        child->id = pa->next_id++;
+        pthread_mutex_unlock(&pa->id_mutex);
+
+        QPTPool_enqueue(ctx, id, processdir, child);
+    }
+
+    closedir(dir);
+    free(work);
+
+    return 0;
+}
+
+static int create_toc_tables(const char * name, sqlite3 * db, void * args) {
+    (void) args;
+
+    if ((create_table_wrapper(name, db, "tocsql",   tocsql,   NULL, NULL) != SQLITE_OK) ||
+        (create_table_wrapper(name, db, "packssql", packssql, NULL, NULL) != SQLITE_OK)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static void close_packs(int * packs, const int count) {
+    for(int i = 0; i < count; i++) {
+        close(packs[i]);
+    }
+}
+
+void sub_help() {
+   printf("GUFI_index        pack this index\n");
+   printf("toc               table of contents of the packed index; pack files are named toc.<thread id>\n");
+   printf("\n");
+}
+
+int main(int argc, char * argv[]) {
+    int idx = parse_cmd_line(argc, argv, "hHn:", 2, "GUFI_index toc", &in);
+    if (in.helped)
+        sub_help();
+    if (idx < 0)
+        return -1;
+    else {
+        /* parse positional args, following the options */
+        int retval = 0;
+        INSTALL_STR(in.name,   argv[idx++], MAXPATH, "GUFI_index");
+        INSTALL_STR(in.nameto, argv[idx++], MAXPATH, "toc");
+
+        if (retval)
+            return retval;
+    }
+
+    struct stat st;
+    if ((lstat(in.name, &st) != 0) || !S_ISDIR(st.st_mode)) {
+        fprintf(stderr, "\"%s\" is not a directory\n", in.name);
+        return -1;
+    }
+
+    /* remove any existing table of contents */
+    unlink(in.nameto);
+
+    struct PackArgs pa;
+    pa.packs = calloc(in.maxthreads, sizeof(int));
+    pa.pack_sizes = calloc(in.maxthreads, sizeof(off_t));
+    pthread_mutex_init(&pa.toc_mutex, NULL);
+    pthread_mutex_init(&pa.id_mutex, NULL);
+    pa.next_id = 2; /* the top level directory is 1 */
+
+    if (!(pa.toc = opendb(in.nameto, RDWR, 1, 0, 0,
+                          create_toc_tables, NULL
+                          #ifdef DEBUG
+                          , NULL, NULL
+                          , NULL, NULL
+                          , NULL, NULL
+                          , NULL, NULL
+                          #endif
+                          ))) {
+        fprintf(stderr, "Could not create table of contents \"%s\"\n", in.nameto);
+        free(pa.pack_sizes);
+        free(pa.packs);
+        return -1;
+    }
+
+    /* pack names are stored relative to the table of contents */
+    char toc_copy[MAXPATH];
+    SNPRINTF(toc_copy, MAXPATH, "%s", in.nameto);
+    const char * toc_base = basename(toc_copy);
+
+    sqlite3_stmt * pack_res = NULL;
+    sqlite3_prepare_v2(pa.toc, "INSERT INTO packs VALUES (@id, @name);", -1, &pack_res, NULL);
+
+    int rc = 0;
+    for(int i = 0; i < in.maxthreads; i++) {
+        char pack_name[MAXPATH];
+        SNPRINTF(pack_name, MAXPATH, "%s.%d", in.nameto, i);
+
+        /* the packs hold every database in the index, so */
+        /* they are only readable by the owner by default */
+        if ((pa.packs[i] = open(pack_name, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR)) < 0) {
+            fprintf(stderr, "Could not create pack \"%s\": %s\n", pack_name, strerror(errno));
+            close_packs(pa.packs, i);
+            rc = -1;
+            break;
+        }
+
+        char pack_base[MAXPATH];
+        SNPRINTF(pack_base, MAXPATH, "%s.%d", toc_base, i);
+        sqlite3_bind_int64(pack_res, 1, i);
+        sqlite3_bind_text (pack_res, 2, pack_base, -1, SQLITE_STATIC);
+        sqlite3_step(pack_res);
+        sqlite3_reset(pack_res);
+    }
+    sqlite3_finalize(pack_res);
+
+    if (rc) {
+        closedb(pa.toc);
+        free(pa.pack_sizes);
+        free(pa.packs);
+        return rc;
+    }
+
+    pa.res = NULL;
+    if (sqlite3_prepare_v2(pa.toc, tocsqli, -1, &pa.res, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Could not prepare table of contents insert: %s\n", sqlite3_errmsg(pa.toc));
+        close_packs(pa.packs, in.maxthreads);
+        closedb(pa.toc);
+        free(pa.pack_sizes);
+        free(pa.packs);
+        return -1;
+    }
+
+    startdb(pa.toc);
+
+    struct QPTPool * pool = QPTPool_init(in.maxthreads);
+    if (!pool) {
+        fprintf(stderr, "Failed to initialize thread pool\n");
+        return -1;
+    }
+
+    if (QPTPool_start(pool, &pa) != (size_t) in.maxthreads) {
+        fprintf(stderr, "Failed to start threads\n");
+        return -1;
+    }
+
+    struct pack_work * root = (struct pack_work *) calloc(1, sizeof(struct pack_work));
+    SNPRINTF(root->name, MAXPATH, "%s", in.name);
+    root->id = 1;
+    root->parent = 0;
+
+    QPTPool_enqueue(pool, 0, processdir, root);
+    QPTPool_wait(pool);
+    QPTPool_destroy(pool);
+
+    stopdb(pa.toc);
+    insertdbfin(pa.res);
+
+    /* build the index after all of the rows have been inserted */
+    if (create_table_wrapper(in.nameto, pa.toc, "tocidxsql", tocidxsql, NULL, NULL) != SQLITE_OK) {
+        rc = -1;
+    }
+
+    closedb(pa.toc);
+
+    close_packs(pa.packs, in.maxthreads);
+    pthread_mutex_destroy(&pa.id_mutex);
+    pthread_mutex_destroy(&pa.toc_mutex);
+    free(pa.pack_sizes);
+    free(pa.packs);
+
+    return rc;
+}
@@ -64,6 +64,7 @@ OF SUCH DAMAGE.
 
 #include <dirent.h>
 #include <errno.h>
+#include <limits.h>
 #include <pthread.h>
 #include <sqlite3.h>
 #include <stdio.h>
@@ -81,10 +82,17 @@ OF SUCH DAMAGE.
 #include "outdbs.h"
 #include "outfiles.h"
 #include "OutputBuffers.h"
+#include "PackedIndex.h"
 #include "pcre.h"
 #include "QueuePerThreadPool.h"
 #include "SinglyLinkedList.h"
+#include "StreamingAggregate.h"
+#include "OwnerFilter.h"
+#include "RangePrune.h"
+#include "ResultCache.h"
+#include "TopK.h"
 #include "utils.h"
+#include "vfs.h"
 
 extern int errno;
 #define AGGREGATE_NAME         "file:aggregate%d?mode=memory&cache=shared"
@@ -115,6 +123,7 @@ enum {
     dt_access_call,
     dt_set,
     dt_make_clone,
+    dt_prefetch_call,
     dt_pushdir,
 
     dt_max
@@ -180,6 +189,7 @@ uint64_t total_isdir_branch_time = 0;
 uint64_t total_access_time = 0;
 uint64_t total_set_time = 0;
 uint64_t total_clone_time = 0;
+uint64_t total_prefetch_time = 0;
 uint64_t total_pushdir_time = 0;
 uint64_t total_attach_time = 0;
 uint64_t total_sqltsumcheck_time = 0;
@@ -192,6 +202,12 @@ uint64_t total_closedir_time = 0;
 uint64_t total_utime_time = 0;
 uint64_t total_free_work_time = 0;
 uint64_t total_output_timestamps_time = 0;
+uint64_t total_vfs_bytes = 0;
+uint64_t total_vfs_syscalls = 0;
+uint64_t total_topk_pruned = 0;
+uint64_t total_range_pruned_subtrees = 0;
+uint64_t total_range_pruned_entries = 0;
+uint64_t total_owner_pruned_subtrees = 0;
 
 uint64_t buffer_sum(struct sll * timers) {
     uint64_t sum = 0;
@@ -222,6 +238,13 @@ uint64_t buffer_sum(struct sll * timers) {
 
 int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args);
 
+/* start reading a subdirectory's database before a thread gets to it */
+static void prefetch(const char * dir, const size_t dir_len) {
+    char dbname[MAXPATH];
+    SNFORMAT_S(dbname, MAXPATH, 3, dir, dir_len, "/", (size_t) 1, DBNAME, DBNAME_LEN);
+    prefetchdb(dbname);
+}
+
 /* Push the subdirectories in the current directory onto the queue */
 static size_t descend2(struct QPTPool *ctx,
                        const size_t id,
@@ -251,6 +274,8 @@ static size_t descend2(struct QPTPool *ctx,
 
     buffered_start(level_cmp);
     size_t pushed = 0;
+    struct QPTPoolBatch batch;
+    QPTPool_batch_init(&batch);
     const size_t next_level = passmywork->level + 1;
     const int level_check = (next_level <= max_level);
     buffered_end(level_cmp);
@@ -317,6 +342,7 @@ static size_t descend2(struct QPTPool *ctx,
                     buffered_start(set);
                     qwork.level = next_level;
                     qwork.root = passmywork->root;
+                    qwork.index = NULL;
                     /* qwork.type[0] = 'd'; */
 
                     /* this is how the parent gets passed on */
@@ -330,9 +356,18 @@ static size_t descend2(struct QPTPool *ctx,
                     memcpy(clone, &qwork, sizeof(struct work));
                     buffered_end(make_clone);
 
-                    /* push the subdirectory into the queue for processing */
+                    /* get the database off of the disk before a thread tries to open it */
+                    buffered_start(prefetch_call);
+                    if (pushed < in.prefetch) {
+                        prefetch(qwork.name, strlen(qwork.name));
+                    }
+                    buffered_end(prefetch_call);
+
+                    /* push the subdirectories into the queue for processing a batch at a time */
                     buffered_start(pushdir);
-                    QPTPool_enqueue(ctx, id, processdir, clone);
+                    if (QPTPool_batch_add(&batch, processdir, clone) == QPTPOOL_BATCH_SIZE) {
+                        QPTPool_enqueue_batch(ctx, id, &batch);
+                    }
                     buffered_end(pushdir);
 
                     pushed++;
@@ -347,6 +382,10 @@ static size_t descend2(struct QPTPool *ctx,
             }
         }
         buffered_end(while_branch);
+
+        buffered_start(pushdir);
+        QPTPool_enqueue_batch(ctx, id, &batch);
+        buffered_end(pushdir);
     }
     else {
         buffered_end(level_branch);
@@ -356,6 +395,78 @@ static size_t descend2(struct QPTPool *ctx,
     return pushed;
 }
 
+/*
+ * Push the subdirectories listed in the subdirs table onto the queue
+ *
+ * Returns 0 if the subdirectories were read from the database and
+ * non-zero if the table could not be read (i.e. an index that was
+ * not built with a subdirs table), in which case the caller should
+ * fall back to readdir.
+ */
+static int descend_subdirs(struct QPTPool *ctx,
+                           const size_t id,
+                           struct work *passmywork,
+                           sqlite3 *db,
+                           const char *table,
+                           QPTPoolFunc_t func,
+                           const size_t max_level,
+                           size_t *pushed) {
+    *pushed = 0;
+
+    if (!db) {
+        return 1;
+    }
+
+    char sql[MAXSQL];
+    SNPRINTF(sql, MAXSQL, "SELECT name FROM %s;", table);
+
+    sqlite3_stmt *res = NULL;
+    if (sqlite3_prepare_v2(db, sql, -1, &res, NULL) != SQLITE_OK) {
+        sqlite3_finalize(res);
+        return 1;
+    }
+
+    /*
+     * the subdirectories are only enqueued after the statement is
+     * finalized because, with --max-queued, enqueuing can process them
+     * inline, and they might use this thread's connection while the
+     * statement is still open on it
+     */
+    struct QPTPoolBatch batch;
+    QPTPool_batch_init(&batch);
+
+    const size_t next_level = passmywork->level + 1;
+    if (next_level <= max_level) {
+        const size_t name_len = strlen(passmywork->name);
+        while (sqlite3_step(res) == SQLITE_ROW) {
+            const char *subdir = (const char *) sqlite3_column_text(res, 0);
+            const size_t len = sqlite3_column_bytes(res, 0);
+
+            /* make a clone here so that the data can be pushed into the queue */
+            struct work * clone = (struct work *) malloc(sizeof(struct work));
+            SNFORMAT_S(clone->name, MAXPATH, 3, passmywork->name, name_len, "/", (size_t) 1, subdir, len);
+            clone->level = next_level;
+            clone->root = passmywork->root;
+            clone->index = NULL;
+
+            /* get the database off of the disk before a thread tries to open it */
+            if (*pushed < in.prefetch) {
+                prefetch(clone->name, name_len + 1 + len);
+            }
+
+            QPTPool_batch_add(&batch, func, clone);
+
+            (*pushed)++;
+        }
+    }
+
+    sqlite3_finalize(res);
+
+    QPTPool_enqueue_batch(ctx, id, &batch);
+
+    return 0;
+}
+
 /* sqlite3_exec callback argument data */
 struct CallbackArgs {
     struct OutputBuffers * output_buffers; /* buffers for printing into before writing to stdout */
@@ -364,12 +475,62 @@ struct CallbackArgs {
     /* size_t printed;                        /\* number of records printed by the callback *\/ */
 };
 
+/* --max-results: the number of rows that all threads have tried to print */
+static size_t results_printed = 0;
+
+/* whether or not --max-results rows have been printed */
+static int results_done(void) {
+    return in.max_results && (__atomic_load_n(&results_printed, __ATOMIC_RELAXED) >= in.max_results);
+}
+
+/* whether or not to stop querying because of --max-results or --timeout */
+static int stopped(struct QPTPool * ctx) {
+    return results_done() || QPTPool_cancelled(ctx);
+}
+
+/* --timeout: the database each thread is querying, so that the query can be interrupted */
+struct ActiveDB {
+    pthread_mutex_t mutex;
+    sqlite3 * db;
+};
+
+static struct ActiveDB * active_dbs = NULL;
+
+/* returns the previous database, which is restored by work that was processed inline */
+static sqlite3 * set_active_db(const size_t id, sqlite3 * db) {
+    sqlite3 * prev = NULL;
+    if (active_dbs) {
+        pthread_mutex_lock(&active_dbs[id].mutex);
+        prev = active_dbs[id].db;
+        active_dbs[id].db = db;
+        pthread_mutex_unlock(&active_dbs[id].mutex);
+    }
+    return prev;
+}
+
+/* called by QPTPool_cancel for each thread */
+static void interrupt_db(struct QPTPool * ctx, const size_t id, void * args) {
+    (void) ctx; (void) args;
+
+    pthread_mutex_lock(&active_dbs[id].mutex);
+    if (active_dbs[id].db) {
+        sqlite3_interrupt(active_dbs[id].db);
+    }
+    pthread_mutex_unlock(&active_dbs[id].mutex);
+}
+
 static int print_callback(void *args, int count, char **data, char **columns) {
     /* skip argument checking */
     /* if (!args) { */
     /*     return 1; */
     /* } */
 
+    /* take a row from the budget, and stop the query once there are none left */
+    if (in.max_results &&
+        (__atomic_fetch_add(&results_printed, 1, __ATOMIC_RELAXED) >= in.max_results)) {
+        return 1;
+    }
+
     struct CallbackArgs *ca = (struct CallbackArgs *) args;
     const int id = ca->id;
     struct OutputBuffers *obs = ca->output_buffers;
@@ -442,6 +603,244 @@ static int print_callback(void *args, int count, char **data, char **columns) {
     return 0;
 }
 
+/* only count the rows, for queries whose results are not output */
+static int count_callback(void *args, int count, char **data, char **columns) {
+    (void) count; (void) data; (void) columns;
+
+    struct CallbackArgs *ca = (struct CallbackArgs *) args;
+    ca->rows++;
+
+    return 0;
+}
+
+/* one result cache connection per thread when -Q is used */
+static struct ResultCache *result_caches = NULL;
+
+/* hash of everything that changes the rows printed for a directory, except for the starting path */
+static uint64_t result_cache_query = 0;
+
+static uint64_t hash_queries(void) {
+    uint64_t hash = RESULT_CACHE_HASH_INIT;
+    hash = ResultCache_hash(hash, in.sqltsum,     in.sqltsum_len + 1);
+    hash = ResultCache_hash(hash, in.sqlsum,      in.sqlsum_len + 1);
+    hash = ResultCache_hash(hash, in.sqlent,      in.sqlent_len + 1);
+    hash = ResultCache_hash(hash, in.prune,       in.prune_len + 1);
+    hash = ResultCache_hash(hash, &in.andor,      sizeof(in.andor));
+    hash = ResultCache_hash(hash, in.delim,       1);
+    hash = ResultCache_hash(hash, &in.min_level,  sizeof(in.min_level));
+    hash = ResultCache_hash(hash, &in.max_level,  sizeof(in.max_level));
+    return hash;
+}
+
+/* buffer the rows of the current directory so that they can be cached */
+static int cache_callback(void *args, int count, char **data, char **columns) {
+    (void) columns;
+
+    struct CallbackArgs *ca = (struct CallbackArgs *) args;
+    if (ResultCache_add_row(&result_caches[ca->id], count, data, in.delim[0]) != 0) {
+        fprintf(stderr, "Could not buffer row\n");
+        return 1;
+    }
+
+    ca->rows++;
+
+    return 0;
+}
+
+/* print the buffered rows of the current directory */
+static void cache_print(struct OutputBuffers *obs, const int id, struct ResultCache *cache) {
+    struct OutputBuffer *ob = &obs->buffers[id];
+
+    /* same as print_callback, but with all of the rows at once */
+    if ((ob->capacity - ob->filled) < cache->len) {
+        if (obs->mutex) {
+            pthread_mutex_lock(obs->mutex);
+        }
+        OutputBuffer_flush(ob, gts.outfd[id]);
+        if (obs->mutex) {
+            pthread_mutex_unlock(obs->mutex);
+        }
+    }
+
+    if (ob->capacity < cache->len) {
+        if (obs->mutex) {
+            pthread_mutex_lock(obs->mutex);
+        }
+        fwrite(cache->buf, sizeof(char), cache->len, gts.outfd[id]);
+        if (obs->mutex) {
+            pthread_mutex_unlock(obs->mutex);
+        }
+    }
+    else {
+        memcpy((char *) ob->buf + ob->filled, cache->buf, cache->len);
+        ob->filled += cache->len;
+    }
+
+    ob->count += cache->rows;
+}
+
+/* one running aggregate per thread when -U is used */
+static struct StreamingAggregate *stream_aggregates = NULL;
+
+/* fold rows into the thread's running aggregate instead of printing them */
+static int stream_callback(void *args, int count, char **data, char **columns) {
+    (void) columns;
+
+    struct CallbackArgs *ca = (struct CallbackArgs *) args;
+    if (StreamingAggregate_add(&stream_aggregates[ca->id], count, data) != 0) {
+        fprintf(stderr, "Could not aggregate row: expected %zu columns, got %d\n",
+                stream_aggregates[ca->id].columns, count);
+        return 1;
+    }
+
+    ca->rows++;
+
+    return 0;
+}
+
+/* combine the per-thread aggregates and print them through print_callback */
+static int stream_fin(struct OutputBuffers *output_buffers) {
+    int rc = 0;
+    for(int i = 1; i < in.maxthreads; i++) {
+        if (StreamingAggregate_merge(&stream_aggregates[0], &stream_aggregates[i]) != 0) {
+            rc = -1;
+        }
+    }
+
+    struct CallbackArgs ca;
+    ca.output_buffers = output_buffers;
+    ca.id = 0;
+    ca.rows = 0;
+    StreamingAggregate_output(&stream_aggregates[0], print_callback, &ca);
+
+    for(int i = 0; i < in.maxthreads; i++) {
+        StreamingAggregate_destroy(&stream_aggregates[i]);
+    }
+    free(stream_aggregates);
+    stream_aggregates = NULL;
+
+    return rc;
+}
+
+/* one bounded heap per thread when -k is used */
+static struct TopK *topk_heaps = NULL;
+
+/* keep rows only if they are among the k largest seen by this thread */
+static int topk_callback(void *args, int count, char **data, char **columns) {
+    (void) columns;
+
+    struct CallbackArgs *ca = (struct CallbackArgs *) args;
+    if (TopK_add(&topk_heaps[ca->id], count, data) != 0) {
+        return 1;
+    }
+
+    ca->rows++;
+
+    return 0;
+}
+
+/*
+ * whether none of the entries in this directory can be in the top k
+ * because the summary says none of them are larger than the smallest
+ * value this thread is already keeping
+ */
+static int topk_prune(sqlite3 *db, const size_t id) {
+    if (!topk_heaps || !in.topk_bound[0] || !TopK_full(&topk_heaps[id])) {
+        return 0;
+    }
+
+    char sql[MAXSQL];
+    SNPRINTF(sql, MAXSQL, "SELECT max(%s) FROM summary;", in.topk_bound);
+
+    sqlite3_stmt *res = NULL;
+    int prune = 0;
+    if (sqlite3_prepare_v2(db, sql, -1, &res, NULL) == SQLITE_OK) {
+        if ((sqlite3_step(res) == SQLITE_ROW) &&
+            (sqlite3_column_type(res, 0) != SQLITE_NULL)) {
+            prune = ((long double) sqlite3_column_double(res, 0) <= TopK_min(&topk_heaps[id]));
+        }
+    }
+    sqlite3_finalize(res);
+
+    return prune;
+}
+
+/* queries generated from -X for the treesummary and summary tables */
+static char range_prune_tsum[MAXSQL];
+static char range_prune_sum[MAXSQL];
+
+/*
+ * whether none of the entries described by the table can satisfy -X
+ * a missing table (no treesummary) means nothing is known
+ */
+static int range_prune(sqlite3 *db, const char *sql) {
+    if (!db || !sql[0]) {
+        return 0;
+    }
+
+    sqlite3_stmt *res = NULL;
+    int prune = 0;
+    if (sqlite3_prepare_v2(db, sql, -1, &res, NULL) == SQLITE_OK) {
+        if (sqlite3_step(res) == SQLITE_ROW) {
+            prune = sqlite3_column_int(res, 0);
+        }
+    }
+    sqlite3_finalize(res);
+
+    return prune;
+}
+
+/* uid and gid that -X limits entries to */
+static int prune_uid_set = 0;
+static long long prune_uid = 0;
+static int prune_gid_set = 0;
+static long long prune_gid = 0;
+
+/* whether or not the treeowners filters say the uid or gid is not in this subtree */
+static int owner_prune(sqlite3 *db) {
+    if (!db || (!prune_uid_set && !prune_gid_set)) {
+        return 0;
+    }
+
+    sqlite3_stmt *res = NULL;
+    int prune = 0;
+    if (sqlite3_prepare_v2(db, "SELECT uids, gids FROM treeowners;", -1, &res, NULL) == SQLITE_OK) {
+        if (sqlite3_step(res) == SQLITE_ROW) {
+            prune = (prune_uid_set &&
+                     !OwnerFilter_contains(sqlite3_column_blob(res, 0), sqlite3_column_bytes(res, 0), prune_uid)) ||
+                    (prune_gid_set &&
+                     !OwnerFilter_contains(sqlite3_column_blob(res, 1), sqlite3_column_bytes(res, 1), prune_gid));
+        }
+    }
+    sqlite3_finalize(res);
+
+    return prune;
+}
+
+/* combine the per-thread heaps and print them through print_callback */
+static int topk_fin(struct OutputBuffers *output_buffers) {
+    int rc = 0;
+    for(int i = 1; i < in.maxthreads; i++) {
+        if (TopK_merge(&topk_heaps[0], &topk_heaps[i]) != 0) {
+            rc = -1;
+        }
+    }
+
+    struct CallbackArgs ca;
+    ca.output_buffers = output_buffers;
+    ca.id = 0;
+    ca.rows = 0;
+    TopK_output(&topk_heaps[0], print_callback, &ca);
+
+    for(int i = 0; i < in.maxthreads; i++) {
+        TopK_destroy(&topk_heaps[i]);
+    }
+    free(topk_heaps);
+    topk_heaps = NULL;
+
+    return rc;
+}
+
 struct ThreadArgs {
     struct OutputBuffers output_buffers;
     int (*print_callback_func)(void*,int,char**,char**);
@@ -450,6 +849,81 @@ struct ThreadArgs {
     #endif
 };
 
+/* reallocate each thread's output buffer from the thread so that its pages are on the thread's NUMA node */
+static void numa_thread_init(struct QPTPool *ctx, const size_t id, void *args) {
+    (void) ctx;
+
+    struct OutputBuffer *ob = &((struct ThreadArgs *) args)->output_buffers.buffers[id];
+    char *buf = malloc(ob->capacity);
+    if (buf) {
+        memset(buf, 0, ob->capacity);
+        free(ob->buf);
+        ob->buf = buf;
+    }
+}
+
+/* --timeout: cancels the pool if the walk does not finish in time */
+struct Timeout {
+    pthread_mutex_t mutex;
+    pthread_cond_t cv;
+    int done;
+    int expired;
+    struct QPTPool * pool;
+    pthread_t thread;
+};
+
+static void * timeout_thread(void * args) {
+    struct Timeout * timeout = (struct Timeout *) args;
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += in.timeout;
+
+    pthread_mutex_lock(&timeout->mutex);
+    while (!timeout->done && !timeout->expired) {
+        timeout->expired = (pthread_cond_timedwait(&timeout->cv, &timeout->mutex, &deadline) == ETIMEDOUT);
+    }
+    const int expired = timeout->expired;
+    pthread_mutex_unlock(&timeout->mutex);
+
+    if (expired) {
+        QPTPool_cancel(timeout->pool);
+    }
+
+    return NULL;
+}
+
+static int timeout_start(struct Timeout * timeout, struct QPTPool * pool) {
+    pthread_mutex_init(&timeout->mutex, NULL);
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&timeout->cv, &attr);
+    pthread_condattr_destroy(&attr);
+
+    timeout->done = 0;
+    timeout->expired = 0;
+    timeout->pool = pool;
+
+    return pthread_create(&timeout->thread, NULL, timeout_thread, timeout);
+}
+
+/* returns whether or not the timeout expired */
+static int timeout_stop(struct Timeout * timeout) {
+    pthread_mutex_lock(&timeout->mutex);
+    timeout->done = 1;
+    pthread_cond_signal(&timeout->cv);
+    pthread_mutex_unlock(&timeout->mutex);
+
+    pthread_join(timeout->thread, NULL);
+
+    pthread_cond_destroy(&timeout->cv);
+    pthread_mutex_destroy(&timeout->mutex);
+
+    return timeout->expired;
+}
+
 #ifdef DEBUG
 #define init_start_end(name, zero)              \
     struct start_end name;                      \
@@ -459,7 +933,7 @@ struct ThreadArgs {
 
 /* wrapper wround sqlite3_exec to pass arguments and check for errors */
 #ifdef SQL_EXEC
-#define querydb(dbname, db, query, callback, obufs, id, ts_name, rc)    \
+#define querydb(ctx, dbname, db, query, callback, obufs, id, ts_name, rc) \
 do {                                                                    \
     struct CallbackArgs ca;                                             \
     ca.output_buffers = obufs;                                          \
@@ -469,110 +943,445 @@ do {                                                                    \
                                                                         \
     debug_start(ts_name);                                               \
     char *err = NULL;                                                   \
-    if (sqlite3_exec(db, query, callback, &ca, &err) != SQLITE_OK) {    \
+    if (!stopped(ctx) &&                                                \
+        (sqlite3_exec(db, query, callback, &ca, &err) != SQLITE_OK) &&  \
+        !stopped(ctx)) {                                                \
         fprintf(stderr, "Error: %s: %s: \"%s\"\n", err, dbname, query); \
-        sqlite3_free(err);                                              \
     }                                                                   \
+    sqlite3_free(err);                                                  \
     debug_end(ts_name);                                                 \
                                                                         \
     rc = ca.rows;                                                       \
 } while (0)
 #else
-#define querydb(dbname, db, query, callback, obufs, id, ts_name, rc)
+#define querydb(ctx, dbname, db, query, callback, obufs, id, ts_name, rc)
 #endif
 
-int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args) {
-    sqlite3 *db = NULL;
-    int recs;
-    char shortname[MAXPATH];
-    char endname[MAXPATH];
-    DIR * dir = NULL;
-
-    /* /\* Can probably skip this *\/ */
-    /* if (!data) { */
-    /*     return 1; */
-    /* } */
-
-    /* /\* Can probably skip this *\/ */
-    /* if (!ctx || (id >= ctx->size)) { */
-    /*     free(data); */
-    /*     return 1; */
-    /* } */
+/* attach an index database to an intermediate database as "tree" */
+static sqlite3 * attach_index(const char * dbname, sqlite3 * db) {
+    if (!in.mmap_size || (in.open_mode != RDONLY)) {
+        return attachdb(dbname, db, "tree", in.open_mode);
+    }
 
-    struct work * work = (struct work *) data;
-    const size_t work_name_len = strlen(work->name);
+    /* map the database and let SQLite read directly from the map */
+    char uri[MAXPATH];
+    if (!strncmp(dbname, "file:", 5)) {
+        SNFORMAT_S(uri, MAXPATH, 1, dbname, strlen(dbname));
+    }
+    else {
+        /* escape the characters that would end the path part of the URI */
+        size_t len = SNFORMAT_S(uri, MAXPATH, 1, "file:", (size_t) 5);
+        for(const char * c = dbname; *c && (len + 4 < MAXPATH); c++) {
+            if ((*c == '%') || (*c == '?') || (*c == '#')) {
+                len += snprintf(&uri[len], MAXPATH - len, "%%%02X", (unsigned char) *c);
+            }
+            else {
+                uri[len++] = *c;
+            }
+        }
 
-    /* /\* print directory *\/ */
-    /* if (in.printdir) { */
-    /*     struct ThreadArgs * ta = (struct ThreadArgs *) args; */
-    /*     struct CallbackArgs ca; */
-    /*     ca.output_buffers = &ta->output_buffers; */
-    /*     ca.id = id; */
-    /*     char * ptr = &(work->name[0]); */
-    /*     ta->print_callback_func(&ca, 1, &ptr, NULL); */
-    /* } */
+        if (!sqlite3_snprintf(MAXPATH - len, &uri[len], "?vfs=" GUFI_RO_MMAP_VFS "&mode=ro")) {
+            return NULL;
+        }
+    }
 
-    char dbname[MAXPATH];
-    SNFORMAT_S(dbname, MAXPATH, 2, work->name, work_name_len, "/" DBNAME, DBNAME_LEN + 1);
+    if (!attachdb(uri, db, "tree", RDONLY)) {
+        return NULL;
+    }
 
-    struct ThreadArgs * ta = (struct ThreadArgs *) args;
+    char pragma[MAXSQL];
+    sqlite3_snprintf(MAXSQL, pragma, "PRAGMA tree.mmap_size = %llu", (unsigned long long) in.mmap_size);
+    if (sqlite3_exec(db, pragma, NULL, NULL, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Could not set mmap size of %s\n", dbname);
+    }
 
-    #ifdef DEBUG
-    init_start_end(opendir_call, ta->start_time);
-    init_start_end(open_call, ta->start_time);
-    init_start_end(sqlite3_open_call, ta->start_time);
-    init_start_end(set_pragmas, ta->start_time);
-    init_start_end(load_extension, ta->start_time);
-    init_start_end(addqueryfuncs_call, ta->start_time);
-    init_start_end(descend_call, ta->start_time);
-    struct sll * descend_timers = descend_timers_init();
-    init_start_end(attach_call, ta->start_time);
-    init_start_end(sqltsumcheck, ta->start_time);
-    init_start_end(sqltsum, ta->start_time);
-    init_start_end(sqlsum, ta->start_time);
-    init_start_end(sqlent, ta->start_time);
-    init_start_end(detach_call, ta->start_time);
-    init_start_end(close_call, ta->start_time);
-    init_start_end(closedir_call, ta->start_time);
-    init_start_end(utime_call, ta->start_time);
-    init_start_end(free_work, ta->start_time);
+    return db;
+}
 
-    #endif
+/* a range of rowids of a large entries table, or a shard of a large */
+/* directory's entries, to query in another thread */
+struct EntriesRange {
+    char dbname[MAXPATH];
+    char shard[MAXPATH];                /* empty if the entries are in dbname */
+    char name[MAXPATH];
+    char *root;
+    size_t level;
+    sqlite3_int64 lo;                   /* first rowid */
+    sqlite3_int64 hi;                   /* one past the last rowid */
+};
 
-    /* keep opendir near opendb to help speed up sqlite3_open_v2 */
-    debug_start(opendir_call);
-    dir = opendir(work->name);
-    debug_end(opendir_call);
+/* run -E on a range of rowids of a directory's entries table, or on a shard */
+static int processrange(struct QPTPool * ctx, const size_t id, void * data, void * args) {
+    struct EntriesRange *range = (struct EntriesRange *) data;
+    struct ThreadArgs *ta = (struct ThreadArgs *) args;
 
-    /* if the directory can't be opened, don't bother with anything else */
-    if (!dir) {
-        /* fprintf(stderr, "Could not open directory %s: %d %s\n", work->name, errno, strerror(errno)); */
-        goto out_free;
+    if (stopped(ctx)) {
+        free(range);
+        return 0;
     }
 
-    #if OPENDB
-    debug_start(open_call);
+    sqlite3 *db = NULL;
     if (gts.outdbd[id]) {
-      /* if we have an out db then only have to attach the gufi db */
-      db = gts.outdbd[id];
-      if (!attachdb(dbname, db, "tree", in.open_mode)) {
-          goto close_dir;
-      }
+        db = attach_index(range->dbname, gts.outdbd[id]);
     }
     else {
-      /* otherwise, open a standalone database to query from */
-      db = opendb(dbname, in.open_mode, 1, 1,
-                  NULL, NULL
-                  #ifdef DEBUG
-                  , &sqlite3_open_call.start,  &sqlite3_open_call.end
-                  , &set_pragmas.start,        &set_pragmas.end
-                  , &load_extension.start,     &load_extension.end
-                  , NULL, NULL
-                  #endif
-                  );
+        db = opendb(range->dbname, in.open_mode, 1, 1, in.mmap_size,
+                    NULL, NULL
+                    #ifdef DEBUG
+                    , NULL, NULL
+                    , NULL, NULL
+                    , NULL, NULL
+                    , NULL, NULL
+                    #endif
+                    );
     }
-    debug_end(open_call);
-    #endif
+
+    if (!db) {
+        free(range);
+        return 1;
+    }
+
+    sqlite3 *outer_db = set_active_db(id, db);
+
+    /* the summary still comes from dbname */
+    if (range->shard[0] && !attachdb(range->shard, db, "shard", in.open_mode)) {
+        set_active_db(id, outer_db);
+        if (gts.outdbd[id]) {
+            detachdb(range->dbname, db, "tree");
+        }
+        else {
+            closedb(db);
+        }
+        free(range);
+        return 1;
+    }
+
+    #ifdef ADDQUERYFUNCS
+    addqueryfuncs(db, id, range->level, range->root);
+    #endif
+
+    /* set the paths the same way as the thread that split the directory did */
+    char shortname[MAXPATH];
+    char endname[MAXPATH];
+    shortpath(range->name, shortname, endname);
+    SNFORMAT_S(gps[id].gepath, MAXPATH, 1, endname, strlen(endname));
+    SNFORMAT_S(gps[id].gpath, MAXPATH, 1, range->name, strlen(range->name));
+    if (!realpath(range->name, gps[id].gfpath)) {
+        SNFORMAT_S(gps[id].gfpath, MAXPATH, 1, range->name, strlen(range->name));
+    }
+
+    char views[32][MAXSQL];
+    const size_t view_count = restrict_entries(db, range->shard[0]?"shard":gts.outdbd[id]?"tree":"main",
+                                               range->lo, range->hi, views, sizeof(views) / sizeof(views[0]));
+    if (view_count) {
+        struct CallbackArgs ca;
+        ca.output_buffers = &ta->output_buffers;
+        ca.id = id;
+        ca.rows = 0;
+
+        /* -Q only caches the rows of whole directories, so print these rows directly */
+        sqlite3_callback callback = ta->print_callback_func;
+        if (callback == cache_callback) {
+            callback = print_callback;
+        }
+
+        char *err = NULL;
+        if (!stopped(ctx) &&
+            (sqlite3_exec(db, in.sqlent, callback, &ca, &err) != SQLITE_OK) && !stopped(ctx)) {
+            fprintf(stderr, "Error: %s: %s: \"%s\"\n", err, range->dbname, in.sqlent);
+        }
+        sqlite3_free(err);
+    }
+    else {
+        fprintf(stderr, "Error: Could not split the entries of %s\n", range->dbname);
+    }
+
+    set_active_db(id, outer_db);
+
+    if (gts.outdbd[id]) {
+        /* the intermediate database is reused, so remove the views */
+        unrestrict_entries(db, views, view_count);
+        if (range->shard[0]) {
+            detachdb(range->shard, db, "shard");
+        }
+        detachdb(range->dbname, db, "tree");
+    }
+    else {
+        closedb(db);
+    }
+
+    free(range);
+    return !view_count;
+}
+
+/*
+ * If the entries table has more than in.split_entries rowids, push
+ * ranges of in.split_entries rowids onto the queue so that several
+ * threads query it at once.
+ *
+ * Returns 1 if the table was split, 0 if the caller should query it.
+ */
+static int split_entries(struct QPTPool * ctx, const size_t id, struct work * work,
+                         const char * dbname, sqlite3 * db) {
+    if (!in.split_entries) {
+        return 0;
+    }
+
+    char sql[MAXSQL];
+    SNPRINTF(sql, MAXSQL, "SELECT min(rowid), max(rowid) FROM %s;", gts.outdbd[id]?"tree.entries":"entries");
+
+    sqlite3_stmt *res = NULL;
+    sqlite3_int64 lo = 0;
+    sqlite3_int64 hi = 0;
+    int rc = 0;
+    if ((sqlite3_prepare_v2(db, sql, -1, &res, NULL) == SQLITE_OK) &&
+        (sqlite3_step(res) == SQLITE_ROW) &&
+        (sqlite3_column_type(res, 0) != SQLITE_NULL)) {
+        lo = sqlite3_column_int64(res, 0);
+        hi = sqlite3_column_int64(res, 1) + 1;
+        rc = ((sqlite3_uint64) (hi - lo) > in.split_entries);
+    }
+    sqlite3_finalize(res);
+
+    for(sqlite3_int64 start = lo; rc && (start < hi); start += in.split_entries) {
+        struct EntriesRange *range = malloc(sizeof(struct EntriesRange));
+        SNPRINTF(range->dbname, MAXPATH, "%s", dbname);
+        range->shard[0] = '\0';
+        SNPRINTF(range->name, MAXPATH, "%s", work->name);
+        range->root = work->root;
+        range->level = work->level;
+        range->lo = start;
+        range->hi = ((sqlite3_uint64) (hi - start) > in.split_entries)?(start + (sqlite3_int64) in.split_entries):hi;
+
+        /* finish directories that have been started before starting new ones */
+        QPTPool_enqueue_priority(ctx, id, QPTPOOL_PRIORITY_HIGH, processrange, range);
+    }
+
+    return rc;
+}
+
+/*
+ * Directories that were indexed with --shard-entries list the
+ * databases that hold the rest of their entries in the shards table.
+ * Push each of them onto the queue so that several threads query them
+ * at once.
+ *
+ * Returns the number of shards pushed onto the queue.
+ */
+static size_t query_shards(struct QPTPool * ctx, const size_t id, struct work * work,
+                           const char * dbname, sqlite3 * db) {
+    sqlite3_stmt *res = NULL;
+
+    /* indexes built without shards do not have the table */
+    if (sqlite3_prepare_v2(db, gts.outdbd[id]?"SELECT name FROM tree.shards;":"SELECT name FROM shards;",
+                           -1, &res, NULL) != SQLITE_OK) {
+        return 0;
+    }
+
+    /* enqueue after finalizing in case --max-queued processes the shards inline */
+    struct sll ranges;
+    sll_init(&ranges);
+
+    while (sqlite3_step(res) == SQLITE_ROW) {
+        const char *name = (const char *) sqlite3_column_text(res, 0);
+        if (!name) {
+            continue;
+        }
+
+        struct EntriesRange *range = malloc(sizeof(struct EntriesRange));
+        SNPRINTF(range->dbname, MAXPATH, "%s", dbname);
+        SNPRINTF(range->shard, MAXPATH, "%s/%s", work->name, name);
+        SNPRINTF(range->name, MAXPATH, "%s", work->name);
+        range->root = work->root;
+        range->level = work->level;
+        range->lo = 0;
+        range->hi = LLONG_MAX;
+
+        sll_push(&ranges, range);
+    }
+    sqlite3_finalize(res);
+
+    const size_t count = sll_get_size(&ranges);
+
+    struct EntriesRange *range = NULL;
+    while ((range = sll_pop(&ranges))) {
+        QPTPool_enqueue_priority(ctx, id, QPTPOOL_PRIORITY_HIGH, processrange, range);
+    }
+
+    return count;
+}
+
+int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args) {
+    sqlite3 *db = NULL;
+    sqlite3 *outer_db = NULL; /* restored after processing this directory inline */
+    int recs;
+    char shortname[MAXPATH];
+    char endname[MAXPATH];
+    DIR * dir = NULL;
+
+    /* /\* Can probably skip this *\/ */
+    /* if (!data) { */
+    /*     return 1; */
+    /* } */
+
+    /* /\* Can probably skip this *\/ */
+    /* if (!ctx || (id >= ctx->size)) { */
+    /*     free(data); */
+    /*     return 1; */
+    /* } */
+
+    struct work * work = (struct work *) data;
+    const size_t work_name_len = strlen(work->name);
+
+    /* /\* print directory *\/ */
+    /* if (in.printdir) { */
+    /*     struct ThreadArgs * ta = (struct ThreadArgs *) args; */
+    /*     struct CallbackArgs ca; */
+    /*     ca.output_buffers = &ta->output_buffers; */
+    /*     ca.id = id; */
+    /*     char * ptr = &(work->name[0]); */
+    /*     ta->print_callback_func(&ca, 1, &ptr, NULL); */
+    /* } */
+
+    /* directories in packed indexes are not on the filesystem */
+    struct PackedIndex * packed = (struct PackedIndex *) work->index;
+
+    char dbname[MAXPATH];
+    if (packed) {
+        /* not every directory has a database */
+        if (PackedIndex_dbname(packed, id, work->tocid, dbname, MAXPATH) != 0) {
+            dbname[0] = '\0';
+        }
+    }
+    else {
+        SNFORMAT_S(dbname, MAXPATH, 2, work->name, work_name_len, "/" DBNAME, DBNAME_LEN + 1);
+    }
+
+    struct ThreadArgs * ta = (struct ThreadArgs *) args;
+
+    /* directories whose databases have not changed are served from the result cache */
+    struct ResultCache * cache = NULL;
+    uint64_t cache_key = 0;
+    struct stat dbst;
+    int cached = 0;
+    int descended = 0;
+    size_t sharded = 0;
+    if (result_caches && !packed && (lstat(dbname, &dbst) == 0)) {
+        cache = &result_caches[id];
+        cache_key = ResultCache_hash(result_cache_query, work->root, strlen(work->root));
+        cached = ResultCache_get(cache, cache_key, work->name, &dbst, &descended);
+    }
+
+    #ifdef DEBUG
+    init_start_end(opendir_call, ta->start_time);
+    init_start_end(open_call, ta->start_time);
+    init_start_end(sqlite3_open_call, ta->start_time);
+    init_start_end(set_pragmas, ta->start_time);
+    init_start_end(load_extension, ta->start_time);
+    init_start_end(addqueryfuncs_call, ta->start_time);
+    init_start_end(descend_call, ta->start_time);
+    struct sll * descend_timers = descend_timers_init();
+    init_start_end(attach_call, ta->start_time);
+    init_start_end(sqltsumcheck, ta->start_time);
+    init_start_end(sqltsum, ta->start_time);
+    init_start_end(sqlsum, ta->start_time);
+    init_start_end(sqlent, ta->start_time);
+    init_start_end(detach_call, ta->start_time);
+    init_start_end(close_call, ta->start_time);
+    init_start_end(closedir_call, ta->start_time);
+    init_start_end(utime_call, ta->start_time);
+    init_start_end(free_work, ta->start_time);
+
+    /* I/O done by the read-only VFS on behalf of this directory's database */
+    struct gufi_vfs_stats vfs_stats;
+    vfs_stats.bytes = 0;
+    vfs_stats.syscalls = 0;
+
+    /* whether or not -k skipped the entries table */
+    size_t topk_pruned = 0;
+
+    #ifdef CUMULATIVE_TIMES
+    /* whether or not -X skipped this subtree or the entries table */
+    size_t range_pruned_subtree = 0;
+    size_t range_pruned_entries = 0;
+    #endif
+
+    #ifdef CUMULATIVE_TIMES
+    /* whether or not the uid and gid filters skipped this subtree */
+    size_t owner_pruned_subtree = 0;
+    #endif
+    #endif
+
+    /* once --max-results rows have been printed, empty the queue without doing any work */
+    if (stopped(ctx)) {
+        goto out_free;
+    }
+
+    if (cached) {
+        cache_print(&ta->output_buffers, id, cache);
+
+        /* the database is not opened, so always read the directory */
+        if (descended) {
+            debug_start(descend_call);
+            debug_start(opendir_call);
+            dir = opendir(work->name);
+            debug_end(opendir_call);
+
+            if (dir) {
+                descend2(ctx, id, work, dir, processdir, in.max_level
+                         #ifdef DEBUG
+                         , descend_timers
+                         #endif
+                    );
+            }
+            debug_end(descend_call);
+        }
+
+        goto close_dir;
+    }
+
+    /* the subdirs table replaces readdir, so the directory is only opened if the table can't be used */
+    if (!in.read_subdirs && !packed) {
+        /* keep opendir near opendb to help speed up sqlite3_open_v2 */
+        debug_start(opendir_call);
+        dir = opendir(work->name);
+        debug_end(opendir_call);
+
+        /* if the directory can't be opened, don't bother with anything else */
+        if (!dir) {
+            /* fprintf(stderr, "Could not open directory %s: %d %s\n", work->name, errno, strerror(errno)); */
+            goto out_free;
+        }
+    }
+
+    #if OPENDB
+    debug_start(open_call);
+    if (!dbname[0]) {
+      /* nothing to open */
+    }
+    else if (gts.outdbd[id]) {
+      /* if we have an out db then only have to attach the gufi db */
+      db = gts.outdbd[id];
+      if (!attach_index(dbname, db)) {
+          goto close_dir;
+      }
+    }
+    else {
+      /* otherwise, open a standalone database to query from */
+      db = opendb(dbname, in.open_mode, 1, 1, in.mmap_size,
+                  NULL, NULL
+                  #ifdef DEBUG
+                  , &sqlite3_open_call.start,  &sqlite3_open_call.end
+                  , &set_pragmas.start,        &set_pragmas.end
+                  , &load_extension.start,     &load_extension.end
+                  , NULL, NULL
+                  #endif
+                  );
+    }
+    debug_end(open_call);
+
+    outer_db = set_active_db(id, db);
+    #endif
 
     #ifdef ADDQUERYFUNCS
     debug_start(addqueryfuncs_call);
@@ -591,8 +1400,9 @@ int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args)
     if (in.sqltsum_len > 1) {
         if (in.andor == 0) {      /* AND */
             /* make sure the treesummary table exists */
-            querydb(dbname, db, "select name from sqlite_master where type=\'table\' and name='treesummary';",
-                    ta->print_callback_func, NULL,
+            /* (rows are not counted when aggregating, so -T is skipped) */
+            querydb(ctx, dbname, db, "select name from sqlite_master where type=\'table\' and name='treesummary';",
+                    ta->print_callback_func?count_callback:NULL, NULL,
                     id, sqltsumcheck, recs);
 
             if (recs < 1) {
@@ -600,7 +1410,7 @@ int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args)
             }
             else {
                 /* run in.sqltsum */
-                querydb(dbname, db, in.sqltsum,
+                querydb(ctx, dbname, db, in.sqltsum,
                         ta->print_callback_func, &ta->output_buffers,
                         id, sqltsum, recs);
             }
@@ -612,20 +1422,54 @@ int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args)
         recs=1;
       }
     }
+
+    /* nothing under this directory can match, so neither query nor descend */
+    if ((recs > 0) && range_prune(db, range_prune_tsum)) {
+        recs = 0;
+        #if defined(DEBUG) && defined(CUMULATIVE_TIMES)
+        range_pruned_subtree = 1;
+        #endif
+    }
+
+    /* the treesummary ranges can't rule out a single owner, but the filters usually can */
+    if ((recs > 0) && owner_prune(db)) {
+        recs = 0;
+        #if defined(DEBUG) && defined(CUMULATIVE_TIMES)
+        owner_pruned_subtree = 1;
+        #endif
+    }
+
     /* so we have to go on and query summary and entries possibly */
     if (recs > 0) {
+        descended = 1;
+
         debug_start(descend_call);
-        #ifdef DEBUG
-        #ifdef SUBDIRECTORY_COUNTS
-        const size_t pushed =
-        #endif
-        #endif
+        size_t pushed = 0;
         /* push subdirectories into the queue */
-        descend2(ctx, id, work, dir, processdir, in.max_level
-                 #ifdef DEBUG
-                 , descend_timers
-                 #endif
-            );
+        if (stopped(ctx)) {
+            /* --max-results rows have been printed or --timeout expired, so stop adding work */
+        }
+        else if (packed) {
+            pushed = PackedIndex_descend(packed, id, ctx, work, processdir, in.max_level);
+        }
+        else if (!in.read_subdirs ||
+            descend_subdirs(ctx, id, work, db, gts.outdbd[id]?"tree.subdirs":"subdirs",
+                            processdir, in.max_level, &pushed)) {
+            /* the subdirs table is not available, so read the directory */
+            if (!dir) {
+                debug_start(opendir_call);
+                dir = opendir(work->name);
+                debug_end(opendir_call);
+            }
+
+            if (dir) {
+                pushed = descend2(ctx, id, work, dir, processdir, in.max_level
+                                  #ifdef DEBUG
+                                  , descend_timers
+                                  #endif
+                    );
+            }
+        }
         debug_end(descend_call);
 
         #ifdef DEBUG
@@ -650,9 +1494,11 @@ int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args)
                     /* put in the path relative to the user's input */
                     SNFORMAT_S(gps[id].gpath, MAXPATH, 1, work->name, work_name_len);
                     /* printf("processdir: setting gpath = %s and gepath %s\n",gps[mytid].gpath,gps[mytid].gepath); */
-                    realpath(work->name,gps[id].gfpath);
+                    if (!realpath(work->name,gps[id].gfpath)) {
+                        SNFORMAT_S(gps[id].gfpath, MAXPATH, 1, work->name, work_name_len);
+                    }
 
-                    querydb(dbname, db, in.sqlsum,
+                    querydb(ctx, dbname, db, in.sqlsum,
                             ta->print_callback_func, &ta->output_buffers,
                             id, sqlsum, recs);
                 } else {
@@ -664,26 +1510,66 @@ int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args)
 
                 /* if we have recs (or are running an OR) query the entries table */
                 if (recs > 0) {
-                    if (in.sqlent_len > 1) {
+                    /* skip the entries if none of them can be in the top k */
+                    int pruned = topk_prune(db, id);
+                    #ifdef DEBUG
+                    topk_pruned += pruned;
+                    #endif
+
+                    /* or if none of them can satisfy -X */
+                    if (!pruned && range_prune(db, range_prune_sum)) {
+                        pruned = 1;
+                        #if defined(DEBUG) && defined(CUMULATIVE_TIMES)
+                        range_pruned_entries = 1;
+                        #endif
+                    }
+
+                    if ((in.sqlent_len > 1) && !pruned) {
                         /* set the path so users can put path() in their queries */
                         /* printf("****entries len of in.sqlent %lu\n",strlen(in.sqlent)); */
                         SNFORMAT_S(gps[id].gpath, MAXPATH, 1, work->name, work_name_len);
-                        realpath(work->name,gps[id].gfpath);
-
-                        querydb(dbname, db, in.sqlent,
-                                ta->print_callback_func, &ta->output_buffers,
-                                id, sqlent, recs); /* recs is not used */
+                        if (!realpath(work->name,gps[id].gfpath)) {
+                            SNFORMAT_S(gps[id].gfpath, MAXPATH, 1, work->name, work_name_len);
+                        }
+
+                        /* start paging in the entries table before scanning it */
+                        if (in.mmap_size) {
+                            gufi_vfs_willneed(db, gts.outdbd[id]?"tree":"main");
+                        }
+
+                        /* very large tables are split across threads */
+                        if (packed || !split_entries(ctx, id, work, dbname, db)) {
+                            querydb(ctx, dbname, db, in.sqlent,
+                                    ta->print_callback_func, &ta->output_buffers,
+                                    id, sqlent, recs); /* recs is not used */
+                        }
+
+                        /* the rest of the entries of very large directories are in other databases */
+                        if (!packed) {
+                            sharded = query_shards(ctx, id, work, dbname, db);
+                        }
                     }
                 }
             }
         }
     }
 
+    #ifdef DEBUG
+    /* the database file goes away when it is detached/closed, so collect its I/O counts now */
+    if (db) {
+        gufi_vfs_stats(db, gts.outdbd[id]?"tree":"main", &vfs_stats);
+    }
+    #endif
+
     #ifdef OPENDB
+    set_active_db(id, outer_db);
+
     debug_start(close_call);
     /* if we have an out db we just detach gufi db */
     if (gts.outdbd[id]) {
-      detachdb(dbname, db, "tree");
+      if (db) {
+          detachdb(dbname, db, "tree");
+      }
     } else {
       closedb(db);
     }
@@ -692,12 +1578,14 @@ int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args)
 
   close_dir:
     debug_start(closedir_call);
-    closedir(dir);
+    if (dir) {
+        closedir(dir);
+    }
     debug_end(closedir_call);
 
     debug_start(utime_call);
     /* restore mtime and atime */
-    if (in.keep_matime) {
+    if (in.keep_matime && !packed && !cached) {
         struct utimbuf dbtime = {};
         dbtime.actime  = work->statuso.st_atime;
         dbtime.modtime = work->statuso.st_mtime;
@@ -705,6 +1593,18 @@ int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args)
     }
     debug_end(utime_call);
 
+    /* print the rows of this directory and cache them for the next run */
+    /* (after restoring the times, which changes the ctime of the database) */
+    if (cache && !cached) {
+        cache_print(&ta->output_buffers, id, cache);
+
+        /* db is still set if the database was opened */
+        /* (the rows of the shards were printed by other threads) */
+        if (db && !sharded && (lstat(dbname, &dbst) == 0)) {
+            ResultCache_put(cache, cache_key, work->name, &dbst, descended);
+        }
+    }
+
   out_free:
     ;
 
@@ -720,7 +1620,7 @@ int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args)
     char buf[4096];
     const size_t size = sizeof(buf);
     print_timer(         &debug_output_buffers, id, buf, size, "opendir",         &opendir_call);
-    if (dir) {
+    if (dir || in.read_subdirs) {
         print_timer(     &debug_output_buffers, id, buf, size, "opendb",          &open_call);
         if (db) {
             print_timer (&debug_output_buffers, id, buf, size, "sqlite3_open_v2", &sqlite3_open_call);
@@ -744,6 +1644,7 @@ int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args)
             print_timers(&debug_output_buffers, id, buf, size, "access",          &descend_timers[dt_access_call]);
             print_timers(&debug_output_buffers, id, buf, size, "set",             &descend_timers[dt_set]);
             print_timers(&debug_output_buffers, id, buf, size, "clone",           &descend_timers[dt_make_clone]);
+            print_timers(&debug_output_buffers, id, buf, size, "prefetch",        &descend_timers[dt_prefetch_call]);
             print_timers(&debug_output_buffers, id, buf, size, "pushdir",         &descend_timers[dt_pushdir]);
             print_timer (&debug_output_buffers, id, buf, size, "attach",          &attach_call);
             print_timer (&debug_output_buffers, id, buf, size, "sqltsumcheck",    &sqltsumcheck);
@@ -752,6 +1653,8 @@ int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args)
             print_timer (&debug_output_buffers, id, buf, size, "sqlent",          &sqlent);
             print_timer (&debug_output_buffers, id, buf, size, "detach",          &detach_call);
             print_timer (&debug_output_buffers, id, buf, size, "closedb",         &close_call);
+            print_counter(&debug_output_buffers, id, buf, size, "vfs_bytes",      vfs_stats.bytes);
+            print_counter(&debug_output_buffers, id, buf, size, "vfs_syscalls",   vfs_stats.syscalls);
         }
         print_timer(     &debug_output_buffers, id, buf, size, "closedir",        &closedir_call);
         print_timer(     &debug_output_buffers, id, buf, size, "utime",           &utime_call);
@@ -785,6 +1688,7 @@ int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args)
     total_access_time            += buffer_sum(&descend_timers[dt_access_call]);
     total_set_time               += buffer_sum(&descend_timers[dt_set]);
     total_clone_time             += buffer_sum(&descend_timers[dt_make_clone]);
+    total_prefetch_time          += buffer_sum(&descend_timers[dt_prefetch_call]);
     total_pushdir_time           += buffer_sum(&descend_timers[dt_pushdir]);
     total_closedir_time          += elapsed(&closedir_call);
     total_attach_time            += elapsed(&attach_call);
@@ -797,6 +1701,12 @@ int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args)
     total_utime_time             += elapsed(&utime_call);
     total_free_work_time         += elapsed(&free_work);
     total_output_timestamps_time += elapsed(&output_timestamps);
+    total_vfs_bytes              += vfs_stats.bytes;
+    total_vfs_syscalls           += vfs_stats.syscalls;
+    total_topk_pruned            += topk_pruned;
+    total_range_pruned_subtrees  += range_pruned_subtree;
+    total_range_pruned_entries   += range_pruned_entries;
+    total_owner_pruned_subtrees  += owner_pruned_subtree;
     pthread_mutex_unlock(&print_mutex);
     #endif
 
@@ -811,6 +1721,34 @@ int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args)
     return 0;
 }
 
+/* create an aggregate database using -K (or -I if -K was not provided) */
+static sqlite3 *aggregate_create(const char *aggregate_name) {
+    sqlite3 *aggregate = NULL;
+    if (!(aggregate = opendb(aggregate_name, RDWR, 1, 1, 0, NULL, NULL
+                             #ifdef DEBUG
+                             , NULL, NULL
+                             , NULL, NULL
+                             , NULL, NULL
+                             , NULL, NULL
+                             #endif
+              ))) {
+        fprintf(stderr, "Could not open %s\n", aggregate_name);
+        closedb(aggregate);
+        return NULL;
+    }
+
+    addqueryfuncs(aggregate, in.maxthreads, -1, NULL);
+
+    // create table
+    if (sqlite3_exec(aggregate, strlen(in.create_aggregate)?in.create_aggregate:in.sqlinit, NULL, NULL, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Could not run SQL Init \"%s\" on %s\n", in.sqlinit, aggregate_name);
+        closedb(aggregate);
+        return NULL;
+    }
+
+    return aggregate;
+}
+
 /* create aggregate database and intermediate per-thread databases
  * the user must create the intermediate table with -I and insert into it
  * the per-thread databases reuse outdb array
@@ -820,7 +1758,7 @@ static sqlite3 *aggregate_init(const char *AGGREGATE_NAME_TEMPLATE,
     for(int i = 0; i < in.maxthreads; i++) {
         char intermediate_name[MAXSQL];
         SNPRINTF(intermediate_name, MAXSQL, AGGREGATE_NAME, (int) i);
-        if (!(gts.outdbd[i] = opendb(intermediate_name, RDWR, 1, 1, NULL, NULL
+        if (!(gts.outdbd[i] = opendb(intermediate_name, RDWR, 1, 1, 0, NULL, NULL
                                      #ifdef DEBUG
                                      , NULL, NULL
                                      , NULL, NULL
@@ -844,32 +1782,424 @@ static sqlite3 *aggregate_init(const char *AGGREGATE_NAME_TEMPLATE,
     }
 
     SNPRINTF(aggregate_name, MAXSQL, AGGREGATE_NAME, (int) -1);
-    sqlite3 *aggregate = NULL;
-    if (!(aggregate = opendb(aggregate_name, RDWR, 1, 1, NULL, NULL
-                             #ifdef DEBUG
-                             , NULL, NULL
-                             , NULL, NULL
-                             , NULL, NULL
-                             , NULL, NULL
-                             #endif
-              ))) {
-        fprintf(stderr, "Could not open %s\n", aggregate_name);
+    sqlite3 *aggregate = aggregate_create(aggregate_name);
+    if (!aggregate) {
         outdbs_fin(gts.outdbd, in.maxthreads, NULL, 0);
-        closedb(aggregate);
         return NULL;
     }
 
-    addqueryfuncs(aggregate, in.maxthreads, -1, NULL);
+    return aggregate;
+}
 
-    // create table
-    if (sqlite3_exec(aggregate, strlen(in.create_aggregate)?in.create_aggregate:in.sqlinit, NULL, NULL, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Could not run SQL Init \"%s\" on %s\n", in.sqlinit, aggregate_name);
-        outdbs_fin(gts.outdbd, in.maxthreads, NULL, 0);
-        closedb(aggregate);
-        return NULL;
+/*
+ * The bundled SQLite is built with SQLITE_THREADSAFE=0, so nothing
+ * protects the list of shared-cache databases that is searched and
+ * modified whenever an in-memory aggregate database is opened,
+ * attached, detached, or closed. Worker threads hold this lock while
+ * doing any of those. Each shared-cache database is otherwise only
+ * ever used by one thread at a time.
+ */
+static pthread_mutex_t shared_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* run a query that returns one integer */
+static int query_count(sqlite3 *db, const char *sql, size_t *count) {
+    sqlite3_stmt *res = NULL;
+    if (sqlite3_prepare_v2(db, sql, -1, &res, NULL) != SQLITE_OK) {
+        return 1;
     }
 
-    return aggregate;
+    const int rc = (sqlite3_step(res) != SQLITE_ROW);
+    if (!rc) {
+        *count = (size_t) sqlite3_column_int64(res, 0);
+    }
+
+    sqlite3_finalize(res);
+
+    return rc;
+}
+
+/*
+ * Running -J on each intermediate database into its own copy of the
+ * -K tables and then appending the copies together only gives the
+ * same result as running -J on every intermediate database against
+ * the same aggregate database when
+ *     - the -K tables start empty and have no primary keys, unique
+ *       indexes, or triggers, so appended rows cannot collide
+ *     - -J only inserts into the aggregate tables and does not read,
+ *       update, or delete from them
+ * Otherwise, -J is run on one intermediate database at a time.
+ */
+static int aggregate_tables_appendable(sqlite3 *aggregate) {
+    static const char LIST[] = "SELECT name FROM sqlite_master WHERE (type == 'table') AND (name NOT LIKE 'sqlite_%');";
+    static const char TRIGGERS[] = "SELECT COUNT(*) FROM sqlite_master WHERE type == 'trigger';";
+
+    size_t triggers = 1;
+    if ((query_count(aggregate, TRIGGERS, &triggers) != 0) ||
+        (triggers != 0)) {
+        return 0;
+    }
+
+    sqlite3_stmt *res = NULL;
+    if (sqlite3_prepare_v2(aggregate, LIST, -1, &res, NULL) != SQLITE_OK) {
+        return 0;
+    }
+
+    int appendable = 1;
+    while (appendable && (sqlite3_step(res) == SQLITE_ROW)) {
+        const char *table = (const char *) sqlite3_column_text(res, 0);
+
+        char sql[MAXSQL];
+        sqlite3_snprintf(MAXSQL, sql,
+                         "SELECT (SELECT COUNT(*) FROM pragma_table_info(%Q) WHERE pk > 0) + "
+                         "(SELECT COUNT(*) FROM pragma_index_list(%Q) WHERE \"unique\") + "
+                         "(SELECT COUNT(*) FROM (SELECT 1 FROM \"%w\" LIMIT 1));",
+                         table, table, table);
+
+        size_t conflicts = 1;
+        if ((query_count(aggregate, sql, &conflicts) != 0) ||
+            (conflicts != 0)) {
+            appendable = 0;
+        }
+    }
+
+    sqlite3_finalize(res);
+
+    return appendable;
+}
+
+/* reject anything in -J that touches the aggregate tables other than inserting into them */
+static int insert_only(void *args, int action, const char *arg1, const char *arg2,
+                       const char *dbname, const char *trigger) {
+    (void) arg1; (void) arg2; (void) trigger;
+
+    int *insert_only = (int *) args;
+
+    if (dbname && (strcmp(dbname, AGGREGATE_ATTACH_NAME) == 0)) {
+        switch (action) {
+            case SQLITE_INSERT:
+                break;
+            case SQLITE_READ:
+            case SQLITE_UPDATE:
+            case SQLITE_DELETE:
+            default:
+                *insert_only = 0;
+                break;
+        }
+    }
+
+    return SQLITE_OK;
+}
+
+static int intermediate_appends(sqlite3 *intermediate, const char *aggregate_name) {
+    if (!attachdb(aggregate_name, intermediate, AGGREGATE_ATTACH_NAME, RDWR)) {
+        return 0;
+    }
+
+    int appends = 1;
+    sqlite3_set_authorizer(intermediate, insert_only, &appends);
+
+    /* prepare every statement in -J without running any of them */
+    const char *sql = in.intermediate;
+    while (appends && sql && *sql) {
+        sqlite3_stmt *stmt = NULL;
+        const char *tail = NULL;
+        if (sqlite3_prepare_v2(intermediate, sql, -1, &stmt, &tail) != SQLITE_OK) {
+            appends = 0;
+        }
+        sqlite3_finalize(stmt);
+        sql = tail;
+    }
+
+    sqlite3_set_authorizer(intermediate, NULL, NULL);
+
+    detachdb(aggregate_name, intermediate, AGGREGATE_ATTACH_NAME);
+
+    return appends;
+}
+
+static int aggregate_in_parallel(sqlite3 *aggregate, const char *aggregate_name) {
+    return (in.maxthreads > 1) &&
+        aggregate_tables_appendable(aggregate) &&
+        intermediate_appends(gts.outdbd[0], aggregate_name);
+}
+
+/* run -J on each intermediate database, one at a time */
+static int aggregate_sequential(const char *aggregate_name) {
+    int rc = 0;
+    for(int i = 0; i < in.maxthreads; i++) {
+        if (!attachdb(aggregate_name, gts.outdbd[i], AGGREGATE_ATTACH_NAME, RDWR)         ||
+            (sqlite3_exec(gts.outdbd[i], in.intermediate, NULL, NULL, NULL) != SQLITE_OK)) {
+            fprintf(stderr, "Aggregation of intermediate databases error: %s\n", sqlite3_errmsg(gts.outdbd[i]));
+            rc = 1;
+        }
+    }
+
+    return rc;
+}
+
+/*
+ * Each intermediate database is aggregated into its own aggregate
+ * database in parallel. As soon as both halves of a pair of
+ * neighboring ranges of aggregate databases are done, the second is
+ * appended to the first in the same thread pool, until only dbs[0],
+ * the aggregate database created by aggregate_init, remains.
+ */
+struct Partials {
+    pthread_mutex_t mutex;
+    sqlite3 **dbs;
+    char (*names)[MAXSQL];
+    size_t *ids;
+    size_t *width;  /* dbs[i] holds the rows of the width databases starting at i; 0 if not done yet */
+    size_t count;
+    size_t failed;  /* number of databases whose rows were lost */
+};
+
+static int partials_init(struct Partials *partials, sqlite3 *aggregate, const char *aggregate_name, const size_t count) {
+    partials->dbs   = calloc(count, sizeof(sqlite3 *));
+    partials->names = calloc(count, sizeof(*partials->names));
+    partials->ids   = calloc(count, sizeof(size_t));
+    partials->width = calloc(count, sizeof(size_t));
+    partials->count = count;
+    partials->failed = 0;
+
+    if (!partials->dbs || !partials->names || !partials->ids || !partials->width) {
+        free(partials->width);
+        free(partials->ids);
+        free(partials->names);
+        free(partials->dbs);
+        return 1;
+    }
+
+    pthread_mutex_init(&partials->mutex, NULL);
+
+    for(size_t i = 0; i < count; i++) {
+        partials->ids[i] = i;
+    }
+
+    partials->dbs[0] = aggregate;
+    SNFORMAT_S(partials->names[0], MAXSQL, 1, aggregate_name, strlen(aggregate_name));
+
+    return 0;
+}
+
+static void partials_fin(struct Partials *partials) {
+    /* dbs[0] belongs to the caller */
+    for(size_t i = 1; i < partials->count; i++) {
+        if (partials->dbs[i]) {
+            closedb(partials->dbs[i]);
+        }
+    }
+
+    pthread_mutex_destroy(&partials->mutex);
+    free(partials->width);
+    free(partials->ids);
+    free(partials->names);
+    free(partials->dbs);
+}
+
+static int merge_partials(struct QPTPool *ctx, const size_t id, void *data, void *args);
+
+/*
+ * dbs[i] now holds the rows of the width databases starting at i
+ *
+ * if the neighboring range it pairs with is also done, enqueue the
+ * merge of the two ranges; a range without a neighbor moves up a
+ * level on its own
+ */
+static void partial_done(struct QPTPool *ctx, const size_t id, struct Partials *partials,
+                         const size_t i, size_t width) {
+    pthread_mutex_lock(&partials->mutex);
+    while (width < partials->count) {
+        const size_t base = i & ~((width << 1) - 1);
+        const size_t other = (base == i)?(i + width):base;
+
+        if (other >= partials->count) {
+            width <<= 1;
+            continue;
+        }
+
+        partials->width[i] = width;
+        if (partials->width[other] == width) {
+            partials->width[base + width] = 0;
+            QPTPool_enqueue(ctx, id, merge_partials, &partials->ids[base]);
+        }
+
+        break;
+    }
+    pthread_mutex_unlock(&partials->mutex);
+}
+
+/* run -J on one intermediate database */
+static int aggregate_intermediate(struct QPTPool *ctx, const size_t id, void *data, void *args) {
+    struct Partials *partials = (struct Partials *) args;
+    const size_t i = * (size_t *) data;
+
+    if (i) {
+        SNPRINTF(partials->names[i], MAXSQL, AGGREGATE_NAME, -1 - (int) i);
+        pthread_mutex_lock(&shared_cache_mutex);
+        partials->dbs[i] = aggregate_create(partials->names[i]);
+        pthread_mutex_unlock(&shared_cache_mutex);
+    }
+
+    pthread_mutex_lock(&shared_cache_mutex);
+    sqlite3 *attached = partials->dbs[i]?attachdb(partials->names[i], gts.outdbd[i], AGGREGATE_ATTACH_NAME, RDWR):NULL;
+    pthread_mutex_unlock(&shared_cache_mutex);
+
+    if (attached) {
+        if (sqlite3_exec(gts.outdbd[i], in.intermediate, NULL, NULL, NULL) != SQLITE_OK) {
+            fprintf(stderr, "Aggregation of intermediate databases error: %s\n", sqlite3_errmsg(gts.outdbd[i]));
+            __atomic_add_fetch(&partials->failed, 1, __ATOMIC_RELAXED);
+        }
+
+        pthread_mutex_lock(&shared_cache_mutex);
+        detachdb(partials->names[i], gts.outdbd[i], AGGREGATE_ATTACH_NAME);
+        pthread_mutex_unlock(&shared_cache_mutex);
+    }
+    else {
+        __atomic_add_fetch(&partials->failed, 1, __ATOMIC_RELAXED);
+    }
+
+    partial_done(ctx, id, partials, i, 1);
+
+    return 0;
+}
+
+/* append one table in the attached partial database to the same table in the main database */
+static int merge_table(sqlite3 *dst, const char *table, const char *create) {
+    /* the table might not have been created in main */
+    size_t exists = 0;
+    char sql[MAXSQL];
+    sqlite3_snprintf(MAXSQL, sql, "SELECT COUNT(*) FROM main.sqlite_master WHERE (type == 'table') AND (name == %Q);", table);
+    if (query_count(dst, sql, &exists) != 0) {
+        return 1;
+    }
+
+    if (!exists && (sqlite3_exec(dst, create, NULL, NULL, NULL) != SQLITE_OK)) {
+        return 1;
+    }
+
+    /* copy by column name in case the columns are in different orders */
+    char *columns = NULL;
+    sqlite3_snprintf(MAXSQL, sql, "SELECT group_concat('\"' || replace(name, '\"', '\"\"') || '\"', ', ') FROM pragma_table_info(%Q, 'partial');", table);
+    sqlite3_stmt *res = NULL;
+    if (sqlite3_prepare_v2(dst, sql, -1, &res, NULL) != SQLITE_OK) {
+        return 1;
+    }
+
+    int rc = 1;
+    if ((sqlite3_step(res) == SQLITE_ROW) &&
+        (columns = (char *) sqlite3_column_text(res, 0))) {
+        char *insert = sqlite3_mprintf("INSERT INTO main.\"%w\" (%s) SELECT %s FROM partial.\"%w\";",
+                                       table, columns, columns, table);
+        rc = (!insert || (sqlite3_exec(dst, insert, NULL, NULL, NULL) != SQLITE_OK));
+        sqlite3_free(insert);
+    }
+
+    sqlite3_finalize(res);
+
+    return rc;
+}
+
+/* append every table in dbs[i + width] to the same table in dbs[i] */
+static int merge_partials(struct QPTPool *ctx, const size_t id, void *data, void *args) {
+    struct Partials *partials = (struct Partials *) args;
+    const size_t i = * (size_t *) data;
+
+    pthread_mutex_lock(&partials->mutex);
+    const size_t width = partials->width[i];
+    pthread_mutex_unlock(&partials->mutex);
+
+    const size_t j = i + width;
+
+    /* the destination could not be created, so the source takes its place */
+    if (!partials->dbs[i]) {
+        partials->dbs[i] = partials->dbs[j];
+        partials->dbs[j] = NULL;
+        SNFORMAT_S(partials->names[i], MAXSQL, 1, partials->names[j], strlen(partials->names[j]));
+    }
+    else if (partials->dbs[j]) {
+        sqlite3 *dst = partials->dbs[i];
+
+        pthread_mutex_lock(&shared_cache_mutex);
+        sqlite3 *attached = attachdb(partials->names[j], dst, "partial", RDWR);
+        pthread_mutex_unlock(&shared_cache_mutex);
+
+        if (attached) {
+            sqlite3_stmt *res = NULL;
+            if (sqlite3_prepare_v2(dst, "SELECT name, sql FROM partial.sqlite_master WHERE (type == 'table') AND (name NOT LIKE 'sqlite_%');", -1, &res, NULL) == SQLITE_OK) {
+                while (sqlite3_step(res) == SQLITE_ROW) {
+                    const char *table  = (const char *) sqlite3_column_text(res, 0);
+                    const char *create = (const char *) sqlite3_column_text(res, 1);
+
+                    if (merge_table(dst, table, create) != 0) {
+                        fprintf(stderr, "Could not merge aggregated table %s: %s\n", table, sqlite3_errmsg(dst));
+                        __atomic_add_fetch(&partials->failed, 1, __ATOMIC_RELAXED);
+                    }
+                }
+            }
+            else {
+                fprintf(stderr, "Could not list aggregated tables: %s\n", sqlite3_errmsg(dst));
+                __atomic_add_fetch(&partials->failed, 1, __ATOMIC_RELAXED);
+            }
+            sqlite3_finalize(res);
+
+            pthread_mutex_lock(&shared_cache_mutex);
+            detachdb(partials->names[j], dst, "partial");
+            pthread_mutex_unlock(&shared_cache_mutex);
+        }
+        else {
+            __atomic_add_fetch(&partials->failed, 1, __ATOMIC_RELAXED);
+        }
+
+        pthread_mutex_lock(&shared_cache_mutex);
+        closedb(partials->dbs[j]);
+        pthread_mutex_unlock(&shared_cache_mutex);
+        partials->dbs[j] = NULL;
+    }
+
+    partial_done(ctx, id, partials, i, width << 1);
+
+    return 0;
+}
+
+/*
+ * aggregate every intermediate database at the same time and merge
+ * the results using one thread pool
+ *
+ * QPTPool discards the return values of the thread functions, so
+ * failures are counted in partials->failed
+ */
+static int aggregate_parallel(sqlite3 *aggregate, const char *aggregate_name) {
+    struct Partials partials;
+    if (partials_init(&partials, aggregate, aggregate_name, in.maxthreads) != 0) {
+        fprintf(stderr, "Could not allocate partial aggregate databases\n");
+        return 1;
+    }
+
+    int rc = 0;
+    struct QPTPool *pool = QPTPool_init(in.maxthreads);
+    if (!pool) {
+        fprintf(stderr, "Failed to initialize thread pool\n");
+        rc = 1;
+    }
+    else if (QPTPool_start(pool, &partials) != (size_t) in.maxthreads) {
+        fprintf(stderr, "Failed to start threads\n");
+        rc = 1;
+    }
+    else {
+        for(size_t i = 0; i < partials.count; i++) {
+            QPTPool_enqueue(pool, i, aggregate_intermediate, &partials.ids[i]);
+        }
+
+        QPTPool_wait(pool);
+
+        rc = !!partials.failed;
+    }
+
+    QPTPool_destroy(pool);
+    partials_fin(&partials);
+
+    return rc;
 }
 
 static void aggregate_fin(sqlite3 *aggregate) {
@@ -879,6 +2209,12 @@ static void aggregate_fin(sqlite3 *aggregate) {
 void sub_help() {
    printf("GUFI_index        find GUFI index here\n");
    printf("\n");
+   printf("When aggregating with more than one thread, -J is run on all of the\n");
+   printf("intermediate databases at once and the results are appended together\n");
+   printf("only if the -K tables start empty and have no primary keys, unique\n");
+   printf("indexes, or triggers, and -J only inserts into them. Otherwise, -J is\n");
+   printf("run on one intermediate database at a time.\n");
+   printf("\n");
 }
 
 int main(int argc, char *argv[])
@@ -893,12 +2229,26 @@ int main(int argc, char *argv[])
     /* but allow different fields to be filled at the command-line. */
     /* Callers provide the options-string for get_opt(), which will */
     /* control which options are parsed for each program. */
-    int idx = parse_cmd_line(argc, argv, "hHT:S:E:an:jo:d:O:I:F:y:z:J:K:G:e:m:B:w", 1, "GUFI_index ...", &in);
+    int idx = parse_cmd_line(argc, argv, "hHT:S:E:an:jo:d:O:I:F:y:z:J:K:G:e:m:B:wlM:q:U:k:X:Q:|traversal|queue-stats|max-queued|numa|split-entries|max-results|timeout", 1, "GUFI_index ...", &in);
     if (in.helped)
         sub_help();
     if (idx < 0)
         return -1;
 
+    /* directories are checked against these ranges before they are queried */
+    if (in.prune_len) {
+        struct RangePrune rp;
+        if ((RangePrune_init(&rp, in.prune) != 0) ||
+            !RangePrune_sql(&rp, "treesummary", range_prune_tsum, MAXSQL) ||
+            !RangePrune_sql(&rp, "summary",     range_prune_sum,  MAXSQL)) {
+            fprintf(stderr, "Bad ranges: %s\n", in.prune);
+            return -1;
+        }
+
+        prune_uid_set = RangePrune_equals(&rp, "uid", &prune_uid);
+        prune_gid_set = RangePrune_equals(&rp, "gid", &prune_gid);
+    }
+
     #if defined(DEBUG) && defined(CUMULATIVE_TIMES)
     debug_define_start(setup_globals)
     #endif
@@ -973,8 +2323,75 @@ int main(int argc, char *argv[])
     debug_define_start(work);
     #endif
 
+    /* rows are folded into running aggregates instead of being printed */
+    if (in.stream_len) {
+        stream_aggregates = calloc(in.maxthreads, sizeof(struct StreamingAggregate));
+        for(int i = 0; i < in.maxthreads; i++) {
+            if (!stream_aggregates || (StreamingAggregate_init(&stream_aggregates[i], in.stream) != 0)) {
+                fprintf(stderr, "Bad aggregate spec: %s\n", in.stream);
+                for(int j = 0; stream_aggregates && (j < i); j++) {
+                    StreamingAggregate_destroy(&stream_aggregates[j]);
+                }
+                free(stream_aggregates);
+                OutputBuffers_destroy(&args.output_buffers);
+                outdbs_fin  (gts.outdbd, in.maxthreads, in.sqlfin, in.sqlfin_len);
+                outfiles_fin(gts.outfd, output_count);
+                return -1;
+            }
+        }
+    }
+
+    /* only the largest rows are kept */
+    if (in.topk) {
+        topk_heaps = calloc(in.maxthreads, sizeof(struct TopK));
+        for(int i = 0; i < in.maxthreads; i++) {
+            if (!topk_heaps || (TopK_init(&topk_heaps[i], in.topk) != 0)) {
+                fprintf(stderr, "Could not allocate space for the top %zu rows\n", in.topk);
+                for(int j = 0; topk_heaps && (j < i); j++) {
+                    TopK_destroy(&topk_heaps[j]);
+                }
+                free(topk_heaps);
+                OutputBuffers_destroy(&args.output_buffers);
+                outdbs_fin  (gts.outdbd, in.maxthreads, in.sqlfin, in.sqlfin_len);
+                outfiles_fin(gts.outfd, output_count);
+                return -1;
+            }
+        }
+    }
+
+    /* rows of directories that have not changed are reused from earlier runs */
+    if (in.result_cache[0]) {
+        result_caches = calloc(in.maxthreads, sizeof(struct ResultCache));
+        for(int i = 0; i < in.maxthreads; i++) {
+            if (!result_caches || (ResultCache_init(&result_caches[i], in.result_cache) != 0)) {
+                for(int j = 0; result_caches && (j < i); j++) {
+                    ResultCache_destroy(&result_caches[j]);
+                }
+                free(result_caches);
+                OutputBuffers_destroy(&args.output_buffers);
+                outdbs_fin  (gts.outdbd, in.maxthreads, in.sqlfin, in.sqlfin_len);
+                outfiles_fin(gts.outfd, output_count);
+                return -1;
+            }
+        }
+
+        result_cache_query = hash_queries();
+    }
+
     /* provide a function to print if PRINT is set */
-    args.print_callback_func = ((in.show_results == PRINT)?print_callback:NULL);
+    args.print_callback_func = print_callback;
+    if (in.show_results != PRINT) {
+        args.print_callback_func = NULL;
+    }
+    else if (in.stream_len) {
+        args.print_callback_func = stream_callback;
+    }
+    else if (in.topk) {
+        args.print_callback_func = topk_callback;
+    }
+    else if (result_caches) {
+        args.print_callback_func = cache_callback;
+    }
     struct QPTPool * pool = QPTPool_init(in.maxthreads);
     if (!pool) {
         fprintf(stderr, "Failed to initialize thread pool\n");
@@ -984,6 +2401,27 @@ int main(int argc, char *argv[])
         return -1;
     }
 
+    QPTPool_set_policy(pool, in.traversal, in.traversal_cap);
+    QPTPool_set_queue_limit(pool, in.max_queued);
+
+    if (in.numa) {
+        if (QPTPool_set_numa(pool)) {
+            QPTPool_set_thread_init(pool, numa_thread_init);
+        }
+        else {
+            fprintf(stderr, "Warning: No NUMA nodes found. Threads will not be pinned.\n");
+        }
+    }
+
+    /* running queries are interrupted when the pool is cancelled */
+    if (in.timeout) {
+        active_dbs = calloc(in.maxthreads, sizeof(struct ActiveDB));
+        for(int i = 0; active_dbs && (i < in.maxthreads); i++) {
+            pthread_mutex_init(&active_dbs[i].mutex, NULL);
+        }
+        QPTPool_set_cancel(pool, active_dbs?interrupt_db:NULL);
+    }
+
     if (QPTPool_start(pool, &args) != (size_t) in.maxthreads) {
         fprintf(stderr, "Failed to start threads\n");
         OutputBuffers_destroy(&args.output_buffers);
@@ -992,6 +2430,16 @@ int main(int argc, char *argv[])
         return -1;
     }
 
+    struct Timeout timeout;
+    const int timer = in.timeout && (timeout_start(&timeout, pool) == 0);
+    if (in.timeout && !timer) {
+        fprintf(stderr, "Warning: Could not start the timer. --timeout will not be applied.\n");
+    }
+
+    /* packed indexes have to stay open until all threads are done */
+    struct PackedIndex ** packed_indexes = calloc(argc - idx, sizeof(struct PackedIndex *));
+    size_t packed_count = 0;
+
     /* enqueue all input paths */
     for(int i = idx; i < argc; i++) {
         /* remove trailing slashes */
@@ -1012,7 +2460,20 @@ int main(int argc, char *argv[])
         mywork->root = argv[i];
 
         lstat(mywork->name,&mywork->statuso);
-        if (!S_ISDIR(mywork->statuso.st_mode) ) {
+
+        /* a file is the table of contents of a packed index */
+        if (S_ISREG(mywork->statuso.st_mode)) {
+            struct PackedIndex * pi = PackedIndex_open(mywork->name, in.maxthreads);
+            if (!pi) {
+                free(mywork);
+                continue;
+            }
+
+            packed_indexes[packed_count++] = pi;
+            mywork->index = pi;
+            mywork->tocid = pi->root;
+        }
+        else if (!S_ISDIR(mywork->statuso.st_mode) ) {
             fprintf(stderr,"input-dir '%s' is not a directory\n", mywork->name);
             free(mywork);
             continue;
@@ -1024,12 +2485,56 @@ int main(int argc, char *argv[])
 
     QPTPool_wait(pool);
 
+    const int timed_out = timer && timeout_stop(&timeout);
+    if (timed_out) {
+        fprintf(stderr, "Timed out after %zu seconds: %zu queued items were dropped\n",
+                in.timeout, QPTPool_dropped(pool));
+    }
+
+    if (active_dbs) {
+        for(int i = 0; i < in.maxthreads; i++) {
+            pthread_mutex_destroy(&active_dbs[i].mutex);
+        }
+        free(active_dbs);
+        active_dbs = NULL;
+    }
+
+    for(size_t i = 0; i < packed_count; i++) {
+        PackedIndex_close(packed_indexes[i]);
+    }
+    free(packed_indexes);
+
     #if (defined(DEBUG) && defined(CUMULATIVE_TIMES)) || BENCHMARK
     const size_t thread_count = QPTPool_threads_completed(pool);
     #endif
 
+    if (in.queue_stats) {
+        const size_t peak = QPTPool_peak_incomplete(pool);
+        fprintf(stderr, "Peak queued directories: %zu (%.2Lf MiB)\n",
+                peak, ((long double) peak * (QPTPool_item_size() + sizeof(struct work))) / (1024 * 1024));
+    }
+
+    if (in.max_queued) {
+        fprintf(stderr, "Queue limit reached: %zu directories processed inline\n", QPTPool_inlined(pool));
+    }
+
     QPTPool_destroy(pool);
 
+    if (result_caches) {
+        size_t hits = 0;
+        size_t misses = 0;
+        for(int i = 0; i < in.maxthreads; i++) {
+            hits   += result_caches[i].hits;
+            misses += result_caches[i].misses;
+            ResultCache_destroy(&result_caches[i]);
+        }
+        free(result_caches);
+        result_caches = NULL;
+
+        fprintf(stderr, "Result cache: %zu hits, %zu misses (%.2Lf%% hit rate)\n",
+                hits, misses, (hits + misses)?((100.0L * hits) / (hits + misses)):0.0L);
+    }
+
     #if (defined(DEBUG) && defined(CUMULATIVE_TIMES)) || BENCHMARK
     debug_end(work);
 
@@ -1043,18 +2548,28 @@ int main(int argc, char *argv[])
     #endif
 
     int rc = 0;
+    if (stream_aggregates) {
+        rc = stream_fin(&args.output_buffers);
+    }
+
+    if (topk_heaps) {
+        rc = topk_fin(&args.output_buffers);
+    }
+
     if (in.show_results == AGGREGATE) {
         #if (defined(DEBUG) && defined(CUMULATIVE_TIMES)) || BENCHMARK
         debug_define_start(aggregation);
         #endif
 
         /* aggregate the intermediate results */
-        for(int i = 0; i < in.maxthreads; i++) {
-            if (!attachdb(aggregate_name, gts.outdbd[i], AGGREGATE_ATTACH_NAME, RDWR)         ||
-                (sqlite3_exec(gts.outdbd[i], in.intermediate, NULL, NULL, NULL) != SQLITE_OK)) {
-                fprintf(stderr, "Aggregation of intermediate databases error: %s\n", sqlite3_errmsg(gts.outdbd[i]));
+        if (aggregate_in_parallel(aggregate, aggregate_name)) {
+            if (aggregate_parallel(aggregate, aggregate_name) != 0) {
+                rc = -1;
             }
         }
+        else if (aggregate_sequential(aggregate_name) != 0) {
+            rc = -1;
+        }
 
         #if (defined(DEBUG) && defined(CUMULATIVE_TIMES)) || BENCHMARK
         debug_end(aggregation);
@@ -1089,6 +2604,11 @@ int main(int argc, char *argv[])
         aggregate_fin(aggregate);
     }
 
+    /* whatever was found before the timeout was printed, but the results are incomplete */
+    if (timed_out) {
+        rc = -1;
+    }
+
     #if defined(DEBUG) && defined(CUMULATIVE_TIMES)
     debug_define_start(cleanup_globals);
     #endif
@@ -1158,6 +2678,7 @@ int main(int argc, char *argv[])
     print_stats("            access:                         %.2Lfs", "%Lf", sec(total_access_time));
     print_stats("            set:                            %.2Lfs", "%Lf", sec(total_set_time));
     print_stats("            clone:                          %.2Lfs", "%Lf", sec(total_clone_time));
+    print_stats("            prefetch:                       %.2Lfs", "%Lf", sec(total_prefetch_time));
     print_stats("            pushdir:                        %.2Lfs", "%Lf", sec(total_pushdir_time));
     print_stats("    attach intermediate databases:          %.2Lfs", "%Lf", sec(total_attach_time));
     print_stats("    check if treesummary table exists       %.2Lfs", "%Lf", sec(total_sqltsumcheck_time));
@@ -1178,6 +2699,12 @@ int main(int argc, char *argv[])
     }
     print_stats("Rows returned:                              %zu",    "%zu", rows);
     print_stats("Queries performed:                          %zu",    "%zu", query_count);
+    print_stats("Bytes read by read-only VFS:                %" PRIu64, "%" PRIu64, total_vfs_bytes);
+    print_stats("System calls made by read-only VFS:         %" PRIu64, "%" PRIu64, total_vfs_syscalls);
+    print_stats("Entries tables skipped by top k:            %" PRIu64, "%" PRIu64, total_topk_pruned);
+    print_stats("Subtrees skipped by ranges:                 %" PRIu64, "%" PRIu64, total_range_pruned_subtrees);
+    print_stats("Entries tables skipped by ranges:           %" PRIu64, "%" PRIu64, total_range_pruned_entries);
+    print_stats("Subtrees skipped by uid and gid filters:    %" PRIu64, "%" PRIu64, total_owner_pruned_subtrees);
     print_stats("Real time:                                  %.2Lfs", "%Lf", total_time_sec);
     print_stats("Total Thread Time (not including main):     %.2Lfs", "%Lf", sec(thread_time));
     if (in.terse) {
@@ -447,7 +447,7 @@ int process_path(const char *path, FILE *out, const char *format) {
     ca.format = format;
 
     int rc = 1;
-    if ((db = opendb(dbname, RDONLY, 0, 1,
+    if ((db = opendb(dbname, RDONLY, 0, 1, 0,
                      NULL, NULL
                      #ifdef DEBUG
                      , NULL, NULL
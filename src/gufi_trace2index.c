@@ -62,12 +62,15 @@ OF SUCH DAMAGE.
 
 
 
+#include <dirent.h>
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "EntryShards.h"
 #include "QueuePerThreadPool.h"
 #include "bf.h"
 #include "debug.h"
@@ -93,6 +96,8 @@ struct row {
     size_t len;
     long offset;
     size_t entries;
+    long * shard_offsets;   /* where each group of in.shard_entries entries after the first starts */
+    size_t shard_count;
 };
 
 struct row * row_init(const size_t first_delim, char * line, const size_t len, const long offset) {
@@ -103,17 +108,33 @@ struct row * row_init(const size_t first_delim, char * line, const size_t len, c
         row->len = len;
         row->offset = offset;
         row->entries = 0;
+        row->shard_offsets = NULL;
+        row->shard_count = 0;
     }
     return row;
 }
 
+void row_add_shard(struct row * row, const long offset) {
+    row->shard_offsets = realloc(row->shard_offsets, (row->shard_count + 1) * sizeof(long));
+    row->shard_offsets[row->shard_count++] = offset;
+}
+
 void row_destroy(struct row * row) {
     if (row) {
+        free(row->shard_offsets);
         free(row->line);
         free(row);
     }
 }
 
+/* a group of entries of a large directory that go into their own database */
+struct shard {
+    struct EntryShards * shards;
+    size_t shard;
+    long offset;
+    size_t entries;
+};
+
 #ifdef DEBUG
 
 #define debug_start(name) define_start(name)
@@ -150,6 +171,59 @@ uint64_t total_files            = 0;
 #define debug_end(name)
 #endif
 
+/* insert a group of entries of a large directory into their own database */
+int processshard(struct QPTPool * ctx, const size_t id, void * data, void * args) {
+    (void) ctx;
+
+    struct shard * shard = (struct shard *) data;
+    FILE * trace = ((FILE **) args)[id];
+
+    struct sum summary;
+    EntryShards_zeroit(&summary);
+
+    sqlite3 * db = EntryShards_open(shard->shards, shard->shard, templatefd, templatesize);
+    if (db) {
+        sqlite3_stmt * res = insertdbprep(db);
+
+        startdb(db);
+
+        fseek(trace, shard->offset, SEEK_SET);
+
+        for(size_t i = 0; i < shard->entries; i++) {
+            char * line = NULL;
+            size_t len = 0;
+            if (getline(&line, &len, trace) == -1) {
+                free(line);
+                break;
+            }
+
+            struct work row;
+            memset(&row, 0, sizeof(struct work));
+            linetowork(line, len, in.delim, &row);
+            free(line);
+
+            sumit(&summary, &row);
+
+            /* don't record pinode */
+            row.pinode = 0;
+
+            insertdbgo(&row, db, res);
+        }
+
+        stopdb(db);
+        insertdbfin(res);
+        closedb(db);
+    }
+
+    if (EntryShards_done(shard->shards, &summary)) {
+        EntryShards_destroy(shard->shards);
+    }
+
+    free(shard);
+
+    return !db;
+}
+
 /* process the work under one directory (no recursion) */
 int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args) {
     #ifdef DEBUG
@@ -199,8 +273,6 @@ int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args)
     /*     return 1; */
     /* } */
 
-    (void) ctx;
-
     struct row * w = (struct row *) data;
     FILE * trace = ((FILE **) args)[id];
 
@@ -257,7 +329,7 @@ int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args)
 
     /* process the work */
     debug_start(opendb_call);
-    sqlite3 * db = opendb(dbname, RDWR, 1, 0,
+    sqlite3 * db = opendb(dbname, RDWR, 1, 0, 0,
                           NULL, NULL
                           #ifdef DEBUG
                           , NULL, NULL
@@ -282,6 +354,30 @@ int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args)
         startdb(db);
         debug_end(startdb_call);
 
+        /* the entries after the first in.shard_entries go into other */
+        /* databases, which are filled in by other threads */
+        struct EntryShards * shards = NULL;
+        size_t entries = w->entries;
+        if (in.shard_entries && (w->entries > in.shard_entries)) {
+            shards = EntryShards_init(topath, &dir);
+            for(size_t i = 0; i < w->shard_count; i++) {
+                const size_t first = (i + 1) * in.shard_entries;
+                if (first >= w->entries) {
+                    break;
+                }
+
+                struct shard * shard = malloc(sizeof(struct shard));
+                shard->shards = shards;
+                shard->shard = EntryShards_add(shards);
+                shard->offset = w->shard_offsets[i];
+                shard->entries = ((w->entries - first) > in.shard_entries)?in.shard_entries:(w->entries - first);
+
+                QPTPool_enqueue(ctx, id, processshard, shard);
+            }
+
+            entries = in.shard_entries;
+        }
+
         /* move the trace file to the offet */
         debug_start(fseek_call);
         fseek(trace, w->offset, SEEK_SET);
@@ -289,7 +385,7 @@ int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args)
 
         debug_start(read_entries);
         size_t row_count = 0;
-        for(size_t i = 0; i < w->entries; i++) {
+        for(size_t i = 0; i < entries; i++) {
             debug_start(getline_call);
             char * line = NULL;
             size_t len = 0;
@@ -397,14 +493,21 @@ int processdir(struct QPTPool * ctx, const size_t id, void * data, void * args)
         insertdbfin(res);
         debug_end(insertdbfin_call);
 
+        /* the last database of a sharded directory writes the summary */
         debug_start(insertsumdb_call);
-        insertsumdb(db, &dir, &summary);
+        if (!shards) {
+            insertsumdb(db, &dir, &summary);
+        }
         debug_end(insertsumdb_call);
 
         debug_start(closedb_call);
         closedb(db); /* don't set to nullptr */
         debug_end(closedb_call);
 
+        if (shards && EntryShards_done(shards, &summary)) {
+            EntryShards_destroy(shards);
+        }
+
         #ifdef DEBUG
         timestamp_start(print_timestamps);
         #ifdef PER_THREAD_STATS
@@ -520,7 +623,6 @@ int scout_function(struct QPTPool * ctx, const size_t id, void * data, void * ar
     char * filename = (char *) data;
     FILE * trace = fopen(filename, "rb");
 
-    (void) id;
     (void) args;
 
     /* the trace file must exist */
@@ -560,7 +662,9 @@ int scout_function(struct QPTPool * ctx, const size_t id, void * data, void * ar
 
     struct row * work = row_init(first_delim, line, len, ftell(trace));
 
-    size_t target_thread = 0;
+    /* directories are enqueued a batch at a time */
+    struct QPTPoolBatch batch;
+    QPTPool_batch_init(&batch);
 
     size_t file_count = 0;
     size_t dir_count = 1; /* always start with a directory */
@@ -590,8 +694,9 @@ int scout_function(struct QPTPool * ctx, const size_t id, void * data, void * ar
             empty += !work->entries;
 
             /* put the previous work on the queue */
-            QPTPool_enqueue(ctx, target_thread, processdir, work);
-            target_thread = (target_thread + 1) % ctx->size;
+            if (QPTPool_batch_add(&batch, processdir, work) == QPTPOOL_BATCH_SIZE) {
+                QPTPool_enqueue_batch(ctx, id, &batch);
+            }
 
             /* put the current line into a new work item */
             work = row_init(first_delim, line, len, ftell(trace));
@@ -601,6 +706,11 @@ int scout_function(struct QPTPool * ctx, const size_t id, void * data, void * ar
             work->entries++;
             file_count++;
 
+            /* remember where each group of entries after the first starts */
+            if (in.shard_entries && !(work->entries % in.shard_entries)) {
+                row_add_shard(work, ftell(trace));
+            }
+
             /* this line is not needed */
             free(line);
         }
@@ -614,7 +724,8 @@ int scout_function(struct QPTPool * ctx, const size_t id, void * data, void * ar
     free(line);
 
     /* insert the last work item */
-    QPTPool_enqueue(ctx, target_thread, processdir, work);
+    QPTPool_batch_add(&batch, processdir, work);
+    QPTPool_enqueue_batch(ctx, id, &batch);
 
     fclose(trace);
 
@@ -630,6 +741,97 @@ int scout_function(struct QPTPool * ctx, const size_t id, void * data, void * ar
     return 0;
 }
 
+/*
+ * The trace does not have to be in tree order, so the subdirectories
+ * of a directory are only known after every directory has been created.
+ * With --subdirs, walk the new index and record each directory's
+ * children in its subdirs table so that queries do not have to call
+ * readdir.
+ */
+int record_subdirs(struct QPTPool * ctx, const size_t id, void * data, void * args) {
+    (void) args;
+
+    char * path = (char *) data;
+    const size_t path_len = strlen(path);
+
+    DIR * dir = opendir(path);
+    if (!dir) {
+        fprintf(stderr, "Could not open directory \"%s\"\n", path);
+        free(path);
+        return 1;
+    }
+
+    /* directories that were created as parents of */
+    /* trace directories do not have databases */
+    char dbname[MAXPATH];
+    SNFORMAT_S(dbname, MAXPATH, 2, path, path_len, "/" DBNAME, (size_t) (DBNAME_LEN + 1));
+
+    sqlite3 * db = NULL;
+    sqlite3_stmt * res = NULL;
+    struct stat db_st;
+    if (lstat(dbname, &db_st) == 0) {
+        db = opendb(dbname, RDWR, 1, 0, 0,
+                    NULL, NULL
+                    #ifdef DEBUG
+                    , NULL, NULL
+                    , NULL, NULL
+                    , NULL, NULL
+                    , NULL, NULL
+                    #endif
+                    );
+        if (db) {
+            res = insertsubdirprep(db);
+            startdb(db);
+        }
+    }
+
+    struct dirent * entry = NULL;
+    while ((entry = readdir(dir))) {
+        if ((entry->d_type != DT_DIR) && (entry->d_type != DT_UNKNOWN)) {
+            continue;
+        }
+
+        const size_t len = strlen(entry->d_name);
+
+        /* skip . and .. */
+        if (entry->d_name[0] == '.') {
+            if ((len == 1) ||
+                ((len == 2) && (entry->d_name[1] == '.'))) {
+                continue;
+            }
+        }
+
+        char * child = malloc(MAXPATH);
+        SNFORMAT_S(child, MAXPATH, 3, path, path_len, "/", (size_t) 1, entry->d_name, len);
+
+        /* not every file system fills in d_type */
+        if (entry->d_type == DT_UNKNOWN) {
+            struct stat st;
+            if ((lstat(child, &st) != 0) || !S_ISDIR(st.st_mode)) {
+                free(child);
+                continue;
+            }
+        }
+
+        QPTPool_enqueue(ctx, id, record_subdirs, child);
+
+        if (res) {
+            insertsubdirgo(entry->d_name, len, db, res);
+        }
+    }
+
+    if (db) {
+        stopdb(db);
+        insertdbfin(res);
+        closedb(db);
+    }
+
+    closedir(dir);
+    free(path);
+
+    return 0;
+}
+
 void sub_help() {
    printf("input_file        parse this trace file to produce the GUFI index\n");
    printf("output_dir        build GUFI index here\n");
@@ -665,7 +867,7 @@ int main(int argc, char * argv[]) {
     clock_gettime(CLOCK_MONOTONIC, &main_call.start);
     epoch = since_epoch(&main_call.start);
 
-    int idx = parse_cmd_line(argc, argv, "hHn:d:", 2, "input_file output_dir", &in);
+    int idx = parse_cmd_line(argc, argv, "hHn:d:C:|shard-entries|subdirs", 2, "input_file output_dir", &in);
     if (in.helped)
         sub_help();
     if (idx < 0)
@@ -680,7 +882,8 @@ int main(int argc, char * argv[]) {
             return retval;
     }
 
-    if ((templatesize = create_template(&templatefd)) == (off_t) -1) {
+    /* without --subdirs, leave the subdirs table out so that gufi_query -l falls back to readdir */
+    if ((templatesize = create_template(&templatefd, in.subdirs)) == (off_t) -1) {
         fprintf(stderr, "Could not create template file\n");
         return -1;
     }
@@ -730,6 +933,31 @@ int main(int argc, char * argv[]) {
     /* set top level permissions */
     chmod(in.nameto, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
 
+    /* optional second pass: fill in the subdirs tables */
+    if (in.subdirs) {
+        pool = QPTPool_init(in.maxthreads);
+        if (!pool) {
+            fprintf(stderr, "Failed to initialize thread pool\n");
+            close_per_thread_traces(traces, in.maxthreads);
+            close(templatefd);
+            return -1;
+        }
+
+        if (!QPTPool_start(pool, NULL)) {
+            fprintf(stderr, "Failed to start threads\n");
+            close_per_thread_traces(traces, in.maxthreads);
+            close(templatefd);
+            return -1;
+        }
+
+        char * root = malloc(MAXPATH);
+        SNFORMAT_S(root, MAXPATH, 1, in.nameto, strlen(in.nameto));
+        QPTPool_enqueue(pool, 0, record_subdirs, root);
+
+        QPTPool_wait(pool);
+        QPTPool_destroy(pool);
+    }
+
     close_per_thread_traces(traces, in.maxthreads);
     close(templatefd);
 
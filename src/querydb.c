@@ -147,7 +147,7 @@ int main(int argc, char *argv[])
 
 
      // run the query
-     db = opendb(dbname, RDONLY, 1, 1,
+     db = opendb(dbname, RDONLY, 1, 1, 0,
                  NULL, NULL
                  #ifdef DEBUG
                  , NULL, NULL
@@ -122,7 +122,7 @@ int main(int argc, char *argv[])
         rsqlstmt = argv[idx++];
     }
 
-    if (!(db = opendb(":memory:", RDWR, 1, 1,
+    if (!(db = opendb(":memory:", RDWR, 1, 1, 0,
                       NULL, NULL
                       #ifdef DEBUG
                       , NULL, NULL
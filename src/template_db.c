@@ -96,7 +96,12 @@ static ssize_t gufi_copyfd(int src_fd, int dst_fd, size_t size) {
 extern int errno;
 
 static int create_tables(const char *name, sqlite3 *db, void *args) {
+    const int subdirs = * (int *) args;
+
     if ((create_table_wrapper(name, db, "esql",        esql,        NULL, NULL) != SQLITE_OK) ||
+        (subdirs &&
+         (create_table_wrapper(name, db, "sdsql",       sdsql,       NULL, NULL) != SQLITE_OK)) ||
+        (create_table_wrapper(name, db, "shsql",       shsql,       NULL, NULL) != SQLITE_OK) ||
         (create_table_wrapper(name, db, "ssql",        ssql,        NULL, NULL) != SQLITE_OK) ||
         (create_table_wrapper(name, db, "vssqldir",    vssqldir,    NULL, NULL) != SQLITE_OK) ||
         (create_table_wrapper(name, db, "vssqluser",   vssqluser,   NULL, NULL) != SQLITE_OK) ||
@@ -109,11 +114,11 @@ static int create_tables(const char *name, sqlite3 *db, void *args) {
 }
 
 // create the initial database file to copy from
-off_t create_template(int * fd) {
+off_t create_template(int * fd, const int subdirs) {
     static const char name[] = "tmp.db";
 
-    sqlite3 * db = opendb(name, RDWR, 0, 0,
-                          create_tables, NULL
+    sqlite3 * db = opendb(name, RDWR, 0, 0, 0,
+                          create_tables, (void *) &subdirs
                           #ifdef DEBUG
                           , NULL, NULL
                           , NULL, NULL
@@ -66,12 +66,17 @@ OF SUCH DAMAGE.
 #include <errno.h>
 #include <limits.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#if defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#endif
+
 #include "config.h"
 #include "utils.h"
 
@@ -258,46 +263,160 @@ int zeroit(struct sum *summary)
   summary->minossint4=LLONG_MAX;
   summary->maxossint4=LLONG_MIN;
   summary->totossint4=0;
+  memset(summary->sizehistfiles, 0, sizeof(summary->sizehistfiles));
+  memset(summary->sizehistbytes, 0, sizeof(summary->sizehistbytes));
+  memset(summary->agehistfiles,  0, sizeof(summary->agehistfiles));
+  memset(summary->agehistbytes,  0, sizeof(summary->agehistbytes));
   return 0;
 }
 
+size_t hist_bucket(const long long int value) {
+  if (value < 1) {
+    return 0;
+  }
+
+  /* floor(log2(value)) */
+  size_t log2 = 0;
+  #if defined(__GNUC__)
+  log2 = 63 - __builtin_clzll((unsigned long long int) value);
+  #else
+  for(unsigned long long int v = value; v >>= 1;) {
+    log2++;
+  }
+  #endif
+
+  const size_t shift = in.hist_shift?in.hist_shift:1;
+  return 1 + (log2 / shift);
+}
+
+/* 2^bits, or LLONG_MAX if that does not fit */
+static long long int hist_bound(const size_t bits) {
+  return (bits < 63)?(1LL << bits):LLONG_MAX;
+}
+
+long long int hist_bucket_low(const size_t bucket, const size_t bits) {
+  const size_t shift = bits?bits:1;
+  return bucket?hist_bound((bucket - 1) * shift):0;
+}
+
+long long int hist_bucket_high(const size_t bucket, const size_t bits) {
+  const size_t shift = bits?bits:1;
+  return hist_bound(bucket * shift);
+}
+
+/*
+ * struct sum keeps its mins, maxes, and totals contiguous, so they can
+ * be folded with the same kernels as arrays of lanes
+ */
+#define SUM_LANES(summary, first) ((long long int *) ((char *) (summary) + offsetof(struct sum, first)))
+
+/* all 12 min/max lanes; the last 2 (size and blocks) only count files */
+#define SUM_MINMAX_LANES      12
+#define SUM_MINMAX_FILE_LANES 2
+#define SUM_TOTAL_LANES       14
+
+/* compile time checks that the lanes are where the kernels expect them */
+#define SUM_LANE_CHECK(first, last, count) \
+  typedef char sum_lane_check_##last[((offsetof(struct sum, last) - offsetof(struct sum, first)) == (((count) - 1) * sizeof(long long int)))?1:-1]
+
+SUM_LANE_CHECK(minuid,   minblocks,  SUM_MINMAX_LANES);
+SUM_LANE_CHECK(maxuid,   maxblocks,  SUM_MINMAX_LANES);
+SUM_LANE_CHECK(minuid,   minsize,    SUM_MINMAX_LANES - 1);
+SUM_LANE_CHECK(maxuid,   maxsize,    SUM_MINMAX_LANES - 1);
+SUM_LANE_CHECK(totfiles, totossint4, SUM_TOTAL_LANES);
+
+/* the 4 histograms are added as one array of lanes */
+#define SUM_HIST_LANES (4 * SUM_HIST_BUCKETS)
+typedef char sum_lane_check_hist[((offsetof(struct sum, agehistbytes) - offsetof(struct sum, sizehistfiles)) == (3 * sizeof(((struct sum *) 0)->sizehistfiles)))?1:-1];
+
+/* min[i] = min(min[i], lo[i]) and max[i] = max(max[i], hi[i]) */
+static inline void minmax_lanes(long long int *min, long long int *max,
+                                const long long int *lo, const long long int *hi,
+                                const size_t count) {
+  size_t i = 0;
+
+  #if defined(__AVX2__)
+  for(; (i + 4) <= count; i += 4) {
+    const __m256i cur_min = _mm256_loadu_si256((const __m256i *) (min + i));
+    const __m256i cur_max = _mm256_loadu_si256((const __m256i *) (max + i));
+    const __m256i new_min = _mm256_loadu_si256((const __m256i *) (lo + i));
+    const __m256i new_max = _mm256_loadu_si256((const __m256i *) (hi + i));
+    _mm256_storeu_si256((__m256i *) (min + i), _mm256_blendv_epi8(cur_min, new_min, _mm256_cmpgt_epi64(cur_min, new_min)));
+    _mm256_storeu_si256((__m256i *) (max + i), _mm256_blendv_epi8(cur_max, new_max, _mm256_cmpgt_epi64(new_max, cur_max)));
+  }
+  #elif defined(__SSE4_2__)
+  for(; (i + 2) <= count; i += 2) {
+    const __m128i cur_min = _mm_loadu_si128((const __m128i *) (min + i));
+    const __m128i cur_max = _mm_loadu_si128((const __m128i *) (max + i));
+    const __m128i new_min = _mm_loadu_si128((const __m128i *) (lo + i));
+    const __m128i new_max = _mm_loadu_si128((const __m128i *) (hi + i));
+    _mm_storeu_si128((__m128i *) (min + i), _mm_blendv_epi8(cur_min, new_min, _mm_cmpgt_epi64(cur_min, new_min)));
+    _mm_storeu_si128((__m128i *) (max + i), _mm_blendv_epi8(cur_max, new_max, _mm_cmpgt_epi64(new_max, cur_max)));
+  }
+  #endif
+
+  for(; i < count; i++) {
+    if (lo[i] < min[i]) min[i] = lo[i];
+    if (hi[i] > max[i]) max[i] = hi[i];
+  }
+}
+
+/* tot[i] += add[i] */
+static inline void add_lanes(long long int *tot, const long long int *add, const size_t count) {
+  size_t i = 0;
+
+  #if defined(__AVX2__)
+  for(; (i + 4) <= count; i += 4) {
+    _mm256_storeu_si256((__m256i *) (tot + i),
+                        _mm256_add_epi64(_mm256_loadu_si256((const __m256i *) (tot + i)),
+                                         _mm256_loadu_si256((const __m256i *) (add + i))));
+  }
+  #elif defined(__SSE4_2__)
+  for(; (i + 2) <= count; i += 2) {
+    _mm_storeu_si128((__m128i *) (tot + i),
+                     _mm_add_epi64(_mm_loadu_si128((const __m128i *) (tot + i)),
+                                   _mm_loadu_si128((const __m128i *) (add + i))));
+  }
+  #endif
+
+  for(; i < count; i++) {
+    tot[i] += add[i];
+  }
+}
+
 int sumit (struct sum *summary,struct work *pwork) {
+  /* the values of this entry, in lane order */
+  const long long int values[SUM_MINMAX_LANES] = {
+    pwork->statuso.st_uid,
+    pwork->statuso.st_gid,
+    pwork->statuso.st_ctime,
+    pwork->statuso.st_mtime,
+    pwork->statuso.st_atime,
+    pwork->crtime,
+    pwork->ossint1,
+    pwork->ossint2,
+    pwork->ossint3,
+    pwork->ossint4,
+    pwork->statuso.st_size,
+    pwork->statuso.st_blocks,
+  };
+
+  long long int *mins = SUM_LANES(summary, minuid);
+  long long int *maxs = SUM_LANES(summary, maxuid);
 
   if (summary->setit == 0) {
-    summary->minuid=pwork->statuso.st_uid;
-    summary->maxuid=pwork->statuso.st_uid;
-    summary->mingid=pwork->statuso.st_gid;
-    summary->maxgid=pwork->statuso.st_gid;
-    summary->minsize=pwork->statuso.st_size;
-    summary->maxsize=pwork->statuso.st_size;;
-    summary->minctime=pwork->statuso.st_ctime;
-    summary->maxctime=pwork->statuso.st_ctime;
-    summary->minmtime=pwork->statuso.st_mtime;
-    summary->maxmtime=pwork->statuso.st_mtime;
-    summary->minatime=pwork->statuso.st_atime;
-    summary->maxatime=pwork->statuso.st_atime;;
-    summary->minblocks=pwork->statuso.st_blocks;
-    summary->maxblocks=pwork->statuso.st_blocks;
-    summary->mincrtime=pwork->crtime;
-    summary->maxcrtime=pwork->crtime;
-    summary->minossint1=pwork->ossint1;
-    summary->maxossint1=pwork->ossint1;
+    memcpy(mins, values, sizeof(values));
+    memcpy(maxs, values, sizeof(values));
     summary->totossint1=pwork->ossint1;
-    summary->minossint2=pwork->ossint2;
-    summary->maxossint2=pwork->ossint2;
     summary->totossint2=pwork->ossint2;
-    summary->minossint3=pwork->ossint3;
-    summary->maxossint3=pwork->ossint3;
     summary->totossint3=pwork->ossint3;
-    summary->minossint4=pwork->ossint4;
-    summary->maxossint4=pwork->ossint4;
     summary->totossint4=pwork->ossint4;
     summary->setit=1;
   }
+
+  size_t lanes = SUM_MINMAX_LANES - SUM_MINMAX_FILE_LANES;
   if (!strncmp(pwork->type,"f",1)) {
      summary->totfiles++;
-     if (pwork->statuso.st_size < summary->minsize) summary->minsize=pwork->statuso.st_size;
-     if (pwork->statuso.st_size > summary->maxsize) summary->maxsize=pwork->statuso.st_size;
      if (pwork->statuso.st_size <= 1024) summary->totltk++;
      if (pwork->statuso.st_size > 1024) summary->totmtk++;
      if (pwork->statuso.st_size <= 1048576) summary->totltm++;
@@ -306,40 +425,26 @@ int sumit (struct sum *summary,struct work *pwork) {
      if (pwork->statuso.st_size > 1099511627776) summary->totmtt++;
      summary->totsize=summary->totsize+pwork->statuso.st_size;
 
-     if (pwork->statuso.st_blocks < summary->minblocks) summary->minblocks=pwork->statuso.st_blocks;
-     if (pwork->statuso.st_blocks > summary->maxblocks) summary->maxblocks=pwork->statuso.st_blocks;
+     const size_t size_bucket = hist_bucket(pwork->statuso.st_size);
+     summary->sizehistfiles[size_bucket]++;
+     summary->sizehistbytes[size_bucket] += pwork->statuso.st_size;
+
+     const size_t age_bucket = hist_bucket(in.hist_now - pwork->statuso.st_mtime);
+     summary->agehistfiles[age_bucket]++;
+     summary->agehistbytes[age_bucket] += pwork->statuso.st_size;
+
+     /* size and blocks too */
+     lanes = SUM_MINMAX_LANES;
   }
   if (!strncmp(pwork->type,"l",1)) {
      summary->totlinks++;
   }
 
-  if (pwork->statuso.st_uid < summary->minuid) summary->minuid=pwork->statuso.st_uid;
-  if (pwork->statuso.st_uid > summary->maxuid) summary->maxuid=pwork->statuso.st_uid;
-  if (pwork->statuso.st_gid < summary->mingid) summary->mingid=pwork->statuso.st_gid;
-  if (pwork->statuso.st_gid > summary->maxgid) summary->maxgid=pwork->statuso.st_gid;
-  if (pwork->statuso.st_ctime < summary->minctime) summary->minctime=pwork->statuso.st_ctime;
-  if (pwork->statuso.st_ctime > summary->maxctime) summary->maxctime=pwork->statuso.st_ctime;
-  if (pwork->statuso.st_mtime < summary->minmtime) summary->minmtime=pwork->statuso.st_mtime;
-  if (pwork->statuso.st_mtime > summary->maxmtime) summary->maxmtime=pwork->statuso.st_mtime;
-  if (pwork->statuso.st_atime < summary->minatime) summary->minatime=pwork->statuso.st_atime;
-  if (pwork->statuso.st_atime > summary->maxatime) summary->maxatime=pwork->statuso.st_atime;
-  if (pwork->crtime < summary->mincrtime) summary->mincrtime=pwork->crtime;
-  if (pwork->crtime > summary->maxcrtime) summary->maxcrtime=pwork->crtime;
-
-  if (pwork->ossint1 < summary->minossint1) summary->minossint1=pwork->ossint1;
-  if (pwork->ossint1 > summary->maxossint1) summary->maxossint1=pwork->ossint1;
-  summary->totossint1=summary->totossint1+pwork->ossint1;
+  minmax_lanes(mins, maxs, values, values, lanes);
 
-  if (pwork->ossint2 < summary->minossint2) summary->minossint2=pwork->ossint2;
-  if (pwork->ossint2 > summary->maxossint2) summary->maxossint2=pwork->ossint2;
+  summary->totossint1=summary->totossint1+pwork->ossint1;
   summary->totossint2=summary->totossint2+pwork->ossint2;
-
-  if (pwork->ossint3 < summary->minossint3) summary->minossint3=pwork->ossint3;
-  if (pwork->ossint3 > summary->maxossint3) summary->maxossint3=pwork->ossint3;
   summary->totossint3=summary->totossint3+pwork->ossint3;
-
-  if (pwork->ossint4 < summary->minossint4) summary->minossint4=pwork->ossint4;
-  if (pwork->ossint4 > summary->maxossint4) summary->maxossint4=pwork->ossint4;
   summary->totossint4=summary->totossint4+pwork->ossint4;
 
   size_t xattrdelim_counter = 0;
@@ -355,9 +460,7 @@ int sumit (struct sum *summary,struct work *pwork) {
   return 0;
 }
 
-int tsumit (struct sum *sumin,struct sum *smout) {
-
-  pthread_mutex_lock(&sum_mutex);
+int tsumit_unlocked (struct sum *sumin,struct sum *smout) {
 
   /* if sumin totsubdirs is > 0 we are summing a treesummary not a dirsummary */
   if (sumin->totsubdirs > 0) {
@@ -372,81 +475,54 @@ int tsumit (struct sum *sumin,struct sum *smout) {
     if (sumin->totsize  > smout->maxsubdirsize)  smout->maxsubdirsize  = sumin->totsize;
   }
 
-  smout->totfiles += sumin->totfiles;
-  smout->totlinks += sumin->totlinks;
-
+  /* only set these mins and maxes if there are files in the directory
+     otherwise mins are all zero */
   if (sumin->totfiles > 0) {
+    const long long int *in_mins = SUM_LANES(sumin, minuid);
+    const long long int *in_maxs = SUM_LANES(sumin, maxuid);
+    long long int *out_mins = SUM_LANES(smout, minuid);
+    long long int *out_maxs = SUM_LANES(smout, maxuid);
+
     if (smout->setit == 0) {
-      smout->minuid=sumin->minuid;
-      smout->maxuid=sumin->maxuid;
-      smout->mingid=sumin->mingid;
-      smout->maxgid=sumin->maxgid;
-      smout->minsize=sumin->minsize;
-      smout->maxsize=sumin->maxsize;
-      smout->minctime=sumin->minctime;
-      smout->maxctime=sumin->maxctime;
-      smout->minmtime=sumin->minmtime;
-      smout->maxmtime=sumin->maxmtime;
-      smout->minatime=sumin->minatime;
-      smout->maxatime=sumin->maxatime;
-      smout->minblocks=sumin->minblocks;
-      smout->maxblocks=sumin->maxblocks;
-      smout->mincrtime=sumin->mincrtime;
-      smout->maxcrtime=sumin->maxcrtime;
-      smout->minossint1=sumin->minossint1;
-      smout->maxossint1=sumin->maxossint1;
-      smout->minossint2=sumin->minossint2;
-      smout->maxossint2=sumin->maxossint2;
-      smout->minossint3=sumin->minossint3;
-      smout->maxossint3=sumin->maxossint3;
-      smout->minossint4=sumin->minossint4;
-      smout->maxossint4=sumin->maxossint4;
+      memcpy(out_mins, in_mins, SUM_MINMAX_LANES * sizeof(long long int));
+      memcpy(out_maxs, in_maxs, SUM_MINMAX_LANES * sizeof(long long int));
       smout->setit=1;
     }
 
-  /* only set these mins and maxes if there are files in the directory
-     otherwise mins are all zero */
-  //if (sumin->totfiles > 0) {
-    if (sumin->minuid < smout->minuid) smout->minuid=sumin->minuid;
-    if (sumin->maxuid > smout->maxuid) smout->maxuid=sumin->maxuid;
-    if (sumin->mingid < smout->mingid) smout->mingid=sumin->mingid;
-    if (sumin->maxgid > smout->maxgid) smout->maxgid=sumin->maxgid;
-    if (sumin->minsize < smout->minsize) smout->minsize=sumin->minsize;
-    if (sumin->maxsize > smout->maxsize) smout->maxsize=sumin->maxsize;
-    if (sumin->minblocks < smout->minblocks) smout->minblocks=sumin->minblocks;
-    if (sumin->maxblocks > smout->maxblocks) smout->maxblocks=sumin->maxblocks;
-    if (sumin->minctime < smout->minctime) smout->minctime=sumin->minctime;
-    if (sumin->maxctime > smout->maxctime) smout->maxctime=sumin->maxctime;
-    if (sumin->minmtime < smout->minmtime) smout->minmtime=sumin->minmtime;
-    if (sumin->maxmtime > smout->maxmtime) smout->maxmtime=sumin->maxmtime;
-    if (sumin->minatime < smout->minatime) smout->minatime=sumin->minatime;
-    if (sumin->maxatime > smout->maxatime) smout->maxatime=sumin->maxatime;
-    if (sumin->mincrtime < smout->mincrtime) smout->mincrtime=sumin->mincrtime;
-    if (sumin->maxcrtime > smout->maxcrtime) smout->maxcrtime=sumin->maxcrtime;
-    if (sumin->minossint1 < smout->minossint1) smout->minossint1=sumin->minossint1;
-    if (sumin->maxossint1 > smout->maxossint1) smout->maxossint1=sumin->maxossint1;
-    if (sumin->minossint2 < smout->minossint2) smout->minossint2=sumin->minossint2;
-    if (sumin->maxossint2 > smout->maxossint2) smout->maxossint2=sumin->maxossint2;
-    if (sumin->minossint3 < smout->minossint3) smout->minossint3=sumin->minossint3;
-    if (sumin->maxossint3 > smout->maxossint3) smout->maxossint3=sumin->maxossint3;
-    if (sumin->minossint4 < smout->minossint4) smout->minossint4=sumin->minossint4;
-    if (sumin->maxossint4 > smout->maxossint4) smout->maxossint4=sumin->maxossint4;
+    minmax_lanes(out_mins, out_maxs, in_mins, in_maxs, SUM_MINMAX_LANES);
   }
 
-  smout->totltk     += sumin->totltk;
-  smout->totmtk     += sumin->totmtk;
-  smout->totltm     += sumin->totltm;
-  smout->totmtm     += sumin->totmtm;
-  smout->totmtg     += sumin->totmtg;
-  smout->totmtt     += sumin->totmtt;
-  smout->totsize    += sumin->totsize;
-  smout->totxattr   += sumin->totxattr;
-  smout->totossint1 += sumin->totossint1;
-  smout->totossint2 += sumin->totossint2;
-  smout->totossint3 += sumin->totossint3;
-  smout->totossint4 += sumin->totossint4;
+  /* totfiles through totossint4 */
+  add_lanes(SUM_LANES(smout, totfiles), SUM_LANES(sumin, totfiles), SUM_TOTAL_LANES);
 
+  /* sizehistfiles through agehistbytes */
+  add_lanes(smout->sizehistfiles, sumin->sizehistfiles, SUM_HIST_LANES);
+
+  return 0;
+}
+
+int tsumit (struct sum *sumin,struct sum *smout) {
+  pthread_mutex_lock(&sum_mutex);
+  const int rc = tsumit_unlocked(sumin, smout);
   pthread_mutex_unlock(&sum_mutex);
+  return rc;
+}
+
+int summerge (struct sum *sumin,struct sum *smout) {
+  /* unset lanes are LLONG_MAX/LLONG_MIN, so they do not change the result */
+  minmax_lanes(SUM_LANES(smout, minuid), SUM_LANES(smout, maxuid),
+               SUM_LANES(sumin, minuid), SUM_LANES(sumin, maxuid),
+               SUM_MINMAX_LANES);
+
+  /* totfiles through totossint4 */
+  add_lanes(SUM_LANES(smout, totfiles), SUM_LANES(sumin, totfiles), SUM_TOTAL_LANES);
+
+  /* sizehistfiles through agehistbytes */
+  add_lanes(smout->sizehistfiles, sumin->sizehistfiles, SUM_HIST_LANES);
+
+  if (sumin->setit) {
+    smout->setit=1;
+  }
 
   return 0;
 }
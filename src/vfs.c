@@ -0,0 +1,584 @@
+/*
+This file is part of GUFI, which is part of MarFS, which is released
+under the BSD license.
+
+
+Copyright (c) 2017, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2017, Los Alamos National Security, LLC All rights reserved.
+Copyright 2017. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "vfs.h"
+
+/* the VFS that everything not handled by the GUFI VFSs is passed to */
+static sqlite3_vfs * root_vfs(sqlite3_vfs * vfs) {
+    return (sqlite3_vfs *) vfs->pAppData;
+}
+
+/* ************************************************************** */
+/* in-memory database image                                       */
+
+struct mem_file {
+    sqlite3_file base;
+    const char * data;
+    sqlite3_int64 size;
+};
+
+static int mem_close(sqlite3_file * file) {
+    (void) file;
+    return SQLITE_OK;
+}
+
+static int mem_read(sqlite3_file * file, void * buf, int amt, sqlite3_int64 offset) {
+    struct mem_file * mf = (struct mem_file *) file;
+
+    if (offset >= mf->size) {
+        memset(buf, 0, amt);
+        return SQLITE_IOERR_SHORT_READ;
+    }
+
+    if (offset + amt > mf->size) {
+        const sqlite3_int64 avail = mf->size - offset;
+        memcpy(buf, mf->data + offset, avail);
+        memset((char *) buf + avail, 0, amt - avail);
+        return SQLITE_IOERR_SHORT_READ;
+    }
+
+    memcpy(buf, mf->data + offset, amt);
+    return SQLITE_OK;
+}
+
+static int mem_write(sqlite3_file * file, const void * buf, int amt, sqlite3_int64 offset) {
+    (void) file; (void) buf; (void) amt; (void) offset;
+    return SQLITE_READONLY;
+}
+
+static int mem_truncate(sqlite3_file * file, sqlite3_int64 size) {
+    (void) file; (void) size;
+    return SQLITE_READONLY;
+}
+
+static int mem_sync(sqlite3_file * file, int flags) {
+    (void) file; (void) flags;
+    return SQLITE_OK;
+}
+
+static int mem_file_size(sqlite3_file * file, sqlite3_int64 * size) {
+    *size = ((struct mem_file *) file)->size;
+    return SQLITE_OK;
+}
+
+/* nothing can modify the image, so there is no need to lock */
+static int mem_lock(sqlite3_file * file, int lock) {
+    (void) file; (void) lock;
+    return SQLITE_OK;
+}
+
+static int mem_check_reserved_lock(sqlite3_file * file, int * out) {
+    (void) file;
+    *out = 0;
+    return SQLITE_OK;
+}
+
+/* ask the kernel to start reading in the mapped pages backing the image */
+static int mem_willneed(struct mem_file * mf) {
+    if (!mf->size) {
+        return SQLITE_OK;
+    }
+
+    /* madvise requires a page aligned address */
+    const uintptr_t page = sysconf(_SC_PAGESIZE);
+    const uintptr_t start = ((uintptr_t) mf->data) & ~(page - 1);
+    const uintptr_t end = ((uintptr_t) mf->data) + mf->size;
+
+    return (madvise((void *) start, end - start, MADV_WILLNEED) == 0)?SQLITE_OK:SQLITE_IOERR;
+}
+
+static int mem_file_control(sqlite3_file * file, int op, void * arg) {
+    (void) arg;
+    if (op == GUFI_VFS_FCNTL_WILLNEED) {
+        return mem_willneed((struct mem_file *) file);
+    }
+    return SQLITE_NOTFOUND;
+}
+
+static int mem_sector_size(sqlite3_file * file) {
+    (void) file;
+    return 1024;
+}
+
+static int mem_device_characteristics(sqlite3_file * file) {
+    (void) file;
+    return SQLITE_IOCAP_IMMUTABLE;
+}
+
+/* pages can be used in place when memory mapped I/O is enabled */
+static int mem_fetch(sqlite3_file * file, sqlite3_int64 offset, int amt, void ** pp) {
+    struct mem_file * mf = (struct mem_file *) file;
+    *pp = (offset + amt <= mf->size)?(void *) (mf->data + offset):NULL;
+    return SQLITE_OK;
+}
+
+static int mem_unfetch(sqlite3_file * file, sqlite3_int64 offset, void * p) {
+    (void) file; (void) offset; (void) p;
+    return SQLITE_OK;
+}
+
+static const sqlite3_io_methods mem_io_methods = {
+    3,                              /* iVersion */
+    mem_close,                      /* xClose */
+    mem_read,                       /* xRead */
+    mem_write,                      /* xWrite */
+    mem_truncate,                   /* xTruncate */
+    mem_sync,                       /* xSync */
+    mem_file_size,                  /* xFileSize */
+    mem_lock,                       /* xLock */
+    mem_lock,                       /* xUnlock */
+    mem_check_reserved_lock,        /* xCheckReservedLock */
+    mem_file_control,               /* xFileControl */
+    mem_sector_size,                /* xSectorSize */
+    mem_device_characteristics,     /* xDeviceCharacteristics */
+    NULL,                           /* xShmMap */
+    NULL,                           /* xShmLock */
+    NULL,                           /* xShmBarrier */
+    NULL,                           /* xShmUnmap */
+    mem_fetch,                      /* xFetch */
+    mem_unfetch,                    /* xUnfetch */
+};
+
+static int mem_open(sqlite3_vfs * vfs, const char * name, sqlite3_file * file, int flags, int * out_flags) {
+    /* temporary files (sorting, etc.) go to the real filesystem */
+    if (!(flags & SQLITE_OPEN_MAIN_DB)) {
+        sqlite3_vfs * root = root_vfs(vfs);
+        return root->xOpen(root, name, file, flags, out_flags);
+    }
+
+    struct mem_file * mf = (struct mem_file *) file;
+    memset(mf, 0, sizeof(*mf));
+
+    mf->data = (const char *) (uintptr_t) sqlite3_uri_int64(name, "ptr", 0);
+    mf->size = sqlite3_uri_int64(name, "sz", -1);
+    if (!mf->data || (mf->size < 0)) {
+        return SQLITE_CANTOPEN;
+    }
+
+    mf->base.pMethods = &mem_io_methods;
+
+    if (out_flags) {
+        *out_flags = (flags & ~(SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE)) | SQLITE_OPEN_READONLY;
+    }
+
+    return SQLITE_OK;
+}
+
+static int mem_delete(sqlite3_vfs * vfs, const char * name, int sync_dir) {
+    sqlite3_vfs * root = root_vfs(vfs);
+    return root->xDelete(root, name, sync_dir);
+}
+
+/* the image is the only file - journals and WAL files never exist */
+static int mem_access(sqlite3_vfs * vfs, const char * name, int flags, int * out) {
+    (void) vfs; (void) name; (void) flags;
+    *out = 0;
+    return SQLITE_OK;
+}
+
+/* the name is only a label, so don't touch the filesystem */
+static int mem_full_pathname(sqlite3_vfs * vfs, const char * name, int size, char * out) {
+    (void) vfs;
+    sqlite3_snprintf(size, out, "%s", name);
+    return SQLITE_OK;
+}
+
+/* ************************************************************** */
+/* read-only database file loaded in as few system calls as possible */
+
+struct ro_file {
+    struct mem_file mem; /* must be first */
+    int mapped;
+    struct gufi_vfs_stats stats;
+};
+
+static int ro_close(sqlite3_file * file) {
+    struct ro_file * rf = (struct ro_file *) file;
+    if (rf->mapped) {
+        munmap((void *) rf->mem.data, rf->mem.size);
+    }
+    else {
+        free((void *) rf->mem.data);
+    }
+    return SQLITE_OK;
+}
+
+static int ro_file_control(sqlite3_file * file, int op, void * arg) {
+    struct ro_file * rf = (struct ro_file *) file;
+
+    if (op == GUFI_VFS_FCNTL_STATS) {
+        *(struct gufi_vfs_stats *) arg = rf->stats;
+        return SQLITE_OK;
+    }
+
+    if (op == GUFI_VFS_FCNTL_WILLNEED) {
+        /* copies are already resident */
+        if (!rf->mapped) {
+            return SQLITE_OK;
+        }
+
+        rf->stats.syscalls++;
+        return mem_willneed(&rf->mem);
+    }
+
+    return SQLITE_NOTFOUND;
+}
+
+static const sqlite3_io_methods ro_io_methods = {
+    3,                              /* iVersion */
+    ro_close,                       /* xClose */
+    mem_read,                       /* xRead */
+    mem_write,                      /* xWrite */
+    mem_truncate,                   /* xTruncate */
+    mem_sync,                       /* xSync */
+    mem_file_size,                  /* xFileSize */
+    mem_lock,                       /* xLock */
+    mem_lock,                       /* xUnlock */
+    mem_check_reserved_lock,        /* xCheckReservedLock */
+    ro_file_control,                /* xFileControl */
+    mem_sector_size,                /* xSectorSize */
+    mem_device_characteristics,     /* xDeviceCharacteristics */
+    NULL,                           /* xShmMap */
+    NULL,                           /* xShmLock */
+    NULL,                           /* xShmBarrier */
+    NULL,                           /* xShmUnmap */
+    mem_fetch,                      /* xFetch */
+    mem_unfetch,                    /* xUnfetch */
+};
+
+/* read the entire file with as few pread calls as possible */
+static int ro_load(struct ro_file * rf, const int fd) {
+    char * buf = malloc(rf->mem.size?rf->mem.size:1);
+    if (!buf) {
+        return SQLITE_NOMEM;
+    }
+
+    sqlite3_int64 got = 0;
+    while (got < rf->mem.size) {
+        const ssize_t rc = pread(fd, buf + got, rf->mem.size - got, got);
+        rf->stats.syscalls++;
+        if (rc < 1) {
+            free(buf);
+            return SQLITE_IOERR_READ;
+        }
+        got += rc;
+    }
+
+    rf->stats.bytes += got;
+    rf->mem.data = buf;
+    return SQLITE_OK;
+}
+
+/* map large files instead of copying them */
+static int ro_map(struct ro_file * rf, const int fd) {
+    void * addr = mmap(NULL, rf->mem.size, PROT_READ, MAP_SHARED, fd, 0);
+    rf->stats.syscalls++;
+    if (addr == MAP_FAILED) {
+        return SQLITE_IOERR_MMAP;
+    }
+
+    rf->stats.bytes += rf->mem.size;
+    rf->mem.data = addr;
+    rf->mapped = 1;
+    return SQLITE_OK;
+}
+
+static sqlite3_vfs ro_mmap_vfs;
+
+static int ro_open(sqlite3_vfs * vfs, const char * name, sqlite3_file * file, int flags, int * out_flags) {
+    /* temporary files and writable databases go to the real filesystem */
+    if (!(flags & SQLITE_OPEN_MAIN_DB) || !(flags & SQLITE_OPEN_READONLY)) {
+        sqlite3_vfs * root = root_vfs(vfs);
+        return root->xOpen(root, name, file, flags, out_flags);
+    }
+
+    struct ro_file * rf = (struct ro_file *) file;
+    memset(rf, 0, sizeof(*rf));
+
+    const int fd = open(name, O_RDONLY);
+    rf->stats.syscalls++;
+    if (fd < 0) {
+        return SQLITE_CANTOPEN;
+    }
+
+    struct stat st;
+    rf->stats.syscalls++;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return SQLITE_CANTOPEN;
+    }
+
+    rf->mem.size = st.st_size;
+
+    /* empty files can't be mapped */
+    const int map = rf->mem.size && ((vfs == &ro_mmap_vfs) || (rf->mem.size > GUFI_RO_VFS_READ_MAX));
+    const int rc = map?ro_map(rf, fd):ro_load(rf, fd);
+
+    /* the contents are in memory, so the descriptor is no longer needed */
+    close(fd);
+    rf->stats.syscalls++;
+
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+
+    rf->mem.base.pMethods = &ro_io_methods;
+
+    if (out_flags) {
+        *out_flags = flags;
+    }
+
+    return SQLITE_OK;
+}
+
+/* there are no journals or WAL files to look for since nothing writes to the database */
+static int ro_access(sqlite3_vfs * vfs, const char * name, int flags, int * out) {
+    (void) vfs; (void) name; (void) flags;
+    *out = 0;
+    return SQLITE_OK;
+}
+
+static int ro_full_pathname(sqlite3_vfs * vfs, const char * name, int size, char * out) {
+    sqlite3_vfs * root = root_vfs(vfs);
+    return root->xFullPathname(root, name, size, out);
+}
+
+/* ************************************************************** */
+/* functions that are passed on to the root VFS                   */
+
+static void * root_dlopen(sqlite3_vfs * vfs, const char * filename) {
+    sqlite3_vfs * root = root_vfs(vfs);
+    return root->xDlOpen(root, filename);
+}
+
+static void root_dlerror(sqlite3_vfs * vfs, int size, char * msg) {
+    sqlite3_vfs * root = root_vfs(vfs);
+    root->xDlError(root, size, msg);
+}
+
+static void (*root_dlsym(sqlite3_vfs * vfs, void * handle, const char * symbol))(void) {
+    sqlite3_vfs * root = root_vfs(vfs);
+    return root->xDlSym(root, handle, symbol);
+}
+
+static void root_dlclose(sqlite3_vfs * vfs, void * handle) {
+    sqlite3_vfs * root = root_vfs(vfs);
+    root->xDlClose(root, handle);
+}
+
+static int root_randomness(sqlite3_vfs * vfs, int size, char * out) {
+    sqlite3_vfs * root = root_vfs(vfs);
+    return root->xRandomness(root, size, out);
+}
+
+static int root_sleep(sqlite3_vfs * vfs, int microseconds) {
+    sqlite3_vfs * root = root_vfs(vfs);
+    return root->xSleep(root, microseconds);
+}
+
+static int root_current_time(sqlite3_vfs * vfs, double * now) {
+    sqlite3_vfs * root = root_vfs(vfs);
+    return root->xCurrentTime(root, now);
+}
+
+static int root_get_last_error(sqlite3_vfs * vfs, int size, char * msg) {
+    sqlite3_vfs * root = root_vfs(vfs);
+    return root->xGetLastError(root, size, msg);
+}
+
+static int root_current_time_int64(sqlite3_vfs * vfs, sqlite3_int64 * now) {
+    sqlite3_vfs * root = root_vfs(vfs);
+    return root->xCurrentTimeInt64(root, now);
+}
+
+static sqlite3_vfs mem_vfs = {
+    2,                              /* iVersion */
+    0,                              /* szOsFile (set at registration) */
+    0,                              /* mxPathname (set at registration) */
+    NULL,                           /* pNext */
+    GUFI_MEM_VFS,                   /* zName */
+    NULL,                           /* pAppData (root VFS) */
+    mem_open,                       /* xOpen */
+    mem_delete,                     /* xDelete */
+    mem_access,                     /* xAccess */
+    mem_full_pathname,              /* xFullPathname */
+    root_dlopen,                    /* xDlOpen */
+    root_dlerror,                   /* xDlError */
+    root_dlsym,                     /* xDlSym */
+    root_dlclose,                   /* xDlClose */
+    root_randomness,                /* xRandomness */
+    root_sleep,                     /* xSleep */
+    root_current_time,              /* xCurrentTime */
+    root_get_last_error,            /* xGetLastError */
+    root_current_time_int64,        /* xCurrentTimeInt64 */
+};
+
+static sqlite3_vfs ro_vfs = {
+    2,                              /* iVersion */
+    0,                              /* szOsFile (set at registration) */
+    0,                              /* mxPathname (set at registration) */
+    NULL,                           /* pNext */
+    GUFI_RO_VFS,                    /* zName */
+    NULL,                           /* pAppData (root VFS) */
+    ro_open,                        /* xOpen */
+    mem_delete,                     /* xDelete */
+    ro_access,                      /* xAccess */
+    ro_full_pathname,               /* xFullPathname */
+    root_dlopen,                    /* xDlOpen */
+    root_dlerror,                   /* xDlError */
+    root_dlsym,                     /* xDlSym */
+    root_dlclose,                   /* xDlClose */
+    root_randomness,                /* xRandomness */
+    root_sleep,                     /* xSleep */
+    root_current_time,              /* xCurrentTime */
+    root_get_last_error,            /* xGetLastError */
+    root_current_time_int64,        /* xCurrentTimeInt64 */
+};
+
+/* same as gufi-ro, but the file is always mapped instead of copied */
+static sqlite3_vfs ro_mmap_vfs = {
+    2,                              /* iVersion */
+    0,                              /* szOsFile (set at registration) */
+    0,                              /* mxPathname (set at registration) */
+    NULL,                           /* pNext */
+    GUFI_RO_MMAP_VFS,               /* zName */
+    NULL,                           /* pAppData (root VFS) */
+    ro_open,                        /* xOpen */
+    mem_delete,                     /* xDelete */
+    ro_access,                      /* xAccess */
+    ro_full_pathname,               /* xFullPathname */
+    root_dlopen,                    /* xDlOpen */
+    root_dlerror,                   /* xDlError */
+    root_dlsym,                     /* xDlSym */
+    root_dlclose,                   /* xDlClose */
+    root_randomness,                /* xRandomness */
+    root_sleep,                     /* xSleep */
+    root_current_time,              /* xCurrentTime */
+    root_get_last_error,            /* xGetLastError */
+    root_current_time_int64,        /* xCurrentTimeInt64 */
+};
+
+/* ************************************************************** */
+
+static pthread_once_t vfs_once = PTHREAD_ONCE_INIT;
+static int vfs_rc = SQLITE_ERROR;
+
+static void register_vfs() {
+    sqlite3_vfs * root = sqlite3_vfs_find(NULL);
+    if (!root) {
+        return;
+    }
+
+    /* delegated opens use the same sqlite3_file memory */
+    mem_vfs.szOsFile = (root->szOsFile > (int) sizeof(struct mem_file))?root->szOsFile:(int) sizeof(struct mem_file);
+    mem_vfs.mxPathname = root->mxPathname;
+    mem_vfs.pAppData = root;
+
+    ro_vfs.szOsFile = (root->szOsFile > (int) sizeof(struct ro_file))?root->szOsFile:(int) sizeof(struct ro_file);
+    ro_vfs.mxPathname = root->mxPathname;
+    ro_vfs.pAppData = root;
+
+    ro_mmap_vfs.szOsFile = ro_vfs.szOsFile;
+    ro_mmap_vfs.mxPathname = ro_vfs.mxPathname;
+    ro_mmap_vfs.pAppData = root;
+
+    if (((vfs_rc = sqlite3_vfs_register(&mem_vfs, 0)) != SQLITE_OK) ||
+        ((vfs_rc = sqlite3_vfs_register(&ro_vfs, 0))  != SQLITE_OK)) {
+        return;
+    }
+
+    vfs_rc = sqlite3_vfs_register(&ro_mmap_vfs, 0);
+}
+
+int gufi_vfs_init() {
+    pthread_once(&vfs_once, register_vfs);
+    return vfs_rc;
+}
+
+int gufi_mem_vfs_uri(char * uri, const size_t size, const char * name,
+                     const void * ptr, const sqlite3_int64 sz) {
+    const int len = snprintf(uri, size, "file:%s?vfs=" GUFI_MEM_VFS "&mode=ro&ptr=%lld&sz=%lld",
+                             name, (long long) (uintptr_t) ptr, (long long) sz);
+    return !((len > 0) && ((size_t) len < size));
+}
+
+int gufi_vfs_stats(sqlite3 * db, const char * schema, struct gufi_vfs_stats * stats) {
+    stats->bytes = 0;
+    stats->syscalls = 0;
+    return sqlite3_file_control(db, schema, GUFI_VFS_FCNTL_STATS, stats);
+}
+
+int gufi_vfs_willneed(sqlite3 * db, const char * schema) {
+    return sqlite3_file_control(db, schema, GUFI_VFS_FCNTL_WILLNEED, NULL);
+}
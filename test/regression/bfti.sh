@@ -0,0 +1,235 @@
+#!/usr/bin/env bash
+# This file is part of GUFI, which is part of MarFS, which is released
+# under the BSD license.
+#
+#
+# Copyright (c) 2017, Los Alamos National Security (LANS), LLC
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without modification,
+# are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice, this
+# list of conditions and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation and/or
+# other materials provided with the distribution.
+#
+# 3. Neither the name of the copyright holder nor the names of its contributors
+# may be used to endorse or promote products derived from this software without
+# specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+# WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+# IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+# INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+# BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+# LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+# OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+# ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+#
+# From Los Alamos National Security, LLC:
+# LA-CC-15-039
+#
+# Copyright (c) 2017, Los Alamos National Security, LLC All rights reserved.
+# Copyright 2017. Los Alamos National Security, LLC. This software was produced
+# under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+# Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+# the U.S. Department of Energy. The U.S. Government has rights to use,
+# reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+# ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+# ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+# modified to produce derivative works, such modified software should be
+# clearly marked, so as not to confuse it with the version available from
+# LANL.
+#
+# THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+# THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+# OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+# IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+# OF SUCH DAMAGE.
+
+
+
+set -e
+
+ROOT="$(realpath ${BASH_SOURCE[0]})"
+ROOT="$(dirname ${ROOT})"
+ROOT="$(dirname ${ROOT})"
+ROOT="$(dirname ${ROOT})"
+
+BFTI="${ROOT}/src/bfti"
+GUFI_DIR2INDEX="${ROOT}/src/gufi_dir2index"
+GUFI_QUERY="${ROOT}/src/gufi_query"
+
+# output directories
+SRCDIR="prefix"
+INDEXROOT="${SRCDIR}.gufi"
+SUBINDEX="${SRCDIR}.subdirectory.gufi"
+ROLLUPS="bfti.rollups"
+BAD_ROLLUPS="bfti.bad.rollups"
+
+source ${ROOT}/test/regression/setup.sh "${ROOT}" "${SRCDIR}" "${INDEXROOT}"
+
+function cleanup {
+    rm -rf "${SUBINDEX}" "${ROLLUPS}" "${BAD_ROLLUPS}"
+}
+
+trap cleanup EXIT
+
+cleanup
+
+OUTPUT="bfti.out"
+
+function replace() {
+    echo "$@" | sed "s/${BFTI//\//\\/}/bfti/g; s/${GUFI_DIR2INDEX//\//\\/}/gufi_dir2index/g; s/${GUFI_QUERY//\//\\/}/gufi_query/g; s/${INDEXROOT//\//\\/}/./g; s/[[:space:]]*$//g"
+}
+
+# print the results of a query on every directory's database
+function query() {
+    output=$(${GUFI_QUERY} -n 1 -d " " -S "$1" "${INDEXROOT}")
+    replace "${output}" | sort
+}
+
+# the tables that bfti writes, with every column
+function tables() {
+    query "SELECT path(), * FROM treesummary"
+    query "SELECT path(), * FROM treesummaryhist"
+    query "SELECT path(), * FROM rollup_sizes"
+    query "SELECT path(), * FROM rollup_files"
+}
+
+# the parts of the tables that do not depend on when and where the tree was generated
+function report() {
+    echo "Tree summaries (subdirectories, files, links, size):"
+    query "SELECT path(), totsubdirs, totfiles, totlinks, totsize FROM treesummary" | awk '{ printf "    " $0 "\n" }'
+    echo
+    echo "Size histogram of the index (low, high, files, bytes):"
+    output=$(${GUFI_QUERY} -n 1 -d " " -T "SELECT low, high, files, bytes FROM treesummaryhist WHERE kind == 'size' ORDER BY bucket ASC" -y 0 -z 0 "${INDEXROOT}")
+    replace "${output}" | awk '{ printf "    " $0 "\n" }'
+    echo
+    echo "rollup_sizes (size, files):"
+    query "SELECT path(), * FROM rollup_sizes" | awk '{ printf "    " $0 "\n" }'
+    echo
+    echo "rollup_files (largest file, total size):"
+    query "SELECT path(), * FROM rollup_files" | awk '{ printf "    " $0 "\n" }'
+    echo
+}
+
+cat > "${ROLLUPS}" << ROLLUPS_EOF
+# number of files of each size
+
+sizes key,sum SELECT size, 1 FROM entries WHERE type == 'f'
+files max,sum SELECT max(size), sum(size) FROM entries WHERE type == 'f'
+ROLLUPS_EOF
+
+(
+echo "# Rollups file:"
+cat "${ROLLUPS}"
+echo
+
+echo "# Summarize the whole index"
+replace "$ ${BFTI} -n 2 -s -L ${ROLLUPS} ${INDEXROOT}"
+${BFTI} -n 2 -s -L "${ROLLUPS}" "${INDEXROOT}" > /dev/null
+report
+
+echo "# Add a 2048 byte file to directory/subdirectory and reindex only that directory"
+head -c 2048 /dev/zero > "${SRCDIR}/directory/subdirectory/2KB"
+replace "$ ${GUFI_DIR2INDEX} -x ${SRCDIR}/directory/subdirectory ${SUBINDEX}"
+${GUFI_DIR2INDEX} -x "${SRCDIR}/directory/subdirectory" "${SUBINDEX}"
+cp "${SUBINDEX}/db.db" "${INDEXROOT}/directory/subdirectory/db.db"
+echo
+
+echo "# Summarize only the changed directory and its ancestors"
+replace "$ ${BFTI} -n 2 -s -L ${ROLLUPS} ${INDEXROOT} ./directory/subdirectory/"
+${BFTI} -n 2 -s -L "${ROLLUPS}" "${INDEXROOT}" ./directory/subdirectory/ > /dev/null
+report
+incremental=$(tables)
+
+echo "# Summarize the whole index again"
+replace "$ ${BFTI} -n 2 -s -L ${ROLLUPS} ${INDEXROOT}"
+${BFTI} -n 2 -s -L "${ROLLUPS}" "${INDEXROOT}" > /dev/null
+full=$(tables)
+if [[ "${incremental}" == "${full}" ]]
+then
+    echo "treesummary, treesummaryhist, and rollup tables are the same as after the incremental summary"
+else
+    echo "treesummary, treesummaryhist, and rollup tables are different from after the incremental summary:"
+    diff <(echo "${incremental}") <(echo "${full}") || true
+fi
+echo
+
+echo "# Remove leaf_directory/leaf_file2 from the index without listing leaf_directory as changed"
+replace "$ ${GUFI_QUERY} -w -E \"DELETE FROM entries WHERE name == 'leaf_file2'\" ${INDEXROOT}/leaf_directory"
+${GUFI_QUERY} -w -E "DELETE FROM entries WHERE name == 'leaf_file2'" "${INDEXROOT}/leaf_directory"
+echo
+
+echo "# Summarize only directory, which reuses the rollups of leaf_directory"
+replace "$ ${BFTI} -n 2 -s -L ${ROLLUPS} ${INDEXROOT} directory"
+${BFTI} -n 2 -s -L "${ROLLUPS}" "${INDEXROOT}" directory > /dev/null
+echo "rollup_files (largest file, total size):"
+query "SELECT path(), * FROM rollup_files" | awk '{ printf "    " $0 "\n" }'
+echo
+
+echo "# Summarize the whole index, which picks up the removed file"
+replace "$ ${BFTI} -n 2 -s -L ${ROLLUPS} ${INDEXROOT}"
+${BFTI} -n 2 -s -L "${ROLLUPS}" "${INDEXROOT}" > /dev/null
+echo "rollup_files (largest file, total size):"
+query "SELECT path(), * FROM rollup_files" | awk '{ printf "    " $0 "\n" }'
+echo
+
+echo "# Every treesummary covers all of the summaries under its directory, no matter how many threads build them"
+for threads in 1 4
+do
+    replace "$ ${BFTI} -n ${threads} -s -L ${ROLLUPS} ${INDEXROOT}"
+    ${BFTI} -n "${threads}" -s -L "${ROLLUPS}" "${INDEXROOT}" > /dev/null
+    built=$(query "SELECT path(), totsubdirs, totfiles, totlinks, totsize FROM treesummary")
+    expected=$(
+        while IFS= read -r dir
+        do
+            output=$(${GUFI_QUERY} -n 1 -d " " -S "SELECT totfiles, totlinks, totsize FROM summary" "${dir}" | \
+                         awk '{ dirs += 1; files += $1; links += $2; size += $3 } END { print dirs, files, links, size }')
+            replace "${dir} ${output}"
+        done < <(find "${INDEXROOT}" -type d) | sort
+    )
+    if [[ "${built}" == "${expected}" ]]
+    then
+        echo "treesummary is the same as the sum of the summaries of every subtree"
+    else
+        echo "treesummary is different from the sum of the summaries of every subtree:"
+        diff <(echo "${expected}") <(echo "${built}") || true
+    fi
+done
+echo
+
+echo "# Reject bad rollups"
+while IFS= read -r line
+do
+    echo "${line}" > "${BAD_ROLLUPS}"
+    echo "Rollups file: ${line}"
+    replace "$ ${BFTI} -s -L ${BAD_ROLLUPS} ${INDEXROOT}"
+    ${BFTI} -s -L "${BAD_ROLLUPS}" "${INDEXROOT}" || echo "bfti exited with ${?}"
+    echo
+done << BAD_EOF
+nospec
+bad,name sum SELECT size FROM entries
+unknown median SELECT size FROM entries
+files count SELECT 1 FROM entries
+nosql sum
+columns sum,sum SELECT size FROM entries
+badsql sum SELECT nosuchcolumn FROM entries
+BAD_EOF
+) 2>&1 | tee "${OUTPUT}"
+
+diff -b ${ROOT}/test/regression/bfti.expected "${OUTPUT}"
+rm "${OUTPUT}"
@@ -144,5 +144,39 @@ do
     ) 2>&1 | tee -a "${OUTPUT}"
 done
 
+# put at most 2 entries into each database
+(
+    # remove preexisting indicies
+    rm -rf "${INDEXROOT}"
+
+    # generate the index
+    ${GUFI_DIR2INDEX} -x --shard-entries 2 "${SRCDIR}" "${INDEXROOT}"
+
+    src_dirs=$(find "${SRCDIR}" -type d)
+    src_nondirs=$(find "${SRCDIR}" -not -type d)
+    src=$((echo "${src_dirs}"; echo "${src_nondirs}") | sort)
+
+    index_dirs=$(find "${INDEXROOT}" -type d | sed "s/${INDEXROOT}/${SRCDIR}/g; s/[[:space:]]*$//g")
+    index_nondirs=$(${GUFI_QUERY} -d " " -E "SELECT path() || '/' || name FROM pentries" "${INDEXROOT}" | sed "s/${INDEXROOT}/${SRCDIR}/g; s/[[:space:]]*$//g")
+    index=$((echo "${index_dirs}"; echo "${index_nondirs}") | sort)
+
+    summary=$(${GUFI_QUERY} -d " " -S "SELECT path(), totfiles, totlinks, totsize FROM summary" "${INDEXROOT}" | sed "s/${INDEXROOT}/${SRCDIR}/g; s/[[:space:]]*$//g" | sort)
+    databases=$(find "${INDEXROOT}" -name "db.db*" | sed "s/${INDEXROOT}/${SRCDIR}/g" | sort)
+
+    echo "Index Everything With At Most 2 Entries Per Database:"
+    echo "    Source Directory:"
+    echo "${src}" | awk '{ printf "        " $0 "\n" }'
+    echo
+    echo "    GUFI Index:"
+    echo "${index}" | awk '{ printf "        " $0 "\n" }'
+    echo
+    echo "    Summaries (files, links, size):"
+    echo "${summary}" | awk '{ printf "        " $0 "\n" }'
+    echo
+    echo "    Databases:"
+    echo "${databases}" | awk '{ printf "        " $0 "\n" }'
+    echo
+) 2>&1 | tee -a "${OUTPUT}"
+
 diff ${ROOT}/test/regression/gufi_dir2index.expected "${OUTPUT}"
 rm "${OUTPUT}"
@@ -107,6 +107,9 @@ run "${GUFI_FIND} -type f -size +1c"
 run "${GUFI_FIND} -type f -size +1024c"
 run "${GUFI_FIND} -type f -size +1 -size=-3" # 512 < size < 1536
 run "${GUFI_FIND} -type f -size 2048"        # 512 * 2048 = 1MB
+replace "$ ${GUFI_FIND} -type f -maxresults 2 | wc -l"
+${GUFI_FIND} -type f -maxresults 2 | wc -l
+echo
 ) 2>&1 | tee "${OUTPUT}"
 
 diff ${ROOT}/test/regression/gufi_find.expected "${OUTPUT}"
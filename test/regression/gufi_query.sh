@@ -70,6 +70,7 @@ ROOT="$(dirname ${ROOT})"
 ROOT="$(dirname ${ROOT})"
 
 GUFI_QUERY="${ROOT}/src/gufi_query"
+BFTI="${ROOT}/src/bfti"
 
 # output directories
 SRCDIR="prefix"
@@ -80,7 +81,7 @@ source ${ROOT}/test/regression/setup.sh "${ROOT}" "${SRCDIR}" "${INDEXROOT}"
 OUTPUT="gufi_query.out"
 
 function replace() {
-    echo "$@" | sed "s/[[:space:]]*$//g; s/${GUFI_QUERY//\//\\/}/gufi_query/g; s/${INDEXROOT//\//\\/}\\///g; s/\\/${SRCDIR//\//\\/}/./g"
+    echo "$@" | sed "s/[[:space:]]*$//g; s/${GUFI_QUERY//\//\\/}/gufi_query/g; s/${BFTI//\//\\/}/bfti/g; s/${INDEXROOT//\//\\/}\\///g; s/\\/${SRCDIR//\//\\/}/./g"
 }
 
 (
@@ -104,6 +105,74 @@ output=$(${GUFI_QUERY} -d " " -S "SELECT name FROM summary" -E "SELECT name FROM
 replace "${output}"
 echo
 
+echo "# Get all directory and non-directory names only, reading subdirectories from the subdirs table"
+replace "$ ${GUFI_QUERY} -d \" \" -l -S \"SELECT name FROM summary\" -E \"SELECT name FROM entries\" ${INDEXROOT}"
+output=$(${GUFI_QUERY} -d " " -l -S "SELECT name FROM summary" -E "SELECT name FROM entries" ${INDEXROOT} | sort)
+replace "${output}"
+echo
+
+echo "# Get all directory and non-directory names, prefetching subdirectory databases"
+replace "$ ${GUFI_QUERY} -d \" \" -q 4 -S \"SELECT name FROM summary\" -E \"SELECT name FROM entries\" ${INDEXROOT}"
+output=$(${GUFI_QUERY} -d " " -q 4 -S "SELECT name FROM summary" -E "SELECT name FROM entries" ${INDEXROOT} | sort)
+replace "${output}"
+echo
+
+echo "# Get all directory and non-directory names, reading memory-mapped databases"
+replace "$ ${GUFI_QUERY} -d \" \" -e 0 -a -M 1048576 -I \"CREATE TABLE out(name TEXT)\" -S \"INSERT INTO out SELECT name FROM summary\" -E \"INSERT INTO out SELECT name FROM entries\" -J \"INSERT INTO aggregate.out SELECT * FROM out\" -G \"SELECT name FROM out ORDER BY name ASC\" ${INDEXROOT}"
+output=$(${GUFI_QUERY} -d " " -e 0 -a -M 1048576 -I "CREATE TABLE out(name TEXT)" -S "INSERT INTO out SELECT name FROM summary" -E "INSERT INTO out SELECT name FROM entries" -J "INSERT INTO aggregate.out SELECT * FROM out" -G "SELECT name FROM out ORDER BY name ASC" ${INDEXROOT})
+replace "${output}"
+echo
+
+echo "# Count and sum the sizes of files smaller and not smaller than 1KB without materializing the rows"
+replace "$ ${GUFI_QUERY} -d \" \" -U \"key,count,sum,max\" -E \"SELECT size >= 1024, name, size, size FROM entries WHERE type == 'f'\" ${INDEXROOT}"
+output=$(${GUFI_QUERY} -d " " -U "key,count,sum,max" -E "SELECT size >= 1024, name, size, size FROM entries WHERE type == 'f'" ${INDEXROOT})
+replace "${output}"
+echo
+
+echo "# Get the 2 largest files, skipping directories whose largest file is too small"
+replace "$ ${GUFI_QUERY} -d \" \" -k 2:maxsize -E \"SELECT size, name FROM entries WHERE type == 'f'\" ${INDEXROOT}"
+output=$(${GUFI_QUERY} -d " " -k 2:maxsize -E "SELECT size, name FROM entries WHERE type == 'f'" ${INDEXROOT})
+replace "${output}"
+echo
+
+echo "# Get files of at least 1KB, skipping directories whose files are all smaller"
+replace "$ ${GUFI_QUERY} -d \" \" -X \"size>=1024\" -E \"SELECT name, size FROM entries WHERE size >= 1024\" ${INDEXROOT}"
+output=$(${GUFI_QUERY} -d " " -X "size>=1024" -E "SELECT name, size FROM entries WHERE size >= 1024" ${INDEXROOT} | sort)
+replace "${output}"
+echo
+
+echo "# Get files of at least 1KB twice, reusing the cached rows of every directory the second time"
+CACHE="gufi_query.cache"
+rm -f "${CACHE}" "${CACHE}-wal" "${CACHE}-shm"
+replace "$ ${GUFI_QUERY} -d \" \" -Q ${CACHE} -E \"SELECT name, size FROM entries WHERE size >= 1024\" ${INDEXROOT}"
+${GUFI_QUERY} -d " " -Q "${CACHE}" -E "SELECT name, size FROM entries WHERE size >= 1024" ${INDEXROOT} > /dev/null 2>&1
+output=$(${GUFI_QUERY} -d " " -Q "${CACHE}" -E "SELECT name, size FROM entries WHERE size >= 1024" ${INDEXROOT} 2>&1 | sort)
+rm -f "${CACHE}" "${CACHE}-wal" "${CACHE}-shm"
+replace "${output}"
+echo
+
+echo "# Directories processed inline can't be cached"
+replace "$ ${GUFI_QUERY} -d \" \" -Q ${CACHE} --max-queued 1 -E \"SELECT name, size FROM entries WHERE size >= 1024\" ${INDEXROOT}"
+${GUFI_QUERY} -d " " -Q "${CACHE}" --max-queued 1 -E "SELECT name, size FROM entries WHERE size >= 1024" ${INDEXROOT} 2>&1 | head -n 1
+rm -f "${CACHE}" "${CACHE}-wal" "${CACHE}-shm"
+echo
+
+echo "# Get relative paths of all non-directories, querying each entries table in ranges of 2 rowids"
+replace "$ ${GUFI_QUERY} -d \" \" --split-entries 2 -E \"SELECT path() || '/' || name FROM entries\" ${INDEXROOT}"
+output=$(${GUFI_QUERY} -d " " --split-entries 2 -E "SELECT path() || '/' || name FROM entries" ${INDEXROOT} | sort)
+replace "${output}" | sed "s/${INDEXROOT//\//\\/}/./g"
+echo
+
+echo "# Count the rows printed when stopping after 3 non-directories"
+replace "$ ${GUFI_QUERY} -d \" \" --max-results 3 -E \"SELECT path() || '/' || name FROM entries\" ${INDEXROOT} | wc -l"
+${GUFI_QUERY} -d " " --max-results 3 -E "SELECT path() || '/' || name FROM entries" ${INDEXROOT} | wc -l
+echo
+
+echo "# Interrupt a query that never finishes after 1 second, dropping the directories that are still queued"
+replace "$ ${GUFI_QUERY} -n 1 --timeout 1 -E \"WITH RECURSIVE r(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM r) SELECT COUNT(*) FROM r\" ${INDEXROOT}"
+${GUFI_QUERY} -n 1 --timeout 1 -E "WITH RECURSIVE r(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM r) SELECT COUNT(*) FROM r" ${INDEXROOT} 2>&1 || echo "exit status: $?"
+echo
+
 echo "# Get relative paths of all directories and non-directories ascending names"
 replace "$ ${GUFI_QUERY} -d \" \" -e 0 -a -I \"CREATE TABLE out(name TEXT)\" -S \"INSERT INTO out SELECT path() FROM summary\" -E \"INSERT INTO out SELECT path() || '/' || name FROM entries\" -J \"INSERT INTO aggregate.out SELECT * FROM out\" -G \"SELECT name FROM out ORDER BY name ASC\" ${INDEXROOT}"
 output=$(${GUFI_QUERY} -d " " -e 0 -a -I "CREATE TABLE out(name TEXT)" -S "INSERT INTO out SELECT path() FROM summary" -E "INSERT INTO out SELECT path() || '/' || name FROM entries" -J "INSERT INTO aggregate.out SELECT * FROM out" -G "SELECT name FROM out ORDER BY name ASC" ${INDEXROOT})
@@ -128,6 +197,38 @@ output=$(${GUFI_QUERY} -d " " -e 0 -a -I "CREATE TABLE out(name TEXT, size INT64
 replace "${output}"
 echo
 
+echo "# Aggregate with 4 threads into -K tables that rows can be appended to, the same as with 1 thread"
+replace "$ ${GUFI_QUERY} -d \" \" -n 4 -e 0 -a -I \"CREATE TABLE out(type TEXT, name TEXT)\" -E \"INSERT INTO out SELECT type, name FROM entries\" -K \"CREATE TABLE agg(type TEXT, name TEXT)\" -J \"INSERT INTO aggregate.agg SELECT * FROM out\" -G \"SELECT type, name FROM agg ORDER BY name ASC\" ${INDEXROOT}"
+serial=$(${GUFI_QUERY} -d " " -n 1 -e 0 -a -I "CREATE TABLE out(type TEXT, name TEXT)" -E "INSERT INTO out SELECT type, name FROM entries" -K "CREATE TABLE agg(type TEXT, name TEXT)" -J "INSERT INTO aggregate.agg SELECT * FROM out" -G "SELECT type, name FROM agg ORDER BY name ASC" ${INDEXROOT})
+output=$(${GUFI_QUERY} -d " " -n 4 -e 0 -a -I "CREATE TABLE out(type TEXT, name TEXT)" -E "INSERT INTO out SELECT type, name FROM entries" -K "CREATE TABLE agg(type TEXT, name TEXT)" -J "INSERT INTO aggregate.agg SELECT * FROM out" -G "SELECT type, name FROM agg ORDER BY name ASC" ${INDEXROOT})
+replace "${output}"
+[[ "${output}" == "${serial}" ]] && echo "(same as -n 1)"
+echo
+
+echo "# Aggregate with 4 threads into a -K table with an INTEGER PRIMARY KEY, the same as with 1 thread"
+replace "$ ${GUFI_QUERY} -d \" \" -n 4 -e 0 -a -I \"CREATE TABLE out(name TEXT)\" -E \"INSERT INTO out SELECT name FROM entries\" -K \"CREATE TABLE agg(id INTEGER PRIMARY KEY, name TEXT)\" -J \"INSERT INTO aggregate.agg (name) SELECT name FROM out\" -G \"SELECT COUNT(*), COUNT(DISTINCT id), MAX(id) FROM agg\" ${INDEXROOT}"
+serial=$(${GUFI_QUERY} -d " " -n 1 -e 0 -a -I "CREATE TABLE out(name TEXT)" -E "INSERT INTO out SELECT name FROM entries" -K "CREATE TABLE agg(id INTEGER PRIMARY KEY, name TEXT)" -J "INSERT INTO aggregate.agg (name) SELECT name FROM out" -G "SELECT COUNT(*), COUNT(DISTINCT id), MAX(id) FROM agg" ${INDEXROOT})
+output=$(${GUFI_QUERY} -d " " -n 4 -e 0 -a -I "CREATE TABLE out(name TEXT)" -E "INSERT INTO out SELECT name FROM entries" -K "CREATE TABLE agg(id INTEGER PRIMARY KEY, name TEXT)" -J "INSERT INTO aggregate.agg (name) SELECT name FROM out" -G "SELECT COUNT(*), COUNT(DISTINCT id), MAX(id) FROM agg" ${INDEXROOT})
+replace "${output}"
+[[ "${output}" == "${serial}" ]] && echo "(same as -n 1)"
+echo
+
+echo "# Aggregate with 4 threads with -J upserting into a -K table, the same as with 1 thread"
+replace "$ ${GUFI_QUERY} -d \" \" -n 4 -e 0 -a -I \"CREATE TABLE out(type TEXT)\" -E \"INSERT INTO out SELECT type FROM entries\" -K \"CREATE TABLE counts(type TEXT PRIMARY KEY, n INT64)\" -J \"INSERT INTO aggregate.counts SELECT type, COUNT(*) FROM out WHERE true GROUP BY type ON CONFLICT(type) DO UPDATE SET n = n + excluded.n\" -G \"SELECT type, n FROM counts ORDER BY type ASC\" ${INDEXROOT}"
+serial=$(${GUFI_QUERY} -d " " -n 1 -e 0 -a -I "CREATE TABLE out(type TEXT)" -E "INSERT INTO out SELECT type FROM entries" -K "CREATE TABLE counts(type TEXT PRIMARY KEY, n INT64)" -J "INSERT INTO aggregate.counts SELECT type, COUNT(*) FROM out WHERE true GROUP BY type ON CONFLICT(type) DO UPDATE SET n = n + excluded.n" -G "SELECT type, n FROM counts ORDER BY type ASC" ${INDEXROOT})
+output=$(${GUFI_QUERY} -d " " -n 4 -e 0 -a -I "CREATE TABLE out(type TEXT)" -E "INSERT INTO out SELECT type FROM entries" -K "CREATE TABLE counts(type TEXT PRIMARY KEY, n INT64)" -J "INSERT INTO aggregate.counts SELECT type, COUNT(*) FROM out WHERE true GROUP BY type ON CONFLICT(type) DO UPDATE SET n = n + excluded.n" -G "SELECT type, n FROM counts ORDER BY type ASC" ${INDEXROOT})
+replace "${output}"
+[[ "${output}" == "${serial}" ]] && echo "(same as -n 1)"
+echo
+
+echo "# Get the number of files and links under each directory from its treesummary table"
+replace "$ ${BFTI} -s ${INDEXROOT}"
+${BFTI} -s ${INDEXROOT} > /dev/null
+replace "$ ${GUFI_QUERY} -d \" \" -T \"SELECT totfiles, totlinks FROM treesummary\" ${INDEXROOT}"
+output=$(${GUFI_QUERY} -d " " -T "SELECT totfiles, totlinks FROM treesummary" ${INDEXROOT} | sort -n)
+replace "${output}"
+echo
+
 ) 2>&1 | tee "${OUTPUT}"
 
 diff -b ${ROOT}/test/regression/gufi_query.expected "${OUTPUT}"
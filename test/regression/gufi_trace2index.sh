@@ -125,6 +125,62 @@ echo "GUFI Index:"
 echo "${index_contents}" | awk '{ printf "    " $0 "\n" }'
 echo
 
+# without --subdirs, the databases have no subdirs table, so -l falls back to readdir
+index_contents_l=$(${ROOT}/src/gufi_query -d " " -l -S "SELECT path() FROM summary" -E "SELECT path() || '/' || name FROM entries" "${INDEXROOT}" | sed "s/${INDEXROOT}/${SRCDIR}/g; s/^[[:space:]]*//g; s/[[:space:]]*$//g; s/\\/\\//\\//g" | sort)
+if [[ "${index_contents_l}" == "${index_contents}" ]]; then
+    echo "gufi_query -l finds the same contents"
+else
+    echo "gufi_query -l found different contents:"
+    echo "${index_contents_l}" | awk '{ printf "    " $0 "\n" }'
+fi
+echo
+
+# generate the index again, recording the subdirectories of each directory
+rm -rf "${INDEXROOT}"
+replace "$ ${GUFI_TRACE2INDEX} -d \"${DELIM}\" --subdirs \"${TRACE}\" \"${INDEXROOT}\""
+${GUFI_TRACE2INDEX} -d "${DELIM}" --subdirs "${TRACE}" "${INDEXROOT}" 2>&1 | sed '1,2d'
+echo
+
+subdirs=$(${ROOT}/src/gufi_query -d " " -S "SELECT path() || '/' || name FROM subdirs" "${INDEXROOT}" | sed "s/${INDEXROOT}/${SRCDIR}/g; s/[[:space:]]*$//g" | sort)
+index_contents_l=$(${ROOT}/src/gufi_query -d " " -l -S "SELECT path() FROM summary" -E "SELECT path() || '/' || name FROM entries" "${INDEXROOT}" | sed "s/${INDEXROOT}/${SRCDIR}/g; s/^[[:space:]]*//g; s/[[:space:]]*$//g; s/\\/\\//\\//g" | sort)
+
+echo "Subdirectories:"
+echo "${subdirs}" | awk '{ printf "    " $0 "\n" }'
+echo
+if [[ "${index_contents_l}" == "${index_contents}" ]]; then
+    echo "gufi_query -l finds the same contents"
+else
+    echo "gufi_query -l found different contents:"
+    echo "${index_contents_l}" | awk '{ printf "    " $0 "\n" }'
+fi
+echo
+
+# generate the index again, with at most 2 entries in each database
+rm -rf "${INDEXROOT}"
+replace "$ ${GUFI_TRACE2INDEX} -d \"${DELIM}\" --shard-entries 2 --subdirs \"${TRACE}\" \"${INDEXROOT}\""
+${GUFI_TRACE2INDEX} -d "${DELIM}" --shard-entries 2 --subdirs "${TRACE}" "${INDEXROOT}" 2>&1 | sed '1,2d'
+echo
+
+index_contents=$(${ROOT}/src/gufi_query -d " " -S "SELECT path() FROM summary" -E "SELECT path() || '/' || name FROM entries" "${INDEXROOT}" | sed "s/${INDEXROOT}/${SRCDIR}/g; s/^[[:space:]]*//g; s/[[:space:]]*$//g; s/\\/\\//\\//g" | sort)
+summary=$(${ROOT}/src/gufi_query -d " " -S "SELECT path(), totfiles, totlinks, totsize FROM summary" "${INDEXROOT}" | sed "s/${INDEXROOT}/${SRCDIR}/g; s/[[:space:]]*$//g" | sort)
+
+echo "GUFI Index:"
+echo "${index_contents}" | awk '{ printf "    " $0 "\n" }'
+echo
+echo "Summaries (files, links, size):"
+echo "${summary}" | awk '{ printf "    " $0 "\n" }'
+echo
+
+# read the subdirs and shards tables while processing every directory and shard inline
+index_contents_l=$(${ROOT}/src/gufi_query -d " " -n 1 --max-queued 1 -l -S "SELECT path() FROM summary" -E "SELECT path() || '/' || name FROM entries" "${INDEXROOT}" 2> /dev/null | sed "s/${INDEXROOT}/${SRCDIR}/g; s/^[[:space:]]*//g; s/[[:space:]]*$//g; s/\\/\\//\\//g" | sort)
+if [[ "${index_contents_l}" == "${index_contents}" ]]; then
+    echo "gufi_query -n 1 --max-queued 1 -l finds the same contents"
+else
+    echo "gufi_query -n 1 --max-queued 1 -l found different contents:"
+    echo "${index_contents_l}" | awk '{ printf "    " $0 "\n" }'
+fi
+echo
+
 ) 2>&1 | tee "${OUTPUT}"
 
 diff ${ROOT}/test/regression/gufi_trace2index.expected "${OUTPUT}"
@@ -0,0 +1,110 @@
+/*
+This file is part of GUFI, which is part of MarFS, which is released
+under the BSD license.
+
+
+Copyright (c) 2017, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2017, Los Alamos National Security, LLC All rights reserved.
+Copyright 2017. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+
+
+#include <cstring>
+
+#include <gtest/gtest.h>
+
+#include "OwnerFilter.h"
+
+TEST(OwnerFilter, contains) {
+    unsigned char filter[OWNER_FILTER_BYTES];
+    memset(filter, 0, sizeof(filter));
+
+    for(long long id = 0; id < 1000; id += 10) {
+        EXPECT_EQ(OwnerFilter_contains(filter, sizeof(filter), id), 0);
+        OwnerFilter_add(filter, id);
+    }
+
+    // no false negatives
+    for(long long id = 0; id < 1000; id += 10) {
+        EXPECT_EQ(OwnerFilter_contains(filter, sizeof(filter), id), 1);
+    }
+
+    // some false positives, but not many
+    int false_positives = 0;
+    for(long long id = 100000; id < 110000; id++) {
+        false_positives += OwnerFilter_contains(filter, sizeof(filter), id);
+    }
+    EXPECT_LT(false_positives, 100);
+
+    // unknown filters contain everything
+    EXPECT_EQ(OwnerFilter_contains(nullptr, sizeof(filter), 1), 1);
+    EXPECT_EQ(OwnerFilter_contains(filter, sizeof(filter) - 1, 1), 1);
+}
+
+TEST(OwnerFilter, merge) {
+    unsigned char lhs[OWNER_FILTER_BYTES];
+    unsigned char rhs[OWNER_FILTER_BYTES];
+    memset(lhs, 0, sizeof(lhs));
+    memset(rhs, 0, sizeof(rhs));
+
+    OwnerFilter_add(lhs, 1);
+    OwnerFilter_add(rhs, 2);
+    OwnerFilter_merge(lhs, rhs);
+
+    EXPECT_EQ(OwnerFilter_contains(lhs, sizeof(lhs), 1), 1);
+    EXPECT_EQ(OwnerFilter_contains(lhs, sizeof(lhs), 2), 1);
+    EXPECT_EQ(OwnerFilter_contains(rhs, sizeof(rhs), 1), 0);
+}
@@ -62,6 +62,8 @@ OF SUCH DAMAGE.
 
 
 
+#include <string>
+
 #include <gtest/gtest.h>
 
 #include "QueuePerThreadPool.h"
@@ -315,3 +317,408 @@ TEST(QueuePerThreadPool, threads_completed) {
 
     QPTPool_destroy(pool);
 }
+
+struct tree_work {
+    size_t depth;
+};
+
+static const size_t tree_depth = 10;
+
+// every item enqueues 2 children until tree_depth is reached
+static int binary_tree(struct QPTPool * pool, const size_t id, void * data, void * args) {
+    struct tree_work * work = (struct tree_work *) data;
+
+    __atomic_add_fetch((size_t *) args, 1, __ATOMIC_RELAXED);
+
+    if (work->depth < tree_depth) {
+        for(size_t i = 0; i < 2; i++) {
+            struct tree_work * child = (struct tree_work *) calloc(1, sizeof(struct tree_work));
+            child->depth = work->depth + 1;
+            QPTPool_enqueue(pool, id, binary_tree, child);
+        }
+    }
+
+    free(work);
+    return 0;
+}
+
+static size_t run_binary_tree(const size_t threads, const enum QPTPoolPolicy policy, const size_t hybrid_cap) {
+    size_t visited = 0;
+
+    struct QPTPool * pool = QPTPool_init(threads);
+    EXPECT_NE(pool, nullptr);
+    EXPECT_EQ(QPTPool_set_policy(pool, policy, hybrid_cap), 0);
+    EXPECT_EQ(QPTPool_start(pool, &visited), threads);
+
+    QPTPool_enqueue(pool, 0, binary_tree, calloc(1, sizeof(struct tree_work)));
+    QPTPool_wait(pool);
+
+    const size_t nodes = (1ULL << (tree_depth + 1)) - 1;
+    EXPECT_EQ(visited, nodes);
+    EXPECT_EQ(QPTPool_threads_started(pool), nodes);
+    EXPECT_EQ(QPTPool_threads_completed(pool), nodes);
+    EXPECT_EQ(pool->incomplete, 0UL);
+
+    const size_t peak = QPTPool_peak_incomplete(pool);
+    QPTPool_destroy(pool);
+    return peak;
+}
+
+TEST(QueuePerThreadPool, policies) {
+    EXPECT_EQ(QPTPool_set_policy(nullptr, QPTPOOL_DFS, 0), 1);
+
+    // one thread makes the peaks deterministic
+    const size_t bfs    = run_binary_tree(1, QPTPOOL_BFS,    0);
+    const size_t dfs    = run_binary_tree(1, QPTPOOL_DFS,    0);
+    const size_t hybrid = run_binary_tree(1, QPTPOOL_HYBRID, 64);
+
+    // at least the deepest level was queued at once
+    EXPECT_GE(bfs, 1ULL << tree_depth);
+
+    // at most one sibling per level is queued
+    EXPECT_LE(dfs, tree_depth + 2);
+
+    // breadth first up to the cap, then depth first
+    EXPECT_GE(hybrid, 64UL);
+    EXPECT_LT(hybrid, bfs);
+
+    // many threads stealing from each other
+    for(const enum QPTPoolPolicy policy : {QPTPOOL_BFS, QPTPOOL_DFS, QPTPOOL_HYBRID}) {
+        run_binary_tree(8, policy, 64);
+    }
+}
+
+TEST(QueuePerThreadPool, queue_limit) {
+    EXPECT_EQ(QPTPool_set_queue_limit(nullptr, 1), 1);
+
+    const size_t nodes = (1ULL << (tree_depth + 1)) - 1;
+
+    for(const size_t threads : {1, 8}) {
+        size_t visited = 0;
+
+        struct QPTPool * pool = QPTPool_init(threads);
+        ASSERT_NE(pool, nullptr);
+        EXPECT_EQ(QPTPool_set_queue_limit(pool, 16), 0);
+        EXPECT_EQ(QPTPool_start(pool, &visited), threads);
+
+        QPTPool_enqueue(pool, 0, binary_tree, calloc(1, sizeof(struct tree_work)));
+        QPTPool_wait(pool);
+
+        // everything was processed, but never more than the limit was queued
+        EXPECT_EQ(visited, nodes);
+        EXPECT_EQ(QPTPool_threads_completed(pool), nodes);
+        EXPECT_LE(QPTPool_peak_incomplete(pool), (size_t) 16);
+        EXPECT_GT(QPTPool_inlined(pool), (size_t) 0);
+
+        QPTPool_destroy(pool);
+    }
+}
+
+// every item enqueues 2 children with one batch until tree_depth is reached
+static int batch_tree(struct QPTPool * pool, const size_t id, void * data, void * args) {
+    struct tree_work * work = (struct tree_work *) data;
+
+    __atomic_add_fetch((size_t *) args, 1, __ATOMIC_RELAXED);
+
+    if (work->depth < tree_depth) {
+        struct QPTPoolBatch batch;
+        QPTPool_batch_init(&batch);
+        for(size_t i = 0; i < 2; i++) {
+            struct tree_work * child = (struct tree_work *) calloc(1, sizeof(struct tree_work));
+            child->depth = work->depth + 1;
+            EXPECT_EQ(QPTPool_batch_add(&batch, batch_tree, child), i + 1);
+        }
+        EXPECT_EQ(QPTPool_enqueue_batch(pool, id, &batch), (size_t) 2);
+        EXPECT_EQ(sll_get_size(&batch.items), (size_t) 0);
+    }
+
+    free(work);
+    return 0;
+}
+
+TEST(QueuePerThreadPool, enqueue_batch) {
+    const size_t nodes = (1ULL << (tree_depth + 1)) - 1;
+
+    for(const enum QPTPoolPolicy policy : {QPTPOOL_BFS, QPTPOOL_DFS, QPTPOOL_HYBRID}) {
+        for(const size_t threads : {1, 3, 8}) {
+            for(const size_t queue_limit : {0, 16}) {
+                size_t visited = 0;
+
+                struct QPTPool * pool = QPTPool_init(threads);
+                ASSERT_NE(pool, nullptr);
+                EXPECT_EQ(QPTPool_set_policy(pool, policy, 64), 0);
+                EXPECT_EQ(QPTPool_set_queue_limit(pool, queue_limit), 0);
+                EXPECT_EQ(QPTPool_start(pool, &visited), threads);
+
+                // an empty batch does nothing
+                struct QPTPoolBatch batch;
+                QPTPool_batch_init(&batch);
+                EXPECT_EQ(QPTPool_enqueue_batch(pool, 0, &batch), (size_t) 0);
+
+                EXPECT_EQ(QPTPool_batch_add(&batch, batch_tree, calloc(1, sizeof(struct tree_work))), (size_t) 1);
+                EXPECT_EQ(QPTPool_enqueue_batch(pool, 0, &batch), (size_t) 1);
+                QPTPool_wait(pool);
+
+                EXPECT_EQ(visited, nodes);
+                EXPECT_EQ(QPTPool_threads_started(pool), nodes);
+                EXPECT_EQ(QPTPool_threads_completed(pool), nodes);
+                EXPECT_EQ(pool->incomplete, 0UL);
+                if (queue_limit) {
+                    EXPECT_LE(QPTPool_peak_incomplete(pool), queue_limit);
+                }
+
+                QPTPool_destroy(pool);
+            }
+        }
+    }
+
+    // a batch from outside of the pool is spread across the threads of breadth first pools
+    struct QPTPool * pool = QPTPool_init(4);
+    ASSERT_NE(pool, nullptr);
+
+    struct QPTPoolBatch batch;
+    QPTPool_batch_init(&batch);
+    for(size_t i = 0; i < 10; i++) {
+        QPTPool_batch_add(&batch, nullptr, nullptr);
+    }
+    EXPECT_EQ(QPTPool_enqueue_batch(pool, 0, &batch), (size_t) 10);
+
+    EXPECT_EQ(pool->incomplete, (size_t) 10);
+    EXPECT_EQ(QPTPool_peak_incomplete(pool), (size_t) 10);
+    const size_t expected[] = {2, 2, 3, 3};
+    for(size_t i = 0; i < 4; i++) {
+        EXPECT_EQ(sll_get_size(&pool->data[i].queues[QPTPOOL_PRIORITY_NORMAL]), expected[i]);
+        sll_destroy(&pool->data[i].queues[QPTPOOL_PRIORITY_NORMAL], free);
+    }
+
+    QPTPool_destroy(pool);
+}
+
+struct cancel_counts {
+    size_t created;
+    size_t visited;
+    size_t interrupted;
+};
+
+// every item enqueues 2 children until tree_depth is reached, and the 100th item cancels the pool
+static int cancel_tree(struct QPTPool * pool, const size_t id, void * data, void * args) {
+    struct tree_work * work = (struct tree_work *) data;
+    struct cancel_counts * counts = (struct cancel_counts *) args;
+
+    if (__atomic_add_fetch(&counts->visited, 1, __ATOMIC_RELAXED) == 100) {
+        QPTPool_cancel(pool);
+    }
+
+    if (work->depth < tree_depth) {
+        for(size_t i = 0; i < 2; i++) {
+            struct tree_work * child = (struct tree_work *) calloc(1, sizeof(struct tree_work));
+            child->depth = work->depth + 1;
+            __atomic_add_fetch(&counts->created, 1, __ATOMIC_RELAXED);
+            QPTPool_enqueue(pool, id, cancel_tree, child);
+        }
+    }
+
+    free(work);
+    return 0;
+}
+
+TEST(QueuePerThreadPool, cancel) {
+    EXPECT_EQ(QPTPool_set_cancel(nullptr, nullptr), 1);
+
+    const size_t nodes = (1ULL << (tree_depth + 1)) - 1;
+
+    for(const enum QPTPoolPolicy policy : {QPTPOOL_BFS, QPTPOOL_DFS}) {
+        for(const size_t threads : {1, 8}) {
+            struct cancel_counts counts = {1, 0, 0};
+
+            struct QPTPool * pool = QPTPool_init(threads);
+            ASSERT_NE(pool, nullptr);
+            EXPECT_EQ(QPTPool_set_policy(pool, policy, 0), 0);
+            EXPECT_EQ(QPTPool_set_cancel(pool,
+                                         [](struct QPTPool *, const size_t, void * args) {
+                                             __atomic_add_fetch(&((struct cancel_counts *) args)->interrupted, 1, __ATOMIC_RELAXED);
+                                         }), 0);
+            EXPECT_EQ(QPTPool_start(pool, &counts), threads);
+            EXPECT_EQ(QPTPool_cancelled(pool), 0);
+
+            QPTPool_enqueue(pool, 0, cancel_tree, calloc(1, sizeof(struct tree_work)));
+            QPTPool_wait(pool);
+
+            // the rest of the tree was not walked
+            EXPECT_EQ(QPTPool_cancelled(pool), 1);
+            EXPECT_GE(counts.visited, (size_t) 100);
+            EXPECT_LT(counts.visited, nodes);
+            EXPECT_EQ(QPTPool_threads_started(pool), counts.visited);
+
+            // every item was either processed or dropped
+            EXPECT_EQ(counts.visited + QPTPool_dropped(pool), counts.created);
+
+            // the cancel function ran once for each thread
+            EXPECT_EQ(counts.interrupted, threads);
+
+            // cancelling again does nothing
+            QPTPool_cancel(pool);
+            EXPECT_EQ(counts.interrupted, threads);
+
+            // batches are dropped too
+            const size_t dropped = QPTPool_dropped(pool);
+            struct QPTPoolBatch batch;
+            QPTPool_batch_init(&batch);
+            QPTPool_batch_add(&batch, cancel_tree, calloc(1, sizeof(struct tree_work)));
+            QPTPool_batch_add(&batch, cancel_tree, calloc(1, sizeof(struct tree_work)));
+            EXPECT_EQ(QPTPool_enqueue_batch(pool, 0, &batch), (size_t) 2);
+            EXPECT_EQ(QPTPool_dropped(pool), dropped + 2);
+
+            QPTPool_destroy(pool);
+        }
+    }
+}
+
+struct priority_work {
+    char name;
+    enum QPTPoolPriority priority;
+    size_t repeat;   // number of times to enqueue this item again
+    std::string children;
+    std::string * order;
+};
+
+static struct priority_work * priority_item(char name, enum QPTPoolPriority priority, std::string * order) {
+    struct priority_work * work = new priority_work();
+    work->name = name;
+    work->priority = priority;
+    work->repeat = 0;
+    work->order = order;
+    return work;
+}
+
+// record the order items were processed in, and enqueue their children
+static int record_priority(struct QPTPool * pool, const size_t id, void * data, void *) {
+    struct priority_work * work = (struct priority_work *) data;
+    *work->order += work->name;
+
+    // 'p' and 'P' are normal items that enqueue 1 and 2 high priority items
+    if (work->name == 'p') {
+        work->children = "h";
+    }
+    else if (work->name == 'P') {
+        work->children = "hh";
+    }
+
+    for(const char child : work->children) {
+        const enum QPTPoolPriority priority = (child == 'h')?QPTPOOL_PRIORITY_HIGH:
+                                              (child == 'l')?QPTPOOL_PRIORITY_LOW:
+                                                             QPTPOOL_PRIORITY_NORMAL;
+        QPTPool_enqueue_priority(pool, id, priority, record_priority, priority_item(child, priority, work->order));
+    }
+
+    if (work->repeat) {
+        struct priority_work * again = priority_item(work->name, work->priority, work->order);
+        again->repeat = work->repeat - 1;
+        QPTPool_enqueue_priority(pool, id, work->priority, record_priority, again);
+    }
+
+    delete work;
+    return 0;
+}
+
+// run one thread starting from root, and return the order items were processed in
+static std::string run_priorities(const enum QPTPoolPolicy policy, const size_t starvation_limit,
+                                  const std::string & children, const size_t repeat_high) {
+    std::string order;
+
+    struct QPTPool * pool = QPTPool_init(1);
+    EXPECT_NE(pool, nullptr);
+    EXPECT_EQ(QPTPool_set_policy(pool, policy, 0), 0);
+    EXPECT_EQ(QPTPool_set_starvation_limit(pool, starvation_limit), 0);
+
+    struct priority_work * root = priority_item('r', QPTPOOL_PRIORITY_NORMAL, &order);
+    root->children = children;
+    if (repeat_high) {
+        struct priority_work * high = priority_item('H', QPTPOOL_PRIORITY_HIGH, &order);
+        high->repeat = repeat_high;
+        QPTPool_enqueue_priority(pool, 0, QPTPOOL_PRIORITY_HIGH, record_priority, high);
+    }
+    QPTPool_enqueue(pool, 0, record_priority, root);
+
+    // start after enqueuing so that the thread sees both items at once
+    EXPECT_EQ(QPTPool_start(pool, nullptr), (size_t) 1);
+    QPTPool_wait(pool);
+
+    QPTPool_destroy(pool);
+    return order;
+}
+
+TEST(QueuePerThreadPool, priorities) {
+    EXPECT_EQ(QPTPool_set_starvation_limit(nullptr, 0), 1);
+
+    for(const enum QPTPoolPolicy policy : {QPTPOOL_BFS, QPTPOOL_DFS}) {
+        // higher priority levels are served first
+        EXPECT_EQ(run_priorities(policy, 0, "lnhlnh", 0), "rhhnnll");
+    }
+
+    // without a limit, a stream of high priority work starves everything else
+    EXPECT_EQ(run_priorities(QPTPOOL_DFS, 0, "l", 9), "HHHHHHHHHHrl");
+
+    // with a limit, lower levels are served after being passed over that many times
+    EXPECT_EQ(run_priorities(QPTPOOL_DFS, 3, "l", 9), "HHHrHHHlHHHH");
+    EXPECT_EQ(run_priorities(QPTPOOL_BFS, 3, "l", 9), "HHHrHHHlHHHH");
+}
+
+TEST(QueuePerThreadPool, priorities_preempt_batch) {
+    // a breadth first thread takes the 4 normal items at once, and the
+    // first one ('p') enqueues high priority work, which runs before
+    // the rest of the batch
+    EXPECT_EQ(run_priorities(QPTPOOL_BFS, 16, "pnnn", 0), "rphnnn");
+
+    // the rest of the batch is not starved either
+    EXPECT_EQ(run_priorities(QPTPOOL_BFS, 1,  "pnnn", 0), "rphnnn");
+    EXPECT_EQ(run_priorities(QPTPOOL_BFS, 1,  "Pnnn", 0), "rPhnhnn");
+}
+
+TEST(QueuePerThreadPool, numa) {
+    EXPECT_EQ(QPTPool_set_numa(nullptr), (size_t) 0);
+    EXPECT_EQ(QPTPool_set_thread_init(nullptr, nullptr), 1);
+
+    const size_t threads = 8;
+    const size_t nodes = (1ULL << (tree_depth + 1)) - 1;
+
+    struct QPTPool * pool = QPTPool_init(threads);
+    ASSERT_NE(pool, nullptr);
+
+    // machines without NUMA information leave the threads unpinned
+    const size_t node_count = QPTPool_set_numa(pool);
+    for(size_t i = 0; i < threads; i++) {
+        if (node_count) {
+            EXPECT_GE(pool->data[i].node, 0);
+            EXPECT_GT(CPU_COUNT(&pool->data[i].cpus), 0);
+
+            // threads are assigned to nodes in contiguous blocks
+            if (i) {
+                EXPECT_GE(pool->data[i].node, pool->data[i - 1].node);
+            }
+        }
+        else {
+            EXPECT_EQ(pool->data[i].node, -1);
+        }
+    }
+
+    // every thread runs the init function once
+    static size_t inits;
+    inits = 0;
+    EXPECT_EQ(QPTPool_set_thread_init(pool,
+                                      [](struct QPTPool *, const size_t, void *) {
+                                          __atomic_add_fetch(&inits, 1, __ATOMIC_RELAXED);
+                                      }), 0);
+
+    size_t visited = 0;
+    EXPECT_EQ(QPTPool_set_policy(pool, QPTPOOL_DFS, 0), 0);
+    EXPECT_EQ(QPTPool_start(pool, &visited), threads);
+
+    QPTPool_enqueue(pool, 0, binary_tree, calloc(1, sizeof(struct tree_work)));
+    QPTPool_wait(pool);
+
+    EXPECT_EQ(inits, threads);
+    EXPECT_EQ(visited, nodes);
+
+    QPTPool_destroy(pool);
+}
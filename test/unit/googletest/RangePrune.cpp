@@ -0,0 +1,158 @@
+/*
+This file is part of GUFI, which is part of MarFS, which is released
+under the BSD license.
+
+
+Copyright (c) 2017, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2017, Los Alamos National Security, LLC All rights reserved.
+Copyright 2017. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+
+
+#include <climits>
+
+#include <gtest/gtest.h>
+#include <sqlite3.h>
+
+#include "RangePrune.h"
+
+TEST(RangePrune, init) {
+    struct RangePrune rp;
+    EXPECT_NE(RangePrune_init(nullptr, "size>0"), 0);
+    EXPECT_NE(RangePrune_init(&rp, nullptr), 0);
+    EXPECT_NE(RangePrune_init(&rp, ""), 0);
+    EXPECT_NE(RangePrune_init(&rp, "name=a"), 0);
+    EXPECT_NE(RangePrune_init(&rp, "size"), 0);
+    EXPECT_NE(RangePrune_init(&rp, "size>"), 0);
+    EXPECT_NE(RangePrune_init(&rp, "size=>1"), 0);
+    EXPECT_NE(RangePrune_init(&rp, "size>1k"), 0);
+    EXPECT_NE(RangePrune_init(&rp, "size>1,"), 0);
+
+    ASSERT_EQ(RangePrune_init(&rp, "size>=10,size<100,uid=5,mtime>-1"), 0);
+    EXPECT_EQ(rp.count, (std::size_t) 3);
+
+    // uid
+    EXPECT_EQ(rp.set[0], 1);
+    EXPECT_EQ(rp.min[0], 5);
+    EXPECT_EQ(rp.max[0], 5);
+
+    // size
+    EXPECT_EQ(rp.set[2], 1);
+    EXPECT_EQ(rp.min[2], 10);
+    EXPECT_EQ(rp.max[2], 99);
+
+    // mtime
+    EXPECT_EQ(rp.set[5], 1);
+    EXPECT_EQ(rp.min[5], 0);
+    EXPECT_EQ(rp.max[5], LLONG_MAX);
+
+    // nothing can match
+    ASSERT_EQ(RangePrune_init(&rp, "size<-9223372036854775808"), 0);
+    EXPECT_GT(rp.min[2], rp.max[2]);
+}
+
+TEST(RangePrune, equals) {
+    struct RangePrune rp;
+    ASSERT_EQ(RangePrune_init(&rp, "uid=5,gid>=1,gid<=1,size<=10"), 0);
+
+    long long value = 0;
+    EXPECT_EQ(RangePrune_equals(&rp, "uid", &value), 1);
+    EXPECT_EQ(value, 5);
+    EXPECT_EQ(RangePrune_equals(&rp, "gid", &value), 1);
+    EXPECT_EQ(value, 1);
+    EXPECT_EQ(RangePrune_equals(&rp, "size", &value), 0);
+    EXPECT_EQ(RangePrune_equals(&rp, "mtime", &value), 0);
+    EXPECT_EQ(RangePrune_equals(&rp, "name", &value), 0);
+}
+
+static int prune(sqlite3 * db, const char * sql) {
+    sqlite3_stmt * res = nullptr;
+    EXPECT_EQ(sqlite3_prepare_v2(db, sql, -1, &res, nullptr), SQLITE_OK);
+    EXPECT_EQ(sqlite3_step(res), SQLITE_ROW);
+    const int rc = sqlite3_column_int(res, 0);
+    sqlite3_finalize(res);
+    return rc;
+}
+
+TEST(RangePrune, sql) {
+    struct RangePrune rp;
+    char sql[4096];
+
+    ASSERT_EQ(RangePrune_init(&rp, "size>=10,size<100"), 0);
+    EXPECT_EQ(RangePrune_sql(&rp, "summary", sql, 10), (std::size_t) 0);
+    ASSERT_GT(RangePrune_sql(&rp, "summary", sql, sizeof(sql)), (std::size_t) 0);
+
+    sqlite3 * db = nullptr;
+    ASSERT_EQ(sqlite3_open(":memory:", &db), SQLITE_OK);
+    ASSERT_EQ(sqlite3_exec(db, "CREATE TABLE summary(minsize INT64, maxsize INT64);", nullptr, nullptr, nullptr), SQLITE_OK);
+
+    // no rows, so nothing is known
+    EXPECT_EQ(prune(db, sql), 0);
+
+    // overlaps
+    ASSERT_EQ(sqlite3_exec(db, "INSERT INTO summary VALUES (0, 10);", nullptr, nullptr, nullptr), SQLITE_OK);
+    EXPECT_EQ(prune(db, sql), 0);
+
+    // too small and too large
+    ASSERT_EQ(sqlite3_exec(db, "DELETE FROM summary; INSERT INTO summary VALUES (0, 9); INSERT INTO summary VALUES (100, 1000);", nullptr, nullptr, nullptr), SQLITE_OK);
+    EXPECT_EQ(prune(db, sql), 1);
+
+    // unknown ranges might match
+    ASSERT_EQ(sqlite3_exec(db, "INSERT INTO summary VALUES (NULL, NULL);", nullptr, nullptr, nullptr), SQLITE_OK);
+    EXPECT_EQ(prune(db, sql), 0);
+
+    sqlite3_close(db);
+}
@@ -0,0 +1,165 @@
+/*
+This file is part of GUFI, which is part of MarFS, which is released
+under the BSD license.
+
+
+Copyright (c) 2017, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2017, Los Alamos National Security, LLC All rights reserved.
+Copyright 2017. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+
+
+#include <cstring>
+#include <sys/stat.h>
+
+#include <gtest/gtest.h>
+
+#include "ResultCache.h"
+
+TEST(ResultCache, hash) {
+    const char a[] = "SELECT * FROM entries";
+    const char b[] = "SELECT * FROM summary";
+
+    EXPECT_EQ(ResultCache_hash(RESULT_CACHE_HASH_INIT, a, sizeof(a)),
+              ResultCache_hash(RESULT_CACHE_HASH_INIT, a, sizeof(a)));
+    EXPECT_NE(ResultCache_hash(RESULT_CACHE_HASH_INIT, a, sizeof(a)),
+              ResultCache_hash(RESULT_CACHE_HASH_INIT, b, sizeof(b)));
+
+    /* chaining is the same as hashing everything at once */
+    char ab[sizeof(a) + sizeof(b)];
+    memcpy(ab, a, sizeof(a));
+    memcpy(ab + sizeof(a), b, sizeof(b));
+    EXPECT_EQ(ResultCache_hash(ResultCache_hash(RESULT_CACHE_HASH_INIT, a, sizeof(a)), b, sizeof(b)),
+              ResultCache_hash(RESULT_CACHE_HASH_INIT, ab, sizeof(ab)));
+}
+
+TEST(ResultCache, add_row) {
+    struct ResultCache cache;
+    ASSERT_EQ(ResultCache_init(&cache, ":memory:"), 0);
+
+    char col0[] = "a";
+    char col1[] = "bc";
+    char * row[] = {col0, nullptr, col1};
+    ASSERT_EQ(ResultCache_add_row(&cache, 3, row, '|'), 0);
+    ASSERT_EQ(ResultCache_add_row(&cache, 1, row, '|'), 0);
+
+    const char expected[] = "a||bc|\na|\n";
+    ASSERT_EQ(cache.len, sizeof(expected) - 1);
+    EXPECT_EQ(memcmp(cache.buf, expected, cache.len), 0);
+    EXPECT_EQ(cache.rows, (std::size_t) 2);
+
+    ResultCache_destroy(&cache);
+}
+
+TEST(ResultCache, get_put) {
+    struct ResultCache cache;
+    ASSERT_EQ(ResultCache_init(&cache, ":memory:"), 0);
+
+    struct stat st;
+    memset(&st, 0, sizeof(st));
+    st.st_ino   = 1;
+    st.st_mtime = 2;
+    st.st_ctime = 3;
+    st.st_size  = 4;
+
+    int descend = -1;
+
+    /* nothing cached yet */
+    EXPECT_EQ(ResultCache_get(&cache, 1234, "dir", &st, &descend), 0);
+    EXPECT_EQ(cache.len,  (std::size_t) 0);
+    EXPECT_EQ(cache.rows, (std::size_t) 0);
+
+    char col[] = "row";
+    char * row[] = {col};
+    ASSERT_EQ(ResultCache_add_row(&cache, 1, row, '|'), 0);
+    ASSERT_EQ(ResultCache_put(&cache, 1234, "dir", &st, 1), 0);
+
+    /* the same directory and queries */
+    EXPECT_EQ(ResultCache_get(&cache, 1234, "dir", &st, &descend), 1);
+    EXPECT_EQ(descend, 1);
+    EXPECT_EQ(cache.rows, (std::size_t) 1);
+    ASSERT_EQ(cache.len, (std::size_t) 5);
+    EXPECT_EQ(memcmp(cache.buf, "row|\n", cache.len), 0);
+
+    /* different queries */
+    EXPECT_EQ(ResultCache_get(&cache, 4321, "dir", &st, &descend), 0);
+
+    /* different directory */
+    EXPECT_EQ(ResultCache_get(&cache, 1234, "dir2", &st, &descend), 0);
+
+    /* the database changed */
+    struct stat changed = st;
+    changed.st_mtime++;
+    EXPECT_EQ(ResultCache_get(&cache, 1234, "dir", &changed, &descend), 0);
+    changed = st;
+    changed.st_ctime++;
+    EXPECT_EQ(ResultCache_get(&cache, 1234, "dir", &changed, &descend), 0);
+    changed = st;
+    changed.st_ino++;
+    EXPECT_EQ(ResultCache_get(&cache, 1234, "dir", &changed, &descend), 0);
+
+    /* empty results are cached too */
+    ASSERT_EQ(ResultCache_put(&cache, 1234, "dir", &changed, 0), 0);
+    EXPECT_EQ(ResultCache_get(&cache, 1234, "dir", &changed, &descend), 1);
+    EXPECT_EQ(descend, 0);
+    EXPECT_EQ(cache.len,  (std::size_t) 0);
+    EXPECT_EQ(cache.rows, (std::size_t) 0);
+
+    EXPECT_EQ(cache.hits,   (std::size_t) 2);
+    EXPECT_EQ(cache.misses, (std::size_t) 6);
+
+    ResultCache_destroy(&cache);
+}
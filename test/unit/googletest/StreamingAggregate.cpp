@@ -0,0 +1,159 @@
+/*
+This file is part of GUFI, which is part of MarFS, which is released
+under the BSD license.
+
+
+Copyright (c) 2017, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2017, Los Alamos National Security, LLC All rights reserved.
+Copyright 2017. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "StreamingAggregate.h"
+
+typedef std::vector <std::vector <std::string> > Rows;
+
+static int collect(void * args, int count, char ** data, char **) {
+    Rows * rows = static_cast <Rows *> (args);
+    rows->emplace_back(data, data + count);
+    return 0;
+}
+
+static void add(struct StreamingAggregate * sa, std::vector <const char *> row) {
+    EXPECT_EQ(StreamingAggregate_add(sa, row.size(), const_cast <char **> (row.data())), 0);
+}
+
+TEST(StreamingAggregate, bad_spec) {
+    struct StreamingAggregate sa;
+    EXPECT_NE(StreamingAggregate_init(&sa, nullptr), 0);
+    EXPECT_NE(StreamingAggregate_init(&sa, ""), 0);
+    EXPECT_NE(StreamingAggregate_init(&sa, "key,avg"), 0);
+    EXPECT_NE(StreamingAggregate_init(&sa, "key,,sum"), 0);
+}
+
+TEST(StreamingAggregate, add) {
+    struct StreamingAggregate sa;
+    ASSERT_EQ(StreamingAggregate_init(&sa, "key,count,sum,min,max"), 0);
+    EXPECT_EQ(sa.columns, (std::size_t) 5);
+
+    add(&sa, {"b", "x", "10",  "10",  "10"});
+    add(&sa, {"a", "x", "1",   "1",   "1"});
+    add(&sa, {"b", "x", "2.5", "2.5", "2.5"});
+    add(&sa, {"a", nullptr, nullptr, nullptr, nullptr});
+    add(&sa, {nullptr, "x", "-3", "-3", "-3"});
+
+    // wrong number of columns
+    std::vector <const char *> bad = {"a", "x"};
+    EXPECT_NE(StreamingAggregate_add(&sa, bad.size(), const_cast <char **> (bad.data())), 0);
+
+    EXPECT_EQ(sa.groups, (std::size_t) 3);
+
+    Rows rows;
+    EXPECT_EQ(StreamingAggregate_output(&sa, collect, &rows), (std::size_t) 3);
+
+    const Rows expected = {
+        {"",  "1", "-3",   "-3",  "-3"},
+        {"a", "1", "1",    "1",   "1"},
+        {"b", "2", "12.5", "2.5", "10"},
+    };
+    EXPECT_EQ(rows, expected);
+
+    StreamingAggregate_destroy(&sa);
+}
+
+TEST(StreamingAggregate, merge) {
+    struct StreamingAggregate lhs;
+    struct StreamingAggregate rhs;
+    ASSERT_EQ(StreamingAggregate_init(&lhs, "key,key,sum"), 0);
+    ASSERT_EQ(StreamingAggregate_init(&rhs, "key,key,sum"), 0);
+
+    // enough groups to force the buckets to grow
+    for(int i = 0; i < 1000; i++) {
+        const std::string key = std::to_string(i);
+        add(&lhs, {key.c_str(), "0", "1"});
+        add(&rhs, {key.c_str(), (i % 2)?"0":"1", "2"});
+    }
+
+    EXPECT_EQ(lhs.groups, (std::size_t) 1000);
+    EXPECT_EQ(rhs.groups, (std::size_t) 1000);
+
+    EXPECT_EQ(StreamingAggregate_merge(&lhs, &rhs), 0);
+    EXPECT_EQ(lhs.groups, (std::size_t) 1500);
+    EXPECT_EQ(rhs.groups, (std::size_t) 0);
+
+    Rows rows;
+    EXPECT_EQ(StreamingAggregate_output(&lhs, collect, &rows), (std::size_t) 1500);
+
+    long long total = 0;
+    for(Rows::value_type const & row : rows) {
+        total += std::stoll(row[2]);
+    }
+    EXPECT_EQ(total, 3000);
+
+    // different specs can't be merged
+    struct StreamingAggregate other;
+    ASSERT_EQ(StreamingAggregate_init(&other, "key,max"), 0);
+    EXPECT_NE(StreamingAggregate_merge(&lhs, &other), 0);
+
+    StreamingAggregate_destroy(&other);
+    StreamingAggregate_destroy(&rhs);
+    StreamingAggregate_destroy(&lhs);
+}
@@ -0,0 +1,153 @@
+/*
+This file is part of GUFI, which is part of MarFS, which is released
+under the BSD license.
+
+
+Copyright (c) 2017, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2017, Los Alamos National Security, LLC All rights reserved.
+Copyright 2017. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "TopK.h"
+
+typedef std::vector <std::vector <std::string> > Rows;
+
+static int collect(void * args, int count, char ** data, char **) {
+    Rows * rows = static_cast <Rows *> (args);
+    rows->emplace_back(data, data + count);
+    return 0;
+}
+
+static void add(struct TopK * topk, std::vector <const char *> row) {
+    EXPECT_EQ(TopK_add(topk, row.size(), const_cast <char **> (row.data())), 0);
+}
+
+TEST(TopK, init) {
+    struct TopK topk;
+    EXPECT_NE(TopK_init(nullptr, 1), 0);
+    EXPECT_NE(TopK_init(&topk, 0), 0);
+    EXPECT_EQ(TopK_init(&topk, 1), 0);
+    EXPECT_EQ(TopK_full(&topk), 0);
+    TopK_destroy(&topk);
+}
+
+TEST(TopK, add) {
+    struct TopK topk;
+    ASSERT_EQ(TopK_init(&topk, 3), 0);
+
+    add(&topk, {"5",  "five"});
+    add(&topk, {"1",  "one"});
+    EXPECT_EQ(TopK_full(&topk), 0);
+    add(&topk, {"10", "ten"});
+    EXPECT_EQ(TopK_full(&topk), 1);
+    EXPECT_EQ(TopK_min(&topk), 1);
+
+    // pushes out 1
+    add(&topk, {"7",  "seven"});
+    EXPECT_EQ(TopK_min(&topk), 5);
+
+    // too small
+    add(&topk, {"2",  "two"});
+    add(&topk, {nullptr, "null"});
+    EXPECT_EQ(TopK_min(&topk), 5);
+
+    Rows rows;
+    EXPECT_EQ(TopK_output(&topk, collect, &rows), (std::size_t) 3);
+
+    const Rows expected = {
+        {"10", "ten"},
+        {"7",  "seven"},
+        {"5",  "five"},
+    };
+    EXPECT_EQ(rows, expected);
+
+    TopK_destroy(&topk);
+}
+
+TEST(TopK, merge) {
+    struct TopK lhs;
+    struct TopK rhs;
+    ASSERT_EQ(TopK_init(&lhs, 4), 0);
+    ASSERT_EQ(TopK_init(&rhs, 4), 0);
+
+    for(int i = 0; i < 100; i++) {
+        const std::string value = std::to_string(i);
+        add((i % 2)?&lhs:&rhs, {value.c_str()});
+    }
+
+    EXPECT_EQ(TopK_merge(&lhs, &rhs), 0);
+    EXPECT_EQ(TopK_full(&rhs), 0);
+
+    Rows rows;
+    EXPECT_EQ(TopK_output(&lhs, collect, &rows), (std::size_t) 4);
+
+    const Rows expected = {
+        {"99"},
+        {"98"},
+        {"97"},
+        {"96"},
+    };
+    EXPECT_EQ(rows, expected);
+
+    TopK_destroy(&rhs);
+    TopK_destroy(&lhs);
+}
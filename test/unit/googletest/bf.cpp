@@ -68,6 +68,7 @@ extern "C" {
 
 #include "bf.h"
 #include "utils.h"
+#include "QueuePerThreadPool.h"
 
 }
 
@@ -445,6 +446,97 @@ TEST(parse_cmd_line, aggregate_arguments) {
     }
 }
 
+TEST(parse_cmd_line, long_options) {
+    const char opts[] = "n:|traversal|queue-stats";
+    const std::string exec = "exec";
+
+    // default
+    {
+        const char *argv[] = {exec.c_str()};
+        int argc = sizeof(argv) / sizeof(argv[0]);
+
+        struct input in;
+        ASSERT_EQ(parse_cmd_line(argc, (char **) argv, opts, 0, "", &in), argc);
+        EXPECT_EQ(in.traversal,   QPTPOOL_BFS);
+        EXPECT_EQ(in.queue_stats, 0);
+    }
+
+    {
+        const char *argv[] = {exec.c_str(), "-n", "2", "--traversal", "hybrid:10", "--queue-stats"};
+        int argc = sizeof(argv) / sizeof(argv[0]);
+
+        struct input in;
+        ASSERT_EQ(parse_cmd_line(argc, (char **) argv, opts, 0, "", &in), argc);
+        EXPECT_EQ(in.maxthreads,    2);
+        EXPECT_EQ(in.traversal,     QPTPOOL_HYBRID);
+        EXPECT_EQ(in.traversal_cap, (std::size_t) 10);
+        EXPECT_EQ(in.queue_stats,   1);
+    }
+
+    {
+        const char *argv[] = {exec.c_str(), "--traversal=dfs"};
+        int argc = sizeof(argv) / sizeof(argv[0]);
+
+        struct input in;
+        ASSERT_EQ(parse_cmd_line(argc, (char **) argv, opts, 0, "", &in), argc);
+        EXPECT_EQ(in.traversal, QPTPOOL_DFS);
+    }
+
+    // bad policy
+    {
+        const char *argv[] = {exec.c_str(), "--traversal", "random"};
+        int argc = sizeof(argv) / sizeof(argv[0]);
+
+        struct input in;
+        ASSERT_EQ(parse_cmd_line(argc, (char **) argv, opts, 0, "", &in), -1);
+    }
+
+    // inline directories can't share output databases
+    {
+        const char *argv[] = {exec.c_str(), "--max-queued", "10", "-O", "outdb"};
+        int argc = sizeof(argv) / sizeof(argv[0]);
+
+        struct input in;
+        ASSERT_EQ(parse_cmd_line(argc, (char **) argv, "O:|max-queued", 0, "", &in), -1);
+    }
+
+    // inline directories would be cached with their parents
+    {
+        const char *argv[] = {exec.c_str(), "--max-queued", "10", "-Q", "cache.db"};
+        int argc = sizeof(argv) / sizeof(argv[0]);
+
+        struct input in;
+        ASSERT_EQ(parse_cmd_line(argc, (char **) argv, "Q:|max-queued", 0, "", &in), -1);
+    }
+
+    // ranges of entries are not cached per directory
+    {
+        const char *argv[] = {exec.c_str(), "--split-entries", "1000", "-Q", "cache.db"};
+        int argc = sizeof(argv) / sizeof(argv[0]);
+
+        struct input in;
+        ASSERT_EQ(parse_cmd_line(argc, (char **) argv, "Q:|split-entries", 0, "", &in), -1);
+    }
+
+    // rows have to be printed as they are found to be counted
+    {
+        const char *argv[] = {exec.c_str(), "--max-results", "1", "-k", "3"};
+        int argc = sizeof(argv) / sizeof(argv[0]);
+
+        struct input in;
+        ASSERT_EQ(parse_cmd_line(argc, (char **) argv, "k:|max-results", 0, "", &in), -1);
+    }
+
+    // only the long options listed in the getopt string are accepted
+    {
+        const char *argv[] = {exec.c_str(), "--queue-stats"};
+        int argc = sizeof(argv) / sizeof(argv[0]);
+
+        struct input in;
+        ASSERT_EQ(parse_cmd_line(argc, (char **) argv, "n:|traversal", 0, "", &in), -1);
+    }
+}
+
 TEST(parse_cmd_line, positional) {
     std::string exec = "exec";
     std::string pos1 = "positional1";
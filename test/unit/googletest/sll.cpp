@@ -106,6 +106,67 @@ TEST(SinglyLinkedList, push) {
     sll_destroy(&sll, nullptr);
 }
 
+TEST(SinglyLinkedList, push_front_pop) {
+    int values[] = {0, 1, 2};
+
+    struct sll sll;
+    EXPECT_EQ(&sll, sll_init(&sll));
+    EXPECT_EQ(sll_pop(&sll), nullptr);
+
+    EXPECT_EQ(&sll, sll_push_front(&sll, &values[1]));
+    EXPECT_EQ(sll.head, sll.tail);
+    EXPECT_EQ(&sll, sll_push_front(&sll, &values[0]));
+    EXPECT_EQ(&sll, sll_push(&sll, &values[2]));
+    EXPECT_EQ(sll_get_size(&sll), (size_t) 3);
+
+    // items come off of the front in order
+    for(size_t i = 0; i < 3; i++) {
+        EXPECT_EQ(sll_pop(&sll), &values[i]);
+        EXPECT_EQ(sll_get_size(&sll), 2 - i);
+    }
+    EXPECT_EQ(sll.head, nullptr);
+    EXPECT_EQ(sll.tail, nullptr);
+    EXPECT_EQ(sll_pop(&sll), nullptr);
+
+    sll_destroy(&sll, nullptr);
+}
+
+TEST(SinglyLinkedList, split) {
+    int values[] = {0, 1, 2, 3, 4};
+
+    for(size_t count = 0; count <= 5; count++) {
+        struct sll sll;
+        EXPECT_EQ(&sll, sll_init(&sll));
+        for(size_t i = 0; i < count; i++) {
+            EXPECT_EQ(&sll, sll_push(&sll, &values[i]));
+        }
+
+        struct sll back;
+        EXPECT_EQ(&back, sll_split(&sll, &back));
+
+        // the front keeps the extra item
+        const size_t keep = count - (count / 2);
+        EXPECT_EQ(sll_get_size(&sll), keep);
+        EXPECT_EQ(sll_get_size(&back), count / 2);
+
+        size_t i = 0;
+        sll_loop(&sll, node) {
+            EXPECT_EQ(sll_node_data(node), &values[i++]);
+        }
+        EXPECT_EQ(i, keep);
+        EXPECT_EQ(sll_node_data(sll.tail), keep?&values[keep - 1]:nullptr);
+
+        sll_loop(&back, node) {
+            EXPECT_EQ(sll_node_data(node), &values[i++]);
+        }
+        EXPECT_EQ(i, count);
+        EXPECT_EQ(sll_node_data(back.tail), (count / 2)?&values[count - 1]:nullptr);
+
+        sll_destroy(&back, nullptr);
+        sll_destroy(&sll, nullptr);
+    }
+}
+
 TEST(SinglyLinkedList, move) {
     // create sll with 2 items
     struct sll sll_src;
@@ -289,6 +350,81 @@ TEST(SinglyLinkedList, move_append) {
     }
 }
 
+TEST(SinglyLinkedList, move_prepend) {
+    int values[] = {0, 1, 2, 3};
+
+    for(size_t dst_count = 0; dst_count <= 2; dst_count++) {
+        for(size_t src_count = 0; src_count <= 2; src_count++) {
+            struct sll dst;
+            EXPECT_EQ(&dst, sll_init(&dst));
+            for(size_t i = 0; i < dst_count; i++) {
+                EXPECT_EQ(&dst, sll_push(&dst, &values[2 + i]));
+            }
+
+            struct sll src;
+            EXPECT_EQ(&src, sll_init(&src));
+            for(size_t i = 0; i < src_count; i++) {
+                EXPECT_EQ(&src, sll_push(&src, &values[2 - src_count + i]));
+            }
+
+            EXPECT_EQ(&dst, sll_move_prepend(&dst, &src));
+            EXPECT_EQ(src.head, nullptr);
+            EXPECT_EQ(src.tail, nullptr);
+            EXPECT_EQ(sll_get_size(&src), (size_t) 0);
+            EXPECT_EQ(sll_get_size(&dst), src_count + dst_count);
+
+            // src is in front of dst
+            size_t i = 2 - src_count;
+            sll_loop(&dst, node) {
+                EXPECT_EQ(sll_node_data(node), &values[i++]);
+            }
+            EXPECT_EQ(i, 2 + dst_count);
+            EXPECT_EQ(sll_node_data(dst.tail), (src_count + dst_count)?&values[i - 1]:nullptr);
+
+            sll_destroy(&dst, nullptr);
+        }
+    }
+
+    EXPECT_EQ(sll_move_prepend(nullptr, nullptr), nullptr);
+}
+
+TEST(SinglyLinkedList, move_first) {
+    int values[] = {0, 1, 2, 3, 4};
+
+    for(size_t count = 0; count <= 6; count++) {
+        struct sll src;
+        EXPECT_EQ(&src, sll_init(&src));
+        for(size_t i = 0; i < 5; i++) {
+            EXPECT_EQ(&src, sll_push(&src, &values[i]));
+        }
+
+        struct sll dst;
+        EXPECT_EQ(&dst, sll_move_first(&dst, &src, count));
+
+        const size_t moved = (count < 5)?count:5;
+        EXPECT_EQ(sll_get_size(&dst), moved);
+        EXPECT_EQ(sll_get_size(&src), 5 - moved);
+
+        size_t i = 0;
+        sll_loop(&dst, node) {
+            EXPECT_EQ(sll_node_data(node), &values[i++]);
+        }
+        EXPECT_EQ(i, moved);
+        EXPECT_EQ(sll_node_data(dst.tail), moved?&values[moved - 1]:nullptr);
+
+        sll_loop(&src, node) {
+            EXPECT_EQ(sll_node_data(node), &values[i++]);
+        }
+        EXPECT_EQ(i, (size_t) 5);
+        EXPECT_EQ(sll_node_data(src.tail), (moved < 5)?&values[4]:nullptr);
+
+        sll_destroy(&dst, nullptr);
+        sll_destroy(&src, nullptr);
+    }
+
+    EXPECT_EQ(sll_move_first(nullptr, nullptr, 0), nullptr);
+}
+
 TEST(SinglyLinkedList, head_node) {
     struct sll sll;
     EXPECT_EQ(&sll, sll_init(&sll));
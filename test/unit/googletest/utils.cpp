@@ -63,9 +63,11 @@ OF SUCH DAMAGE.
 
 
 #include <climits>
+#include <cstddef>
 #include <cstdlib>
 #include <cstring>
 #include <random>
+#include <vector>
 #include <sys/types.h>
 #include <sys/xattr.h>
 
@@ -460,6 +462,413 @@ TEST(summary, tsumit) {
     EXPECT_EQ(in.maxossint4, out.maxossint4);
 }
 
+// the field at a time versions of sumit and tsumit that the lane kernels replaced
+static int reference_sumit(struct sum *summary, struct work *pwork) {
+
+  if (summary->setit == 0) {
+    summary->minuid=pwork->statuso.st_uid;
+    summary->maxuid=pwork->statuso.st_uid;
+    summary->mingid=pwork->statuso.st_gid;
+    summary->maxgid=pwork->statuso.st_gid;
+    summary->minsize=pwork->statuso.st_size;
+    summary->maxsize=pwork->statuso.st_size;;
+    summary->minctime=pwork->statuso.st_ctime;
+    summary->maxctime=pwork->statuso.st_ctime;
+    summary->minmtime=pwork->statuso.st_mtime;
+    summary->maxmtime=pwork->statuso.st_mtime;
+    summary->minatime=pwork->statuso.st_atime;
+    summary->maxatime=pwork->statuso.st_atime;;
+    summary->minblocks=pwork->statuso.st_blocks;
+    summary->maxblocks=pwork->statuso.st_blocks;
+    summary->mincrtime=pwork->crtime;
+    summary->maxcrtime=pwork->crtime;
+    summary->minossint1=pwork->ossint1;
+    summary->maxossint1=pwork->ossint1;
+    summary->totossint1=pwork->ossint1;
+    summary->minossint2=pwork->ossint2;
+    summary->maxossint2=pwork->ossint2;
+    summary->totossint2=pwork->ossint2;
+    summary->minossint3=pwork->ossint3;
+    summary->maxossint3=pwork->ossint3;
+    summary->totossint3=pwork->ossint3;
+    summary->minossint4=pwork->ossint4;
+    summary->maxossint4=pwork->ossint4;
+    summary->totossint4=pwork->ossint4;
+    summary->setit=1;
+  }
+  if (!strncmp(pwork->type,"f",1)) {
+     summary->totfiles++;
+     if (pwork->statuso.st_size < summary->minsize) summary->minsize=pwork->statuso.st_size;
+     if (pwork->statuso.st_size > summary->maxsize) summary->maxsize=pwork->statuso.st_size;
+     if (pwork->statuso.st_size <= 1024) summary->totltk++;
+     if (pwork->statuso.st_size > 1024) summary->totmtk++;
+     if (pwork->statuso.st_size <= 1048576) summary->totltm++;
+     if (pwork->statuso.st_size > 1048576) summary->totmtm++;
+     if (pwork->statuso.st_size > 1073741824) summary->totmtg++;
+     if (pwork->statuso.st_size > 1099511627776) summary->totmtt++;
+     summary->totsize=summary->totsize+pwork->statuso.st_size;
+
+     if (pwork->statuso.st_blocks < summary->minblocks) summary->minblocks=pwork->statuso.st_blocks;
+     if (pwork->statuso.st_blocks > summary->maxblocks) summary->maxblocks=pwork->statuso.st_blocks;
+  }
+  if (!strncmp(pwork->type,"l",1)) {
+     summary->totlinks++;
+  }
+
+  if (pwork->statuso.st_uid < summary->minuid) summary->minuid=pwork->statuso.st_uid;
+  if (pwork->statuso.st_uid > summary->maxuid) summary->maxuid=pwork->statuso.st_uid;
+  if (pwork->statuso.st_gid < summary->mingid) summary->mingid=pwork->statuso.st_gid;
+  if (pwork->statuso.st_gid > summary->maxgid) summary->maxgid=pwork->statuso.st_gid;
+  if (pwork->statuso.st_ctime < summary->minctime) summary->minctime=pwork->statuso.st_ctime;
+  if (pwork->statuso.st_ctime > summary->maxctime) summary->maxctime=pwork->statuso.st_ctime;
+  if (pwork->statuso.st_mtime < summary->minmtime) summary->minmtime=pwork->statuso.st_mtime;
+  if (pwork->statuso.st_mtime > summary->maxmtime) summary->maxmtime=pwork->statuso.st_mtime;
+  if (pwork->statuso.st_atime < summary->minatime) summary->minatime=pwork->statuso.st_atime;
+  if (pwork->statuso.st_atime > summary->maxatime) summary->maxatime=pwork->statuso.st_atime;
+  if (pwork->crtime < summary->mincrtime) summary->mincrtime=pwork->crtime;
+  if (pwork->crtime > summary->maxcrtime) summary->maxcrtime=pwork->crtime;
+
+  if (pwork->ossint1 < summary->minossint1) summary->minossint1=pwork->ossint1;
+  if (pwork->ossint1 > summary->maxossint1) summary->maxossint1=pwork->ossint1;
+  summary->totossint1=summary->totossint1+pwork->ossint1;
+
+  if (pwork->ossint2 < summary->minossint2) summary->minossint2=pwork->ossint2;
+  if (pwork->ossint2 > summary->maxossint2) summary->maxossint2=pwork->ossint2;
+  summary->totossint2=summary->totossint2+pwork->ossint2;
+
+  if (pwork->ossint3 < summary->minossint3) summary->minossint3=pwork->ossint3;
+  if (pwork->ossint3 > summary->maxossint3) summary->maxossint3=pwork->ossint3;
+  summary->totossint3=summary->totossint3+pwork->ossint3;
+
+  if (pwork->ossint4 < summary->minossint4) summary->minossint4=pwork->ossint4;
+  if (pwork->ossint4 > summary->maxossint4) summary->maxossint4=pwork->ossint4;
+  summary->totossint4=summary->totossint4+pwork->ossint4;
+
+  size_t xattrdelim_counter = 0;
+  for(ssize_t i = 0; i < pwork->xattrs_len; i++) {
+      if (pwork->xattrs[i] == xattrdelim[0]) {
+          xattrdelim_counter++;
+          if ((xattrdelim_counter & 1) == 0) {
+              summary->totxattr++;
+          }
+      }
+  }
+
+  return 0;
+}
+
+static int reference_tsumit(struct sum *sumin, struct sum *smout) {
+
+  /* if sumin totsubdirs is > 0 we are summing a treesummary not a dirsummary */
+  if (sumin->totsubdirs > 0) {
+    smout->totsubdirs=smout->totsubdirs+sumin->totsubdirs;
+    if (sumin->maxsubdirfiles > smout->maxsubdirfiles) smout->maxsubdirfiles = sumin->maxsubdirfiles;
+    if (sumin->maxsubdirlinks > smout->maxsubdirlinks) smout->maxsubdirlinks = sumin->maxsubdirlinks;
+    if (sumin->maxsubdirsize  > smout->maxsubdirsize)  smout->maxsubdirsize  = sumin->maxsubdirsize;
+  } else {
+    smout->totsubdirs++;
+    if (sumin->totfiles > smout->maxsubdirfiles) smout->maxsubdirfiles = sumin->totfiles;
+    if (sumin->totlinks > smout->maxsubdirlinks) smout->maxsubdirlinks = sumin->totlinks;
+    if (sumin->totsize  > smout->maxsubdirsize)  smout->maxsubdirsize  = sumin->totsize;
+  }
+
+  smout->totfiles += sumin->totfiles;
+  smout->totlinks += sumin->totlinks;
+
+  if (sumin->totfiles > 0) {
+    if (smout->setit == 0) {
+      smout->minuid=sumin->minuid;
+      smout->maxuid=sumin->maxuid;
+      smout->mingid=sumin->mingid;
+      smout->maxgid=sumin->maxgid;
+      smout->minsize=sumin->minsize;
+      smout->maxsize=sumin->maxsize;
+      smout->minctime=sumin->minctime;
+      smout->maxctime=sumin->maxctime;
+      smout->minmtime=sumin->minmtime;
+      smout->maxmtime=sumin->maxmtime;
+      smout->minatime=sumin->minatime;
+      smout->maxatime=sumin->maxatime;
+      smout->minblocks=sumin->minblocks;
+      smout->maxblocks=sumin->maxblocks;
+      smout->mincrtime=sumin->mincrtime;
+      smout->maxcrtime=sumin->maxcrtime;
+      smout->minossint1=sumin->minossint1;
+      smout->maxossint1=sumin->maxossint1;
+      smout->minossint2=sumin->minossint2;
+      smout->maxossint2=sumin->maxossint2;
+      smout->minossint3=sumin->minossint3;
+      smout->maxossint3=sumin->maxossint3;
+      smout->minossint4=sumin->minossint4;
+      smout->maxossint4=sumin->maxossint4;
+      smout->setit=1;
+    }
+
+  /* only set these mins and maxes if there are files in the directory
+     otherwise mins are all zero */
+  //if (sumin->totfiles > 0) {
+    if (sumin->minuid < smout->minuid) smout->minuid=sumin->minuid;
+    if (sumin->maxuid > smout->maxuid) smout->maxuid=sumin->maxuid;
+    if (sumin->mingid < smout->mingid) smout->mingid=sumin->mingid;
+    if (sumin->maxgid > smout->maxgid) smout->maxgid=sumin->maxgid;
+    if (sumin->minsize < smout->minsize) smout->minsize=sumin->minsize;
+    if (sumin->maxsize > smout->maxsize) smout->maxsize=sumin->maxsize;
+    if (sumin->minblocks < smout->minblocks) smout->minblocks=sumin->minblocks;
+    if (sumin->maxblocks > smout->maxblocks) smout->maxblocks=sumin->maxblocks;
+    if (sumin->minctime < smout->minctime) smout->minctime=sumin->minctime;
+    if (sumin->maxctime > smout->maxctime) smout->maxctime=sumin->maxctime;
+    if (sumin->minmtime < smout->minmtime) smout->minmtime=sumin->minmtime;
+    if (sumin->maxmtime > smout->maxmtime) smout->maxmtime=sumin->maxmtime;
+    if (sumin->minatime < smout->minatime) smout->minatime=sumin->minatime;
+    if (sumin->maxatime > smout->maxatime) smout->maxatime=sumin->maxatime;
+    if (sumin->mincrtime < smout->mincrtime) smout->mincrtime=sumin->mincrtime;
+    if (sumin->maxcrtime > smout->maxcrtime) smout->maxcrtime=sumin->maxcrtime;
+    if (sumin->minossint1 < smout->minossint1) smout->minossint1=sumin->minossint1;
+    if (sumin->maxossint1 > smout->maxossint1) smout->maxossint1=sumin->maxossint1;
+    if (sumin->minossint2 < smout->minossint2) smout->minossint2=sumin->minossint2;
+    if (sumin->maxossint2 > smout->maxossint2) smout->maxossint2=sumin->maxossint2;
+    if (sumin->minossint3 < smout->minossint3) smout->minossint3=sumin->minossint3;
+    if (sumin->maxossint3 > smout->maxossint3) smout->maxossint3=sumin->maxossint3;
+    if (sumin->minossint4 < smout->minossint4) smout->minossint4=sumin->minossint4;
+    if (sumin->maxossint4 > smout->maxossint4) smout->maxossint4=sumin->maxossint4;
+  }
+
+  smout->totltk     += sumin->totltk;
+  smout->totmtk     += sumin->totmtk;
+  smout->totltm     += sumin->totltm;
+  smout->totmtm     += sumin->totmtm;
+  smout->totmtg     += sumin->totmtg;
+  smout->totmtt     += sumin->totmtt;
+  smout->totsize    += sumin->totsize;
+  smout->totxattr   += sumin->totxattr;
+  smout->totossint1 += sumin->totossint1;
+  smout->totossint2 += sumin->totossint2;
+  smout->totossint3 += sumin->totossint3;
+  smout->totossint4 += sumin->totossint4;
+
+  return 0;
+}
+
+// random values that are not all small, so that comparisons are not always in the same direction
+static void random_sum(std::mt19937_64 & gen, struct sum * summary) {
+    std::uniform_int_distribution <long long int> dist(LLONG_MIN / 4, LLONG_MAX / 4);
+    long long int * lanes = reinterpret_cast <long long int *> (summary);
+    for(std::size_t i = 0; i < sizeof(*summary) / sizeof(long long int); i++) {
+        lanes[i] = dist(gen);
+    }
+}
+
+TEST(summary, sumit_reference) {
+    std::mt19937_64 gen(1234);
+    std::uniform_int_distribution <long long int> dist(LLONG_MIN / 4, LLONG_MAX / 4);
+    const char * types[] = {"f", "l", "d"};
+
+    for(int i = 0; i < 1000; i++) {
+        struct sum summary;
+        random_sum(gen, &summary);
+        summary.setit = i % 2;
+
+        struct work pwork;
+        memset(&pwork, 0, sizeof(pwork));
+        SNPRINTF(pwork.type, 2, "%s", types[i % 3]);
+        pwork.statuso.st_uid    = dist(gen);
+        pwork.statuso.st_gid    = dist(gen);
+        pwork.statuso.st_size   = dist(gen);
+        pwork.statuso.st_ctime  = dist(gen);
+        pwork.statuso.st_mtime  = dist(gen);
+        pwork.statuso.st_atime  = dist(gen);
+        pwork.statuso.st_blocks = dist(gen);
+        pwork.crtime            = dist(gen);
+        pwork.ossint1           = dist(gen);
+        pwork.ossint2           = dist(gen);
+        pwork.ossint3           = dist(gen);
+        pwork.ossint4           = dist(gen);
+
+        struct sum expected = summary;
+        ASSERT_EQ(reference_sumit(&expected, &pwork), 0);
+        ASSERT_EQ(sumit(&summary, &pwork), 0);
+        ASSERT_EQ(memcmp(&summary, &expected, offsetof(struct sum, sizehistfiles)), 0);
+    }
+}
+
+TEST(summary, tsumit_reference) {
+    std::mt19937_64 gen(5678);
+
+    for(int i = 0; i < 1000; i++) {
+        struct sum in;
+        random_sum(gen, &in);
+        in.totfiles   = (i % 3) - 1;
+        in.totsubdirs = (i % 5) - 2;
+
+        struct sum out;
+        random_sum(gen, &out);
+        out.setit = i % 2;
+
+        struct sum expected = out;
+        ASSERT_EQ(reference_tsumit(&in, &expected), 0);
+        ASSERT_EQ(tsumit(&in, &out), 0);
+        ASSERT_EQ(memcmp(&out, &expected, offsetof(struct sum, sizehistfiles)), 0);
+    }
+}
+
+TEST(summary, summerge) {
+    std::mt19937_64 gen(9012);
+    std::uniform_int_distribution <long long int> dist(0, 1LL << 32);
+
+    // the first entry is a link, so it sets the size and blocks of the first summary
+    const char * types[] = {"l", "f", "f", "l", "f"};
+
+    const int count = 100;
+    std::vector <struct work> entries(count);
+    for(int i = 0; i < count; i++) {
+        struct work & pwork = entries[i];
+        memset(&pwork, 0, sizeof(pwork));
+        SNPRINTF(pwork.type, 2, "%s", types[i % 5]);
+        pwork.statuso.st_uid    = dist(gen);
+        pwork.statuso.st_gid    = dist(gen);
+        pwork.statuso.st_size   = dist(gen);
+        pwork.statuso.st_ctime  = dist(gen);
+        pwork.statuso.st_mtime  = dist(gen);
+        pwork.statuso.st_atime  = dist(gen);
+        pwork.statuso.st_blocks = dist(gen);
+        pwork.crtime            = dist(gen);
+        pwork.ossint1           = dist(gen);
+        pwork.ossint2           = dist(gen);
+        pwork.ossint3           = dist(gen);
+        pwork.ossint4           = dist(gen);
+    }
+
+    // all of the entries in one summary
+    struct sum expected;
+    zeroit(&expected);
+    for(int i = 0; i < count; i++) {
+        ASSERT_EQ(sumit(&expected, &entries[i]), 0);
+    }
+
+    // the first 30 entries, and then 2 shards starting with links
+    struct sum parts[3];
+    zeroit(&parts[0]);
+    zeroit(&parts[1]);
+    zeroit(&parts[2]);
+    parts[1].setit = 1;
+    parts[2].setit = 1;
+    for(int i = 0; i < count; i++) {
+        ASSERT_EQ(sumit(&parts[(i < 30)?0:(i < 63)?1:2], &entries[i]), 0);
+    }
+
+    // in any order
+    struct sum merged;
+    zeroit(&merged);
+    ASSERT_EQ(summerge(&parts[2], &merged), 0);
+    ASSERT_EQ(summerge(&parts[0], &merged), 0);
+    ASSERT_EQ(summerge(&parts[1], &merged), 0);
+
+    EXPECT_EQ(memcmp(&merged, &expected, sizeof(struct sum)), 0);
+}
+
+TEST(summary, hist_bucket) {
+    const size_t shift = in.hist_shift;
+
+    in.hist_shift = 1;
+    EXPECT_EQ(hist_bucket(-1), (size_t) 0);
+    EXPECT_EQ(hist_bucket(0),  (size_t) 0);
+    EXPECT_EQ(hist_bucket(1),  (size_t) 1);
+    EXPECT_EQ(hist_bucket(2),  (size_t) 2);
+    EXPECT_EQ(hist_bucket(3),  (size_t) 2);
+    EXPECT_EQ(hist_bucket(4),  (size_t) 3);
+    EXPECT_EQ(hist_bucket(LLONG_MAX), (size_t) 63);
+    EXPECT_EQ(hist_bucket_low(0, in.hist_shift),  0);
+    EXPECT_EQ(hist_bucket_high(0, in.hist_shift), 1);
+    EXPECT_EQ(hist_bucket_low(3, in.hist_shift),  4);
+    EXPECT_EQ(hist_bucket_high(3, in.hist_shift), 8);
+    EXPECT_EQ(hist_bucket_high(63, in.hist_shift), LLONG_MAX);
+
+    in.hist_shift = 10;
+    EXPECT_EQ(hist_bucket(1023), (size_t) 1);
+    EXPECT_EQ(hist_bucket(1024), (size_t) 2);
+    EXPECT_EQ(hist_bucket(LLONG_MAX), (size_t) 7);
+    EXPECT_EQ(hist_bucket_low(2, in.hist_shift),  1024);
+    EXPECT_EQ(hist_bucket_high(2, in.hist_shift), 1048576);
+    EXPECT_EQ(hist_bucket_high(7, in.hist_shift), LLONG_MAX);
+
+    /* every value is within the bounds of its bucket */
+    for(in.hist_shift = 1; in.hist_shift < 64; in.hist_shift++) {
+        for(long long int value = 1; value > 0; value = (value * 3) + 1) {
+            const size_t bucket = hist_bucket(value);
+            ASSERT_LT(bucket, (size_t) SUM_HIST_BUCKETS);
+            EXPECT_LE(hist_bucket_low(bucket, in.hist_shift), value);
+            EXPECT_TRUE((value < hist_bucket_high(bucket, in.hist_shift)) || (hist_bucket_high(bucket, in.hist_shift) == LLONG_MAX));
+        }
+    }
+
+    in.hist_shift = shift;
+}
+
+TEST(summary, hist) {
+    const size_t shift = in.hist_shift;
+    const long long int now = in.hist_now;
+    in.hist_shift = 1;
+    in.hist_now = 1000;
+
+    struct sum summary;
+    ASSERT_EQ(zeroit(&summary), 0);
+    for(size_t i = 0; i < SUM_HIST_BUCKETS; i++) {
+        EXPECT_EQ(summary.sizehistfiles[i], 0);
+        EXPECT_EQ(summary.sizehistbytes[i], 0);
+        EXPECT_EQ(summary.agehistfiles[i],  0);
+        EXPECT_EQ(summary.agehistbytes[i],  0);
+    }
+
+    struct work pwork;
+    memset(&pwork, 0, sizeof(pwork));
+
+    /* links are not counted */
+    SNPRINTF(pwork.type, 2, "%s", "l");
+    pwork.statuso.st_size  = 5;
+    pwork.statuso.st_mtime = 900;
+    ASSERT_EQ(sumit(&summary, &pwork), 0);
+    EXPECT_EQ(summary.sizehistfiles[3], 0);
+
+    /* 5 bytes, 100 seconds old */
+    SNPRINTF(pwork.type, 2, "%s", "f");
+    ASSERT_EQ(sumit(&summary, &pwork), 0);
+
+    /* 6 bytes, 2 seconds old */
+    pwork.statuso.st_size  = 6;
+    pwork.statuso.st_mtime = 998;
+    ASSERT_EQ(sumit(&summary, &pwork), 0);
+
+    /* empty and from the future */
+    pwork.statuso.st_size  = 0;
+    pwork.statuso.st_mtime = 2000;
+    ASSERT_EQ(sumit(&summary, &pwork), 0);
+
+    EXPECT_EQ(summary.sizehistfiles[0], 1);
+    EXPECT_EQ(summary.sizehistbytes[0], 0);
+    EXPECT_EQ(summary.sizehistfiles[3], 2);
+    EXPECT_EQ(summary.sizehistbytes[3], 11);
+    EXPECT_EQ(summary.agehistfiles[0],  1);
+    EXPECT_EQ(summary.agehistfiles[2],  1);
+    EXPECT_EQ(summary.agehistbytes[2],  6);
+    EXPECT_EQ(summary.agehistfiles[7],  1);
+    EXPECT_EQ(summary.agehistbytes[7],  5);
+
+    /* rolling up adds the buckets */
+    struct sum tree;
+    ASSERT_EQ(zeroit(&tree), 0);
+    ASSERT_EQ(tsumit(&summary, &tree), 0);
+    ASSERT_EQ(tsumit(&summary, &tree), 0);
+    for(size_t i = 0; i < SUM_HIST_BUCKETS; i++) {
+        EXPECT_EQ(tree.sizehistfiles[i], 2 * summary.sizehistfiles[i]);
+        EXPECT_EQ(tree.sizehistbytes[i], 2 * summary.sizehistbytes[i]);
+        EXPECT_EQ(tree.agehistfiles[i],  2 * summary.agehistfiles[i]);
+        EXPECT_EQ(tree.agehistbytes[i],  2 * summary.agehistbytes[i]);
+    }
+
+    in.hist_shift = shift;
+    in.hist_now = now;
+}
+
 #define PATH "a/b/c/d"
 #define LAST "e"
 #define SRC PATH "/" LAST
@@ -0,0 +1,281 @@
+/*
+This file is part of GUFI, which is part of MarFS, which is released
+under the BSD license.
+
+
+Copyright (c) 2017, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2017, Los Alamos National Security, LLC All rights reserved.
+Copyright 2017. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+
+
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+#include <sqlite3.h>
+
+#include "vfs.h"
+
+// create a database with one table holding one row
+static void create_db(const char * name) {
+    sqlite3 * db = nullptr;
+    ASSERT_EQ(sqlite3_open_v2(name, &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr), SQLITE_OK);
+    ASSERT_EQ(sqlite3_exec(db, "CREATE TABLE t(i INT); INSERT INTO t VALUES (1234);", nullptr, nullptr, nullptr), SQLITE_OK);
+    ASSERT_EQ(sqlite3_close(db), SQLITE_OK);
+}
+
+static int select_int(sqlite3 * db, const char * sql) {
+    sqlite3_stmt * res = nullptr;
+    EXPECT_EQ(sqlite3_prepare_v2(db, sql, -1, &res, nullptr), SQLITE_OK);
+    EXPECT_EQ(sqlite3_step(res), SQLITE_ROW);
+    const int rc = sqlite3_column_int(res, 0);
+    sqlite3_finalize(res);
+    return rc;
+}
+
+// open the file with the given VFS and check how it was loaded
+static void check_ro(const char * name, const char * vfs, const off_t size,
+                     const int expected_row, const bool mapped) {
+    sqlite3 * db = nullptr;
+    ASSERT_EQ(sqlite3_open_v2(name, &db, SQLITE_OPEN_READONLY, vfs), SQLITE_OK);
+
+    if (expected_row) {
+        EXPECT_EQ(select_int(db, "SELECT i FROM t;"), expected_row);
+    }
+    else {
+        EXPECT_EQ(select_int(db, "SELECT COUNT(*) FROM sqlite_master;"), 0);
+    }
+
+    // open + fstat + pread/mmap + close (empty files are not read)
+    struct gufi_vfs_stats stats;
+    ASSERT_EQ(gufi_vfs_stats(db, "main", &stats), SQLITE_OK);
+    EXPECT_EQ(stats.bytes, (size_t) size);
+    EXPECT_EQ(stats.syscalls, (size_t) (size?4:3));
+
+    // only mapped files need to call madvise
+    EXPECT_EQ(gufi_vfs_willneed(db, "main"), SQLITE_OK);
+    ASSERT_EQ(gufi_vfs_stats(db, "main", &stats), SQLITE_OK);
+    EXPECT_EQ(stats.syscalls, (size_t) (size?4:3) + mapped);
+
+    EXPECT_EQ(sqlite3_close(db), SQLITE_OK);
+}
+
+TEST(vfs, ro_read_max) {
+    ASSERT_EQ(gufi_vfs_init(), SQLITE_OK);
+
+    char name[] = "XXXXXX";
+    const int fd = mkstemp(name);
+    ASSERT_NE(fd, -1);
+    close(fd);
+
+    create_db(name);
+
+    struct stat st;
+    ASSERT_EQ(stat(name, &st), 0);
+    ASSERT_LT(st.st_size, GUFI_RO_VFS_READ_MAX);
+
+    // small files are copied unless gufi-ro-mmap is used
+    check_ro(name, GUFI_RO_VFS,      st.st_size, 1234, false);
+    check_ro(name, GUFI_RO_MMAP_VFS, st.st_size, 1234, true);
+
+    // files up to GUFI_RO_VFS_READ_MAX bytes are still copied
+    ASSERT_EQ(truncate(name, GUFI_RO_VFS_READ_MAX), 0);
+    check_ro(name, GUFI_RO_VFS,      GUFI_RO_VFS_READ_MAX, 1234, false);
+
+    // larger files are mapped
+    ASSERT_EQ(truncate(name, GUFI_RO_VFS_READ_MAX + st.st_blksize), 0);
+    check_ro(name, GUFI_RO_VFS,      GUFI_RO_VFS_READ_MAX + st.st_blksize, 1234, true);
+
+    remove(name);
+}
+
+TEST(vfs, ro_empty) {
+    ASSERT_EQ(gufi_vfs_init(), SQLITE_OK);
+
+    char name[] = "XXXXXX";
+    const int fd = mkstemp(name);
+    ASSERT_NE(fd, -1);
+    close(fd);
+
+    // empty files can't be mapped, so they are always "copied"
+    check_ro(name, GUFI_RO_VFS,      0, 0, false);
+    check_ro(name, GUFI_RO_MMAP_VFS, 0, 0, false);
+
+    remove(name);
+}
+
+TEST(vfs, ro_missing) {
+    ASSERT_EQ(gufi_vfs_init(), SQLITE_OK);
+
+    sqlite3 * db = nullptr;
+    EXPECT_EQ(sqlite3_open_v2("XXXXXX.missing", &db, SQLITE_OPEN_READONLY, GUFI_RO_VFS), SQLITE_CANTOPEN);
+    sqlite3_close(db);
+}
+
+TEST(vfs, ro_passthrough) {
+    ASSERT_EQ(gufi_vfs_init(), SQLITE_OK);
+
+    char name[] = "XXXXXX";
+    const int fd = mkstemp(name);
+    ASSERT_NE(fd, -1);
+    close(fd);
+
+    struct gufi_vfs_stats stats;
+
+    // writable databases are opened by the root VFS
+    sqlite3 * db = nullptr;
+    ASSERT_EQ(sqlite3_open_v2(name, &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, GUFI_RO_VFS), SQLITE_OK);
+    ASSERT_EQ(sqlite3_exec(db, "CREATE TABLE t(i INT); INSERT INTO t VALUES (1234);", nullptr, nullptr, nullptr), SQLITE_OK);
+    EXPECT_EQ(select_int(db, "SELECT i FROM t;"), 1234);
+    EXPECT_EQ(gufi_vfs_stats(db, "main", &stats), SQLITE_NOTFOUND);
+    EXPECT_EQ(stats.bytes, (size_t) 0);
+    EXPECT_EQ(stats.syscalls, (size_t) 0);
+    ASSERT_EQ(sqlite3_close(db), SQLITE_OK);
+
+    // temporary files of read-only databases are opened by the root VFS
+    db = nullptr;
+    ASSERT_EQ(sqlite3_open_v2(name, &db, SQLITE_OPEN_READONLY, GUFI_RO_VFS), SQLITE_OK);
+    EXPECT_NE(sqlite3_exec(db, "INSERT INTO t VALUES (5678);", nullptr, nullptr, nullptr), SQLITE_OK);
+    ASSERT_EQ(sqlite3_exec(db, "CREATE TEMP TABLE copy AS SELECT i FROM t;", nullptr, nullptr, nullptr), SQLITE_OK);
+    EXPECT_EQ(select_int(db, "SELECT i FROM copy;"), 1234);
+    EXPECT_EQ(gufi_vfs_stats(db, "temp", &stats), SQLITE_NOTFOUND);
+    EXPECT_EQ(gufi_vfs_stats(db, "main", &stats), SQLITE_OK);
+    EXPECT_GT(stats.bytes, (size_t) 0);
+    ASSERT_EQ(sqlite3_close(db), SQLITE_OK);
+
+    remove(name);
+}
+
+TEST(vfs, mem) {
+    ASSERT_EQ(gufi_vfs_init(), SQLITE_OK);
+
+    char name[] = "XXXXXX";
+    const int fd = mkstemp(name);
+    ASSERT_NE(fd, -1);
+    close(fd);
+
+    create_db(name);
+
+    // load the database image into memory
+    struct stat st;
+    ASSERT_EQ(stat(name, &st), 0);
+    char * image = (char *) malloc(st.st_size);
+    ASSERT_NE(image, nullptr);
+    const int image_fd = open(name, O_RDONLY);
+    ASSERT_NE(image_fd, -1);
+    ASSERT_EQ(read(image_fd, image, st.st_size), st.st_size);
+    close(image_fd);
+    remove(name);
+
+    char uri[1024];
+    ASSERT_EQ(gufi_mem_vfs_uri(uri, sizeof(uri), "image", image, st.st_size), 0);
+
+    sqlite3 * db = nullptr;
+    ASSERT_EQ(sqlite3_open_v2(uri, &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_URI, nullptr), SQLITE_OK);
+    EXPECT_EQ(select_int(db, "SELECT i FROM t;"), 1234);
+
+    // the image can't be modified, but temporary tables still work
+    EXPECT_NE(sqlite3_exec(db, "INSERT INTO t VALUES (5678);", nullptr, nullptr, nullptr), SQLITE_OK);
+    ASSERT_EQ(sqlite3_exec(db, "CREATE TEMP TABLE copy AS SELECT i FROM t;", nullptr, nullptr, nullptr), SQLITE_OK);
+    EXPECT_EQ(select_int(db, "SELECT i FROM copy;"), 1234);
+
+    // gufi-mem does not track I/O
+    struct gufi_vfs_stats stats;
+    EXPECT_EQ(gufi_vfs_stats(db, "main", &stats), SQLITE_NOTFOUND);
+    EXPECT_EQ(gufi_vfs_willneed(db, "main"), SQLITE_OK);
+    ASSERT_EQ(sqlite3_close(db), SQLITE_OK);
+
+    // empty images are empty databases
+    ASSERT_EQ(gufi_mem_vfs_uri(uri, sizeof(uri), "empty", image, 0), 0);
+    db = nullptr;
+    ASSERT_EQ(sqlite3_open_v2(uri, &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_URI, nullptr), SQLITE_OK);
+    EXPECT_EQ(select_int(db, "SELECT COUNT(*) FROM sqlite_master;"), 0);
+    ASSERT_EQ(sqlite3_close(db), SQLITE_OK);
+
+    // images without a pointer can't be opened
+    db = nullptr;
+    EXPECT_EQ(sqlite3_open_v2("file:image?vfs=" GUFI_MEM_VFS "&mode=ro&sz=1024", &db,
+                              SQLITE_OPEN_READONLY | SQLITE_OPEN_URI, nullptr), SQLITE_CANTOPEN);
+    sqlite3_close(db);
+
+    free(image);
+}
+
+TEST(vfs, mem_uri) {
+    const void * ptr = (void *) (uintptr_t) 0x1234;
+
+    char uri[1024];
+    ASSERT_EQ(gufi_mem_vfs_uri(uri, sizeof(uri), "image", ptr, 5678), 0);
+
+    const std::string expected = std::string("file:image?vfs=") + GUFI_MEM_VFS +
+                                 "&mode=ro&ptr=" + std::to_string((uintptr_t) ptr) + "&sz=5678";
+    EXPECT_EQ(uri, expected);
+
+    // exactly enough space for the NULL terminator
+    char exact[1024];
+    EXPECT_EQ(gufi_mem_vfs_uri(exact, expected.size() + 1, "image", ptr, 5678), 0);
+    EXPECT_EQ(exact, expected);
+
+    // anything that would be truncated is rejected
+    EXPECT_NE(gufi_mem_vfs_uri(exact, expected.size(), "image", ptr, 5678), 0);
+    EXPECT_NE(gufi_mem_vfs_uri(exact, 1, "image", ptr, 5678), 0);
+    EXPECT_NE(gufi_mem_vfs_uri(exact, 0, "image", ptr, 5678), 0);
+}